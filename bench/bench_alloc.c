@@ -0,0 +1,207 @@
+// Benchmark de asignaciones por pedido en régimen estable.
+// Arma el servidor completo (server.c incluido tal cual, con su main renombrado) sin sockets,
+// precarga registros en modo WAL y procesa con process_request_iov una mezcla estable de
+// pedidos CON desde varios endpoints: POST de un valor nuevo, GET y PUT de registros vivos y
+// DELETE del más viejo, así la cantidad de registros no cambia. Después del calentamiento
+// (chunks del slab, caché de intercambios llena, anillos del log y bloques de métricas por hilo)
+// cuenta los malloc/calloc/realloc de todo el proceso durante la fase medida.
+// Con --check retorna 2 si hubo alguna asignación.
+//
+//   ./bench_alloc [--records N] [--requests N] [--dir DIR] [--check]
+#define main server_main
+#include "server.c"
+#undef main
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define BENCH_RECORDS 100000
+#define BENCH_REQUESTS 1000000
+#define BENCH_WARMUP (EXCHANGE_CAPACITY * 2)   // que la caché de intercambios ya esté reemplazando
+#define BENCH_PEERS 64
+
+// Contador de asignaciones: reemplaza malloc/calloc/realloc del proceso y delega en glibc
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static atomic_uint_fast64_t allocations = 0;
+
+void *malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t bench_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Ventana de ids vivos [lo, hi): los POST agregan al final y los DELETE borran el primero
+static int live_lo, live_hi;
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+static uint16_t bench_mid = 0;
+static uint64_t failures = 0;
+
+// Armar y procesar un pedido; cuenta como falla si la respuesta no tiene el código esperado
+static void bench_request(uint32_t peer_idx, uint8_t code, int id, uint8_t expected) {
+    coap_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.ver = 1;
+    pkt.type = COAP_TYPE_CON;
+    pkt.code = code;
+    pkt.message_id = bench_mid++;
+    pkt.token_len = 4;
+    memcpy(pkt.token, &peer_idx, 4);
+
+    char id_text[16], value[16];
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+    if (id > 0) {
+        int len = snprintf(id_text, sizeof(id_text), "%d", id);
+        coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) id_text, (uint16_t) len);
+    }
+    if (code == COAP_CODE_POST || code == COAP_CODE_PUT) {
+        uint64_t r = bench_rand(&rng);
+        int len = snprintf(value, sizeof(value), "%u.%02u", (unsigned) (15 + r % 20), (unsigned) (r >> 8) % 100);
+        pkt.payload = (uint8_t*) value;
+        pkt.payload_len = (size_t) len;
+    }
+
+    uint8_t in[256];
+    size_t in_len;
+    if (coap_build(&pkt, in, &in_len, sizeof(in)) != 0) {
+        failures++;
+        return;
+    }
+
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    peer.sin_port = htons((uint16_t) (40000 + peer_idx % BENCH_PEERS));
+
+    uint8_t head[MAX_BUF];
+    struct iovec iov[2];
+    size_t iovcnt;
+    if (process_request_iov(&peer, in, in_len, head, sizeof(head), iov, &iovcnt) != 0 ||
+        COAP_CODE((const uint8_t*) iov[0].iov_base) != expected) {
+        failures++;
+    }
+}
+
+// Una vuelta de la mezcla: 5 pedidos
+static void bench_round(uint32_t i) {
+    bench_request(i, COAP_CODE_POST, 0, COAP_CODE_CREATED);
+    live_hi++;
+    int span = live_hi - live_lo;
+    bench_request(i, COAP_CODE_GET, live_lo + (int) (bench_rand(&rng) % span), COAP_CODE_CONTENT);
+    bench_request(i, COAP_CODE_PUT, live_lo + (int) (bench_rand(&rng) % span), COAP_CODE_CHANGED);
+    bench_request(i, COAP_CODE_GET, live_lo + (int) (bench_rand(&rng) % span), COAP_CODE_CONTENT);
+    bench_request(i, COAP_CODE_DELETE, live_lo, COAP_CODE_DELETED);
+    live_lo++;
+}
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    size_t records = BENCH_RECORDS, requests = BENCH_REQUESTS;
+    const char *dir = NULL;
+    bool check = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            records = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            fprintf(stderr, "Uso: %s [--records N] [--requests N] [--dir DIR] [--check]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (records == 0) records = 1;
+
+    struct stat st;
+    if (!dir) dir = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm" : ".";
+    char path[256], logpath[256];
+    snprintf(path, sizeof(path), "%s/bench_alloc_%d.json", dir, (int) getpid());
+    snprintf(logpath, sizeof(logpath), "%s/bench_alloc_%d.log", dir, (int) getpid());
+
+    // El log repite cada línea en stdout: se descarta mientras corre, con el nivel por defecto
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (saved_stdout < 0 || devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+        perror("dup");
+        return 1;
+    }
+    close(devnull);
+
+    // La misma inicialización que main, sin sockets ni hilos de recepción
+    storage_options_t opts = { .wal = true, .commit_ms = 0, .commit_bytes = 64 * 1024 };
+    storage_set_options(&opts);
+    if (log_init(logpath) != 0 || storage_init(path) != 0 || exchange_init() != 0 || respcache_init() != 0 ||
+        separate_init() != 0 || observe_start(render_resource) != 0) {
+        perror("init");
+        return 1;
+    }
+    storage_set_listener(on_storage_change);
+
+    for (size_t i = 0; i < records; i++) {
+        if (storage_add("20.00") != 0) {
+            perror("storage_add");
+            return 1;
+        }
+    }
+    live_lo = 1;
+    live_hi = (int) records + 1;
+
+    uint32_t round = 0;
+    for (size_t n = 0; n < BENCH_WARMUP; n += 5) bench_round(round++);
+
+    uint64_t allocs0 = atomic_load(&allocations);
+    uint64_t t0 = bench_now_ns();
+    size_t done = 0;
+    for (; done < requests; done += 5) bench_round(round++);
+    uint64_t elapsed = bench_now_ns() - t0;
+    uint64_t allocs = atomic_load(&allocations) - allocs0;
+    log_close();
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    arena_stats_t as;
+    arena_get_stats(&as);
+    slab_stats_t sl;
+    slab_get_stats(&sl);
+    printf("registros=%zu pedidos=%zu fallas=%llu\n", records, done, (unsigned long long) failures);
+    printf("ns/pedido=%.0f asignaciones=%llu asignaciones/pedido=%.6f\n",
+           (double) elapsed / done, (unsigned long long) allocs, (double) allocs / done);
+    printf("arena: máximo=%zu/%d bytes fallbacks=%llu; slab: bloques=%zu máximo=%zu chunks=%zu fallbacks=%llu\n",
+           as.high_water, ARENA_SIZE, (unsigned long long) as.fallbacks,
+           sl.in_use, sl.high_water, sl.chunks, (unsigned long long) sl.fallbacks);
+
+    unlink(path);
+    snprintf(path + strlen(path), sizeof(path) - strlen(path), ".wal");
+    unlink(path);
+    unlink(logpath);
+    if (failures > 0) return 1;
+    return check && allocs > 0 ? 2 : 0;
+}
@@ -0,0 +1,102 @@
+// Benchmark: throughput de la exportación por bloques (Block2).
+// Carga N registros desde un snapshot y pide la exportación completa bloque a bloque,
+// generando cada respuesta CoAP como lo haría el servidor (sin red), para cada SZX.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "coap_packet.h"
+#include "blockwise.h"
+#include "storage.h"
+#include "snapshot.h"
+
+#define DEFAULT_N 1000000
+#define DATA_FILE "bench_export.json"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void cleanup(void) {
+    unlink(DATA_FILE);
+    unlink(DATA_FILE ".wal");
+    unlink(DATA_FILE ".snap");
+}
+
+static int prepare(size_t n) {
+    snapshot_writer_t *w = snapshot_begin(DATA_FILE ".snap");
+    if (!w) return -1;
+    char value[32];
+    time_t now = time(NULL);
+    for (size_t i = 1; i <= n; i++) {
+        snprintf(value, sizeof(value), "%zu.%02zu", 10 + i % 30, i % 100);
+        if (snapshot_put(w, (int) i, now - (time_t) (n - i), value) != 0) {
+            snapshot_abort(w);
+            return -1;
+        }
+    }
+    return snapshot_commit(w, (int) n + 1);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_N;
+
+    cleanup();
+    if (prepare(n) != 0) {
+        fprintf(stderr, "error preparando el snapshot\n");
+        return 1;
+    }
+    storage_options_t opts = { .wal = true, .commit_ms = 0, .commit_bytes = 64 * 1024, .snapshot_interval = 3600 };
+    storage_set_options(&opts);
+    if (storage_init(DATA_FILE) != 0) {
+        fprintf(stderr, "storage_init falló\n");
+        cleanup();
+        return 1;
+    }
+
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int szx = COAP_BLOCK_MAX_SZX; szx >= 2; szx -= 2) {
+        uint8_t payload[1024], out[1500], opt[3];
+        uint64_t bytes = 0, blocks = 0;
+        peer.sin_port = htons((uint16_t) (40000 + szx));   // una sesión por corrida
+
+        uint64_t start = now_ns();
+        coap_block_t req = { .num = 0, .more = false, .szx = (uint8_t) szx }, resp;
+        do {
+            size_t len;
+            if (block_export(&peer, NULL, &req, &resp, payload, &len) != 0) break;
+
+            coap_packet_t pkt;
+            memset(&pkt, 0, sizeof(pkt));
+            pkt.ver = 1;
+            pkt.type = COAP_TYPE_ACK;
+            pkt.code = COAP_CODE_CONTENT;
+            pkt.payload = payload;
+            pkt.payload_len = len;
+            coap_add_option(&pkt, COAP_OPTION_BLOCK2, opt, coap_encode_block(&resp, opt));
+            size_t out_len;
+            if (coap_build(&pkt, out, &out_len, sizeof(out)) != 0) break;
+
+            bytes += len;
+            blocks++;
+            req.num++;
+        } while (resp.more);
+        uint64_t elapsed = now_ns() - start;
+
+        printf("szx=%d bloque=%u registros=%zu bloques=%llu MB=%.1f MB_s=%.1f bloques_s=%.0f\n", szx,
+               COAP_BLOCK_SIZE(szx), n, (unsigned long long) blocks, bytes / 1e6, bytes / 1e6 / (elapsed / 1e9),
+               blocks / (elapsed / 1e9));
+    }
+
+    cleanup();
+    return 0;
+}
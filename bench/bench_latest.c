@@ -0,0 +1,223 @@
+// Benchmark de GET data/<sensor>/latest a nivel de almacenamiento.
+// Precarga --sensors particiones y mide, durante --seconds cada fase:
+//   1. lecturas/s por hilo de partition_latest (seqlock, sin locks) y de partition_get (lock de lectura)
+//   2. ingesta sola: partition_add/s de un escritor repartido entre los sensores
+//   3. ingesta con --readers lectores de la última lectura en paralelo
+// Cada valor escrito repite un mismo carácter con un largo variable, así una lectura cortada
+// a mitad de una escritura se detecta (lecturas inconsistentes). También cuenta las
+// asignaciones de heap de los lectores. Con --check retorna 2 si hubo alguna de las dos.
+//
+//   ./bench_latest [--sensors N] [--readers N] [--seconds S] [--dir DIR] [--check]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "partition.h"
+
+#define DEFAULT_SENSORS 256
+#define DEFAULT_READERS 2
+#define DEFAULT_SECONDS 1.0
+
+// Contador de asignaciones: reemplaza malloc/calloc/realloc del proceso y delega en glibc
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static atomic_uint_fast64_t allocations = 0;
+
+void *malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static size_t sensors = DEFAULT_SENSORS;
+static double seconds = DEFAULT_SECONDS;
+static char (*names)[PARTITION_NAME_MAX + 1];
+static atomic_bool go = false, stop = false;
+static atomic_uint_fast64_t torn = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Valor n: un mismo carácter repetido, de 1 a 96 bytes
+static void make_value(uint64_t n, char *out) {
+    size_t len = 1 + n % 96;
+    memset(out, 'a' + (int) (n % 26), len);
+    out[len] = '\0';
+}
+
+static bool value_ok(const char *value) {
+    if (!value[0]) return false;
+    for (const char *c = value + 1; *c; c++) {
+        if (*c != value[0]) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    bool locked;            // partition_get con el id del último en vez de partition_latest
+    uint64_t seed;
+    uint64_t reads;
+} reader_t;
+
+static void *reader_main(void *arg) {
+    reader_t *r = (reader_t*) arg;
+    char value[128];
+    int id;
+    time_t ts;
+    while (!atomic_load_explicit(&go, memory_order_acquire)) {}
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        for (int k = 0; k < 256; k++) {
+            const char *name = names[next_rand(&r->seed) % sensors];
+            if (partition_latest(name, &id, &ts, value, sizeof(value)) != 0) continue;
+            if (r->locked && partition_get(name, id, value, sizeof(value)) != 0) continue;
+            if (!value_ok(value)) atomic_fetch_add_explicit(&torn, 1, memory_order_relaxed);
+            r->reads++;
+        }
+    }
+    return NULL;
+}
+
+static void *writer_main(void *arg) {
+    uint64_t *adds = (uint64_t*) arg;
+    char value[128];
+    while (!atomic_load_explicit(&go, memory_order_acquire)) {}
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        make_value(*adds, value);
+        if (partition_add(names[*adds % sensors], value) > 0) (*adds)++;
+    }
+    return NULL;
+}
+
+static void sleep_phase(void) {
+    struct timespec ts = { .tv_sec = (time_t) seconds, .tv_nsec = (long) ((seconds - (time_t) seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+// Correr readers lectores (y un escritor si with_writer) durante la fase.
+// Retorna las asignaciones de heap mientras corrían (sin contar la creación de los hilos)
+static uint64_t run_phase(const char *name, size_t readers, bool locked, bool with_writer) {
+    pthread_t threads[64], writer;
+    reader_t state[64];
+    uint64_t adds = 0;
+    atomic_store(&go, false);
+    atomic_store(&stop, false);
+    for (size_t i = 0; i < readers; i++) {
+        state[i] = (reader_t) { .locked = locked, .seed = 0x9E3779B97F4A7C15ull * (i + 1), .reads = 0 };
+        pthread_create(&threads[i], NULL, reader_main, &state[i]);
+    }
+    if (with_writer) pthread_create(&writer, NULL, writer_main, &adds);
+
+    uint64_t allocs0 = atomic_load(&allocations);
+    uint64_t t0 = now_ns();
+    atomic_store_explicit(&go, true, memory_order_release);
+    sleep_phase();
+    atomic_store(&stop, true);
+    uint64_t reads = 0;
+    for (size_t i = 0; i < readers; i++) {
+        pthread_join(threads[i], NULL);
+        reads += state[i].reads;
+    }
+    if (with_writer) pthread_join(writer, NULL);
+    double elapsed = (now_ns() - t0) / 1e9;
+    uint64_t allocs = atomic_load(&allocations) - allocs0;
+
+    printf("fase=%s lectores=%zu lecturas_s=%.0f lecturas_s_hilo=%.0f", name, readers, reads / elapsed,
+           readers ? reads / elapsed / readers : 0.0);
+    if (with_writer) printf(" escrituras_s=%.0f", adds / elapsed);
+    printf(" asignaciones=%llu\n", (unsigned long long) allocs);
+    return allocs;
+}
+
+int main(int argc, char *argv[]) {
+    size_t readers = DEFAULT_READERS;
+    const char *dir = NULL;
+    bool check = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) {
+            sensors = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            fprintf(stderr, "Uso: %s [--sensors N] [--readers N] [--seconds S] [--dir DIR] [--check]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (sensors == 0 || sensors > PARTITION_MAX) sensors = DEFAULT_SENSORS;
+    if (readers == 0 || readers > 64) readers = DEFAULT_READERS;
+
+    struct stat st;
+    if (!dir) dir = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm" : ".";
+    char path[256];
+    snprintf(path, sizeof(path), "%s/bench_latest_%d", dir, (int) getpid());
+    if (partition_init(path, false) != 0) {
+        perror("partition_init");
+        return 1;
+    }
+
+    names = __libc_malloc(sensors * sizeof(*names));
+    char value[128];
+    for (size_t i = 0; i < sensors; i++) {
+        snprintf(names[i], sizeof(names[i]), "sensor-%zu", i);
+        make_value(i, value);
+        if (partition_add(names[i], value) <= 0) {
+            perror("partition_add");
+            return 1;
+        }
+    }
+
+    // Las lecturas no piden memoria; la ingesta sí (chunks del slab, ventanas de ids)
+    uint64_t read_allocs = run_phase("latest", 1, false, false);
+    run_phase("get", 1, true, false);
+    read_allocs += run_phase("latest", readers, false, false);
+    run_phase("ingesta", 0, false, true);
+    run_phase("ingesta+latest", readers, false, true);
+    run_phase("ingesta+get", readers, true, true);
+
+    partition_stats_t ps;
+    partition_get_stats(&ps);
+    printf("sensores=%zu registros=%zu reescrituras=%llu lecturas_inconsistentes=%llu\n", ps.partitions, ps.records,
+           (unsigned long long) ps.compactions, (unsigned long long) atomic_load(&torn));
+
+    for (size_t i = 0; i < sensors; i++) {
+        char file[300];
+        snprintf(file, sizeof(file), "%s/%s.wal", path, names[i]);
+        unlink(file);
+    }
+    rmdir(path);
+    if (atomic_load(&torn) > 0 || read_allocs > 0) return check ? 2 : 0;
+    return 0;
+}
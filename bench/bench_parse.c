@@ -0,0 +1,165 @@
+// Benchmark: ns por paquete del parser CoAP con paquetes típicos de sensores.
+// Mide coap_parse solo y coap_parse más las búsquedas que hace el servidor (Uri-Path, id,
+// Observe, Uri-Query), y lo compara con el parser anterior (dos pasadas, búsqueda lineal
+// y atoi sobre una copia), que se conserva acá sólo como referencia.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "coap_packet.h"
+
+#define DEFAULT_ITERATIONS 5000000
+
+typedef struct {
+    const char *name;
+    uint8_t data[128];
+    size_t len;
+} sample_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Parser anterior: sin validar las extensiones contra len y buscando el 0xFF de nuevo al final
+__attribute__((noinline)) static int legacy_parse(const uint8_t *buffer, size_t len, coap_packet_t *paquete) {
+    if (len < 4) return -1;
+    paquete->ver = COAP_VER(buffer);
+    paquete->type = COAP_TYPE(buffer);
+    paquete->tkl = COAP_TKL(buffer);
+    paquete->code = COAP_CODE(buffer);
+    paquete->message_id = COAP_MID(buffer);
+    if (paquete->tkl > 8 || 4u + paquete->tkl > len) return -2;
+    paquete->token_len = paquete->tkl;
+    memcpy(paquete->token, buffer + 4, paquete->token_len);
+
+    size_t index = 4 + paquete->token_len;
+    paquete->options_count = 0;
+    uint16_t running_delta = 0;
+    while (index < len && buffer[index] != 0xFF) {
+        uint8_t byte = buffer[index++];
+        uint16_t opt_delta = (byte & 0xF0) >> 4;
+        uint16_t opt_len = (byte & 0x0F);
+        if (opt_delta == 13) { opt_delta = buffer[index++] + 13; }
+        else if (opt_delta == 14) { opt_delta = ((buffer[index] << 8) | buffer[index + 1]) + 269; index += 2; }
+        if (opt_len == 13) { opt_len = buffer[index++] + 13; }
+        else if (opt_len == 14) { opt_len = ((buffer[index] << 8) | buffer[index + 1]) + 269; index += 2; }
+        running_delta += opt_delta;
+        coap_option_t *opt = &paquete->options[paquete->options_count++];
+        opt->number = running_delta;
+        opt->length = opt_len;
+        opt->value = (uint8_t*) (buffer + index);
+        index += opt_len;
+    }
+    size_t payload_start = 0;
+    for (size_t i = index; i < len; i++) {
+        if (buffer[i] == 0xFF) {
+            payload_start = i + 1;
+            break;
+        }
+    }
+    if (payload_start > 0 && payload_start < len) {
+        paquete->payload_len = len - payload_start;
+        paquete->payload = (uint8_t*) (buffer + payload_start);
+    } else {
+        paquete->payload = NULL;
+        paquete->payload_len = 0;
+    }
+    return 0;
+}
+
+// Búsquedas del servidor con el recorrido lineal anterior
+static int legacy_lookups(const coap_packet_t *pkt) {
+    int id = -1, found = 0;
+    for (size_t i = 0; i < pkt->options_count; i++) {
+        const coap_option_t *opt = &pkt->options[i];
+        if (opt->number == COAP_OPTION_URI_PATH && id < 0 && opt->length > 0 && opt->length < 32) {
+            char buf[32];
+            memcpy(buf, opt->value, opt->length);
+            buf[opt->length] = '\0';
+            int v = atoi(buf);
+            if (v > 0) id = v;
+        }
+    }
+    for (size_t i = 0; i < pkt->options_count; i++) {
+        if (pkt->options[i].number == COAP_OPTION_OBSERVE) found++;
+    }
+    for (size_t i = 0; i < pkt->options_count; i++) {
+        if (pkt->options[i].number == COAP_OPTION_URI_QUERY) found++;
+    }
+    return id + found;
+}
+
+// Las mismas búsquedas con el índice y los accesos tipados
+static int indexed_lookups(const coap_packet_t *pkt) {
+    int id = -1, found = 0;
+    for (const coap_option_t *opt = coap_find_option(pkt, COAP_OPTION_URI_PATH); opt; opt = coap_next_option(pkt, opt)) {
+        uint32_t v;
+        if (coap_option_decimal(opt, &v) == 0 && v > 0) {
+            id = (int) v;
+            break;
+        }
+    }
+    uint32_t observe;
+    if (coap_get_uint(pkt, COAP_OPTION_OBSERVE, &observe) == 0) found++;
+    if (coap_find_option(pkt, COAP_OPTION_URI_QUERY)) found++;
+    return id + found;
+}
+
+// Armar un paquete de ejemplo con coap_build
+static void make_sample(sample_t *s, const char *name, uint8_t type, uint8_t code, size_t tkl,
+                        const char *path_id, const char *query, bool observe, const char *payload) {
+    coap_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.ver = 1;
+    pkt.type = type;
+    pkt.code = code;
+    pkt.message_id = 0x1234;
+    pkt.token_len = tkl;
+    for (size_t i = 0; i < tkl; i++) pkt.token[i] = (uint8_t) (0xA0 + i);
+    if (observe) coap_add_option(&pkt, COAP_OPTION_OBSERVE, NULL, 0);
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+    if (path_id) coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) path_id, (uint16_t) strlen(path_id));
+    if (query) coap_add_option(&pkt, COAP_OPTION_URI_QUERY, (const uint8_t*) query, (uint16_t) strlen(query));
+    if (payload) {
+        pkt.payload = (uint8_t*) payload;
+        pkt.payload_len = strlen(payload);
+    }
+    s->name = name;
+    coap_build(&pkt, s->data, &s->len, sizeof(s->data));
+}
+
+static double run(const sample_t *s, size_t iterations, bool legacy, bool lookups) {
+    coap_packet_t pkt;
+    volatile int sink = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        int res = legacy ? legacy_parse(s->data, s->len, &pkt) : coap_parse(s->data, s->len, &pkt);
+        if (lookups) res += legacy ? legacy_lookups(&pkt) : indexed_lookups(&pkt);
+        sink += res;
+    }
+    (void) sink;
+    return (double) (now_ns() - start) / (double) iterations;
+}
+
+int main(int argc, char *argv[]) {
+    size_t iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+
+    sample_t samples[4];
+    make_sample(&samples[0], "GET data/<id>", COAP_TYPE_CON, COAP_CODE_GET, 4, "1234", NULL, false, NULL);
+    make_sample(&samples[1], "GET Observe", COAP_TYPE_CON, COAP_CODE_GET, 8, "17", NULL, true, NULL);
+    make_sample(&samples[2], "POST data", COAP_TYPE_NON, COAP_CODE_POST, 2, NULL, NULL, false,
+                "{\"sensor\": \"invernadero-3\", \"temperatura\": 23.5, \"humedad\": 61}");
+    make_sample(&samples[3], "GET consulta", COAP_TYPE_CON, COAP_CODE_GET, 4, NULL, "from=1700000000", false, NULL);
+
+    printf("%-14s %6s %12s %12s %14s %14s\n", "paquete", "bytes", "parse ns", "anterior ns", "+búsquedas ns", "anterior ns");
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        const sample_t *s = &samples[i];
+        printf("%-14s %6zu %12.1f %12.1f %14.1f %14.1f\n", s->name, s->len,
+               run(s, iterations, false, false), run(s, iterations, true, false),
+               run(s, iterations, false, true), run(s, iterations, true, true));
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Benchmark: modelo de un hilo por datagrama vs pool fijo de workers.
+// Cada "datagrama" es un POST CoAP que el handler parsea y responde con un ACK
+// (sin red ni almacenamiento) para medir sólo el costo del despacho.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "coap_packet.h"
+#include "pool.h"
+
+#define DEFAULT_N 20000
+#define MAX_THREADS 100    // Límite del modelo anterior
+
+typedef struct {
+    uint8_t buffer[64];
+    size_t buffer_len;
+    uint64_t t_enqueue;
+    uint64_t *latency_out;
+} item_t;
+
+static atomic_int active_threads = 0;
+static atomic_size_t completed = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Trabajo equivalente a handle_client sin E/S
+static void process(item_t *it) {
+    coap_packet_t req, resp;
+    memset(&req, 0, sizeof(req));
+    memset(&resp, 0, sizeof(resp));
+    if (coap_parse(it->buffer, it->buffer_len, &req) == 0) {
+        resp.ver = 1;
+        resp.type = COAP_TYPE_ACK;
+        resp.code = COAP_CODE_CREATED;
+        resp.message_id = req.message_id;
+        uint8_t out[64];
+        size_t out_len;
+        coap_build(&resp, out, &out_len, sizeof(out));
+    }
+    *it->latency_out = now_ns() - it->t_enqueue;
+    atomic_fetch_add(&completed, 1);
+}
+
+static void *thread_body(void *arg) {
+    process((item_t*) arg);
+    free(arg);
+    atomic_fetch_sub(&active_threads, 1);
+    return NULL;
+}
+
+static void pool_body(void *arg) {
+    process((item_t*) arg);
+}
+
+static size_t fill_post(uint8_t *buf, uint16_t mid) {
+    const uint8_t pkt[] = { 0x40, 0x02, mid >> 8, mid & 0xFF, 0xB4, 'd', 'a', 't', 'a',
+                            0xFF, '2', '3', '.', '4', '5' };
+    memcpy(buf, pkt, sizeof(pkt));
+    return sizeof(pkt);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *model, size_t n, uint64_t elapsed, uint64_t *lat) {
+    qsort(lat, n, sizeof(uint64_t), cmp_u64);
+    printf("modelo=%s n=%zu dgram_s=%.0f p50_us=%.1f p99_us=%.1f\n",
+           model, n, n / (elapsed / 1e9), lat[n / 2] / 1e3, lat[(n * 99) / 100] / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_N;
+    size_t workers = (argc > 2) ? strtoul(argv[2], NULL, 10) : 8;
+    uint64_t *lat = calloc(n, sizeof(uint64_t));
+    if (!lat || n == 0) return 1;
+
+    // Modelo anterior: malloc + pthread_create + pthread_detach por datagrama
+    atomic_store(&completed, 0);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        while (atomic_load(&active_threads) >= MAX_THREADS) sleep(1);
+        item_t *it = malloc(sizeof(item_t));
+        it->buffer_len = fill_post(it->buffer, (uint16_t) i);
+        it->latency_out = &lat[i];
+        atomic_fetch_add(&active_threads, 1);
+        it->t_enqueue = now_ns();
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, thread_body, it) != 0) {
+            atomic_fetch_sub(&active_threads, 1);
+            free(it);
+            lat[i] = 0;
+            atomic_fetch_add(&completed, 1);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    while (atomic_load(&completed) < n) usleep(100);
+    report("hilo_por_datagrama", n, now_ns() - start, lat);
+
+    // Modelo nuevo: pool fijo alimentado por la cola MPMC
+    item_t *items = calloc(n, sizeof(item_t));
+    worker_pool_t *pool = pool_create(workers, 1024, pool_body);
+    if (!items || !pool) return 1;
+
+    atomic_store(&completed, 0);
+    start = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        item_t *it = &items[i];
+        it->buffer_len = fill_post(it->buffer, (uint16_t) i);
+        it->latency_out = &lat[i];
+        it->t_enqueue = now_ns();
+        while (pool_submit(pool, it) != 0) sched_yield();
+    }
+    while (atomic_load(&completed) < n) usleep(100);
+    report("pool", n, now_ns() - start, lat);
+
+    pool_stats_t st;
+    pool_get_stats(pool, &st);
+    printf("pool workers=%zu procesados=%llu cola_llena=%llu\n", st.workers,
+           (unsigned long long) st.processed, (unsigned long long) st.dropped);
+
+    pool_destroy(pool);
+    free(items);
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Benchmark: tiempo de arranque de storage_init según el largo del historial.
+// Compara un snapshot mapeado + una cola fija del WAL contra reaplicar el WAL completo.
+// Cada medición corre en un proceso hijo porque el almacenamiento es estado global.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "storage.h"
+#include "snapshot.h"
+#include "wal.h"
+
+#define TAIL_RECORDS 10000
+#define DATA_FILE "bench_startup.json"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void cleanup(void) {
+    unlink(DATA_FILE);
+    unlink(DATA_FILE ".wal");
+    unlink(DATA_FILE ".wal.old");
+    unlink(DATA_FILE ".snap");
+}
+
+static void fill_value(char *buf, size_t max, size_t i) {
+    snprintf(buf, max, "%zu.%02zu", 10 + i % 30, i % 100);
+}
+
+// Escribir ids [first, first + n) como ADD al WAL
+static int write_wal(size_t first, size_t n) {
+    if (wal_open(DATA_FILE ".wal", 0, 4 * 1024 * 1024) != 0) return -1;
+    char value[32];
+    time_t now = time(NULL);
+    for (size_t i = first; i < first + n; i++) {
+        fill_value(value, sizeof(value), i);
+        wal_record_t rec = { .op = WAL_OP_ADD, .id = (int) i, .ts = now, .value = value, .value_len = strlen(value) };
+        if (wal_append(&rec) == 0) return -1;
+    }
+    wal_close();
+    return 0;
+}
+
+// Historial compactado: snapshot con n registros y una cola de TAIL_RECORDS en el WAL
+static int prepare_snapshot(size_t n) {
+    snapshot_writer_t *w = snapshot_begin(DATA_FILE ".snap");
+    if (!w) return -1;
+    char value[32];
+    time_t now = time(NULL);
+    for (size_t i = 1; i <= n; i++) {
+        fill_value(value, sizeof(value), i);
+        if (snapshot_put(w, (int) i, now, value) != 0) {
+            snapshot_abort(w);
+            return -1;
+        }
+    }
+    if (snapshot_commit(w, (int) n + 1) != 0) return -1;
+    return write_wal(n + 1, TAIL_RECORDS);
+}
+
+// Medir storage_init en un proceso nuevo
+static void measure(const char *model, size_t n, bool snapshot) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        cleanup();
+        int res = snapshot ? prepare_snapshot(n) : write_wal(1, n + TAIL_RECORDS);
+        if (res != 0) {
+            fprintf(stderr, "error preparando %s n=%zu\n", model, n);
+            _exit(1);
+        }
+
+        // Vaciar la caché de páginas no está al alcance sin privilegios: se mide en caliente
+        storage_options_t opts = { .wal = true, .commit_ms = 0, .commit_bytes = 64 * 1024,
+                                   .snapshot_interval = snapshot ? 3600 : 0 };
+        storage_set_options(&opts);
+        uint64_t start = now_ns();
+        res = storage_init(DATA_FILE);
+        uint64_t elapsed = now_ns() - start;
+
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        if (res == 0) {
+            printf("modelo=%s registros=%zu cola=%d arranque_ms=%.1f rss_mb=%.0f\n", model, n + TAIL_RECORDS,
+                   TAIL_RECORDS, elapsed / 1e6, ru.ru_maxrss / 1024.0);
+        } else {
+            fprintf(stderr, "storage_init falló (%s n=%zu)\n", model, n);
+        }
+        fflush(stdout);
+        cleanup();
+        _exit(res == 0 ? 0 : 1);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes[8] = { 1000000, 10000000 };
+    size_t count = 2;
+    if (argc > 1) {
+        count = 0;
+        for (int i = 1; i < argc && count < 8; i++) sizes[count++] = strtoul(argv[i], NULL, 10);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        measure("snapshot+cola", sizes[i], true);
+        measure("wal_completo", sizes[i], false);
+    }
+    return 0;
+}
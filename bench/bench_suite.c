@@ -0,0 +1,365 @@
+// Suite de microbenchmarks del codec CoAP y del almacenamiento.
+// Mide ns/op y asignaciones/op de coap_parse, coap_build y coap_get_uri_id, y de cada
+// storage_* con 1k, 10k, 100k, 1M (y con --max, 10M) registros, para ver cómo escalan.
+// Cada tamaño corre en un proceso hijo porque el almacenamiento es estado global.
+// Además de la tabla, escribe una línea JSON por medición (--json) y puede compararse
+// contra una corrida anterior (--baseline): retorna 2 si algo empeoró más que --threshold.
+//
+//   ./bench_suite [--only codec|storage] [--max N] [--iterations N] [--dir DIR]
+//                 [--json PATH] [--baseline PATH] [--threshold PCT]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "coap_packet.h"
+#include "storage.h"
+
+#define DEFAULT_ITERATIONS 2000000
+#define DEFAULT_MAX 1000000
+#define DEFAULT_THRESHOLD 10.0
+#define STORAGE_OPS 200000           // operaciones medidas por tamaño (como mucho n)
+#define MAX_BASELINE 256
+
+typedef struct {
+    char name[64];
+    size_t n;
+    double ns_op;
+} baseline_t;
+
+static const char *only = NULL;
+static size_t max_records = DEFAULT_MAX;
+static size_t iterations = DEFAULT_ITERATIONS;
+static const char *dir = NULL;
+static FILE *json = NULL;
+static baseline_t baseline[MAX_BASELINE];
+static size_t baseline_len = 0;
+static double threshold = DEFAULT_THRESHOLD;
+static bool regressed = false;
+static volatile uint64_t sink;       // evita que el compilador descarte los resultados
+
+// Contador de asignaciones: reemplaza malloc/calloc/realloc del proceso y delega en glibc
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static atomic_uint_fast64_t allocations = 0;
+
+void *malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Inicio de una medición: hora y asignaciones hasta el momento
+typedef struct {
+    uint64_t t0;
+    uint64_t allocs0;
+} mark_t;
+
+static mark_t mark(void) {
+    mark_t m = { .allocs0 = atomic_load(&allocations), .t0 = now_ns() };
+    return m;
+}
+
+static const baseline_t *find_baseline(const char *name, size_t n) {
+    for (size_t i = 0; i < baseline_len; i++) {
+        if (baseline[i].n == n && strcmp(baseline[i].name, name) == 0) return &baseline[i];
+    }
+    return NULL;
+}
+
+// Reportar una medición de ops operaciones desde m
+static void report(const char *name, size_t n, size_t ops, mark_t m) {
+    uint64_t elapsed = now_ns() - m.t0;
+    uint64_t allocs = atomic_load(&allocations) - m.allocs0;
+    double ns_op = (double) elapsed / (double) ops;
+    double allocs_op = (double) allocs / (double) ops;
+
+    printf("%-16s n=%-9zu ns_op=%10.1f allocs_op=%6.2f ops=%zu", name, n, ns_op, allocs_op, ops);
+    const baseline_t *base = find_baseline(name, n);
+    if (base && base->ns_op > 0) {
+        double delta = 100.0 * (ns_op - base->ns_op) / base->ns_op;
+        printf("  %+.1f%%", delta);
+        if (delta > threshold) {
+            printf(" REGRESIÓN");
+            regressed = true;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+
+    if (json) {
+        fprintf(json, "{\"bench\":\"%s\",\"n\":%zu,\"ops\":%zu,\"ns_op\":%.1f,\"allocs_op\":%.3f}\n",
+                name, n, ops, ns_op, allocs_op);
+        fflush(json);
+    }
+}
+
+// Cargar las mediciones de una corrida anterior (el mismo formato que --json)
+static int load_baseline(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    while (baseline_len < MAX_BASELINE && fgets(line, sizeof(line), f)) {
+        baseline_t *b = &baseline[baseline_len];
+        if (sscanf(line, "{\"bench\":\"%63[^\"]\",\"n\":%zu,\"ops\":%*u,\"ns_op\":%lf", b->name, &b->n, &b->ns_op) == 3) {
+            baseline_len++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Pedido típico de un sensor: CON POST data con token de 4 bytes y una lectura
+static size_t sample_post(uint8_t *out, size_t max) {
+    coap_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.ver = 1;
+    pkt.type = COAP_TYPE_CON;
+    pkt.code = COAP_CODE_POST;
+    pkt.message_id = 0x1234;
+    pkt.token_len = 4;
+    memcpy(pkt.token, "\x01\x02\x03\x04", 4);
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+    pkt.payload = (uint8_t*) "23.45";
+    pkt.payload_len = 5;
+    size_t len = 0;
+    coap_build(&pkt, out, &len, max);
+    return len;
+}
+
+// GET data/<id> con token de 8 bytes
+static size_t sample_get(uint8_t *out, size_t max) {
+    coap_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.ver = 1;
+    pkt.type = COAP_TYPE_CON;
+    pkt.code = COAP_CODE_GET;
+    pkt.message_id = 0x4321;
+    pkt.token_len = 8;
+    memcpy(pkt.token, "\x01\x02\x03\x04\x05\x06\x07\x08", 8);
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "123456", 6);
+    size_t len = 0;
+    coap_build(&pkt, out, &len, max);
+    return len;
+}
+
+static void bench_codec(void) {
+    uint8_t post[128], get[128], out[256];
+    size_t post_len = sample_post(post, sizeof(post));
+    size_t get_len = sample_get(get, sizeof(get));
+    coap_packet_t pkt;
+    uint64_t acc = 0;
+
+    // Calentar caché y frecuencia antes de la primera medición
+    for (size_t i = 0; i < iterations / 4; i++) acc += (uint64_t) coap_parse(get, get_len, &pkt);
+
+    mark_t m = mark();
+    for (size_t i = 0; i < iterations; i++) {
+        acc += (uint64_t) coap_parse(post, post_len, &pkt) + pkt.payload_len;
+    }
+    report("coap_parse_post", 0, iterations, m);
+
+    m = mark();
+    for (size_t i = 0; i < iterations; i++) {
+        acc += (uint64_t) coap_parse(get, get_len, &pkt) + pkt.options_count;
+    }
+    report("coap_parse_get", 0, iterations, m);
+
+    // Respuesta piggybacked 2.05 con ETag y una lectura, como la de un GET
+    coap_packet_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.ver = 1;
+    resp.type = COAP_TYPE_ACK;
+    resp.code = COAP_CODE_CONTENT;
+    resp.message_id = 0x4321;
+    resp.token_len = 8;
+    memcpy(resp.token, "\x01\x02\x03\x04\x05\x06\x07\x08", 8);
+    coap_add_option(&resp, COAP_OPTION_ETAG, (const uint8_t*) "\x9a\x3f\x01\x7c", 4);
+    resp.payload = (uint8_t*) "{\"id\":123456,\"value\":\"23.45\"}";
+    resp.payload_len = strlen((const char*) resp.payload);
+    m = mark();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t len = 0;
+        resp.message_id = (uint16_t) i;
+        coap_build(&resp, out, &len, sizeof(out));
+        acc += len + out[3];
+    }
+    report("coap_build", 0, iterations, m);
+
+    coap_parse(get, get_len, &pkt);
+    m = mark();
+    for (size_t i = 0; i < iterations; i++) {
+        acc += (uint64_t) coap_get_uri_id(&pkt);
+        __asm__ volatile("" : : "r"(&pkt) : "memory");
+    }
+    report("coap_get_uri_id", 0, iterations, m);
+    sink = acc;
+}
+
+static void count_record(int id, time_t ts, const char *value, void *ctx) {
+    (void) ts;
+    *(uint64_t*) ctx += (uint64_t) id + (uint8_t) value[0];
+}
+
+static void fill_value(char *buf, size_t max, uint64_t r) {
+    snprintf(buf, max, "%u.%02u", (unsigned) (15 + r % 20), (unsigned) (r >> 8) % 100);
+}
+
+// Medir cada storage_* con n registros (en el proceso hijo)
+static int bench_storage(size_t n) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_suite_%d.json", dir, (int) getpid());
+    storage_options_t opts = { .wal = true, .commit_ms = 0, .commit_bytes = 64 * 1024 };
+    storage_set_options(&opts);
+    if (storage_init(path) != 0) {
+        fprintf(stderr, "no se pudo abrir %s\n", path);
+        return -1;
+    }
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    char value[32], out[64];
+    size_t ops = n < STORAGE_OPS ? n : STORAGE_OPS;
+    uint64_t acc = 0;
+
+    // Carga completa: el costo promedio de storage_add hasta llegar a n
+    mark_t m = mark();
+    for (size_t i = 0; i < n; i++) {
+        fill_value(value, sizeof(value), next_rand(&rng));
+        if (storage_add(value) != 0) {
+            fprintf(stderr, "storage_add falló en %zu\n", i);
+            return -1;
+        }
+    }
+    report("storage_add", n, n, m);
+
+    m = mark();
+    for (size_t i = 0; i < ops; i++) {
+        acc += (uint64_t) storage_get((int) (1 + next_rand(&rng) % n), out, sizeof(out)) + (uint8_t) out[0];
+    }
+    report("storage_get", n, ops, m);
+
+    m = mark();
+    for (size_t i = 0; i < ops; i++) {
+        fill_value(value, sizeof(value), next_rand(&rng));
+        storage_update((int) (1 + next_rand(&rng) % n), value);
+    }
+    report("storage_update", n, ops, m);
+
+    // Páginas de STORAGE_SCAN_MAX registros desde un id al azar
+    size_t scans = ops / STORAGE_SCAN_MAX ? ops / STORAGE_SCAN_MAX : 1;
+    m = mark();
+    for (size_t i = 0; i < scans; i++) {
+        acc += (uint64_t) storage_scan((int) (next_rand(&rng) % n), STORAGE_SCAN_MAX, count_record, &acc);
+    }
+    report("storage_scan", n, scans, m);
+
+    // ids distintos sin orden: 7919 es primo y no divide a los tamaños medidos
+    m = mark();
+    for (size_t i = 0; i < ops; i++) storage_delete((int) (1 + (i * 7919) % n));
+    report("storage_delete", n, ops, m);
+
+    sink = acc;
+    char extra[600];
+    unlink(path);
+    snprintf(extra, sizeof(extra), "%s.wal", path);
+    unlink(extra);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [--only codec|storage] [--max N] [--iterations N] [--dir DIR]\n"
+                    "          [--json PATH] [--baseline PATH] [--threshold PCT]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            max_records = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = fopen(argv[++i], "w");
+            if (!json) {
+                perror("json");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            if (load_baseline(argv[++i]) != 0) {
+                perror("baseline");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iterations == 0) iterations = 1;
+    // El WAL hace fdatasync en cada mutación: en tmpfs se mide el almacenamiento y no el disco
+    struct stat st;
+    if (!dir) dir = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm" : ".";
+
+    if (!only || strcmp(only, "codec") == 0) bench_codec();
+
+    if (!only || strcmp(only, "storage") == 0) {
+        for (size_t n = 1000; n <= max_records; n *= 10) {
+            fflush(NULL);
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+            if (pid == 0) {
+                int res = bench_storage(n);
+                fflush(NULL);
+                _exit(res != 0 ? 1 : regressed ? 2 : 0);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) == 1) {
+                fprintf(stderr, "falló la medición con n=%zu\n", n);
+                return 1;
+            }
+            if (WEXITSTATUS(status) == 2) regressed = true;
+        }
+    }
+
+    if (json) fclose(json);
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,629 @@
+// Generador de carga CoAP: miles de sensores virtuales (cada uno con su propio socket,
+// como un sensor real) envían POST, GET, PUT y DELETE CON/NON a un servidor, a una tasa
+// fija (lazo abierto) o con un pedido en vuelo por sensor (lazo cerrado).
+// Las respuestas se emparejan por token (número de secuencia + sensor) y se verifica el MID.
+// Reporta throughput, pérdidas y latencia p50/p90/p99/p99.9 con un histograma logarítmico,
+// también por clase de respuesta (2.xx, 4.xx, 5.xx) para no mezclar éxitos con errores.
+// GET/PUT/DELETE van a data/1..ids: antes de medir se comprueba que esos ids existan.
+//
+//   ./loadgen [host] [puerto] [--sensors N] [--threads N] [--duration S] [--rate R]
+//             [--mix post,get,put,delete] [--non P] [--ids N] [--no-preload] [--timeout MS]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "coap_packet.h"
+
+#define DEFAULT_SENSORS 1000
+#define DEFAULT_THREADS 4
+#define DEFAULT_DURATION 10
+#define DEFAULT_IDS 1000
+#define DEFAULT_TIMEOUT_MS 2000
+#define WINDOW (1u << 16)            // pedidos en vuelo por hilo (potencia de 2)
+#define MAX_EVENTS 256
+#define PKT_MAX 256
+#define PROBE_IDS 32                 // ids de data/1..ids que se verifican antes de medir
+
+// Histograma de latencias: 32 sub-buckets por potencia de 2 (error relativo < 3.2%)
+#define LAT_SUB_BITS 5
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((40 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef enum { KIND_POST = 0, KIND_GET, KIND_PUT, KIND_DELETE, KINDS } kind_t;
+
+// Clases de respuesta con histograma propio
+enum { CLASS_2XX = 0, CLASS_4XX, CLASS_5XX, CLASSES };
+static const char *class_names[CLASSES] = { "2.xx", "4.xx", "5.xx" };
+
+static const char *kind_names[KINDS] = { "POST", "GET", "PUT", "DELETE" };
+static const uint8_t kind_codes[KINDS] = { COAP_CODE_POST, COAP_CODE_GET, COAP_CODE_PUT, COAP_CODE_DELETE };
+
+typedef struct {
+    const char *host;
+    int port;
+    size_t sensors;
+    size_t threads;
+    unsigned duration;
+    double rate;                     // pedidos/s en total (0 = lazo cerrado)
+    unsigned mix[KINDS];             // pesos de cada tipo de pedido
+    unsigned non_pct;                // porcentaje de pedidos NON
+    size_t ids;                      // GET/PUT/DELETE van a data/1..ids
+    bool preload;
+    unsigned timeout_ms;
+} config_t;
+
+typedef struct {
+    int fd;
+    uint16_t next_mid;
+    bool busy;                       // lazo cerrado: tiene un pedido en vuelo
+} sensor_t;
+
+// Pedido en vuelo, en la ventana del hilo por número de secuencia
+typedef struct {
+    uint64_t sent_at;
+    uint32_t seq;
+    uint32_t sensor;
+    uint16_t mid;
+    uint8_t kind;
+    bool pending;
+} flight_t;
+
+typedef struct {
+    size_t index;
+    pthread_t tid;
+    int ep;
+    sensor_t *sensors;
+    size_t n_sensors;
+    flight_t *window;
+    uint32_t next_seq;
+    uint32_t oldest;
+    uint64_t rng;
+    size_t rr;                       // próximo sensor en lazo abierto
+
+    uint64_t sent[KINDS];
+    uint64_t received[KINDS];
+    uint64_t lost;                   // sin respuesta dentro del timeout
+    uint64_t late;                   // respuestas que llegaron después del timeout o repetidas
+    uint64_t mismatched;             // token desconocido o MID distinto
+    uint64_t separate;               // ACK vacíos: la respuesta llega después como CON
+    uint64_t codes[256];
+    uint64_t hist[LAT_BUCKETS];
+    uint64_t lat_max;
+    uint64_t class_hist[CLASSES][LAT_BUCKETS];
+    uint64_t class_count[CLASSES];
+    uint64_t class_max[CLASSES];
+} worker_t;
+
+static config_t cfg;
+static struct sockaddr_in server_addr;
+static unsigned mix_total = 0;
+static uint64_t start_ns, end_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static size_t bucket_of(uint64_t v) {
+    if (v < LAT_SUB) return (size_t) v;
+    unsigned e = 63 - (unsigned) __builtin_clzll(v);
+    size_t idx = (size_t) (e - LAT_SUB_BITS + 1) * LAT_SUB + ((v >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+    return idx < LAT_BUCKETS ? idx : LAT_BUCKETS - 1;
+}
+
+static uint64_t bucket_lower(size_t idx) {
+    if (idx < LAT_SUB) return idx;
+    unsigned e = (unsigned) (idx / LAT_SUB) + LAT_SUB_BITS - 1;
+    return (uint64_t) (LAT_SUB + idx % LAT_SUB) << (e - LAT_SUB_BITS);
+}
+
+// Percentil q (0..1) en ns: punto medio del bucket donde cae
+static double percentile(const uint64_t *hist, uint64_t total, uint64_t max, double q) {
+    if (total == 0) return 0;
+    uint64_t target = (uint64_t) (q * (double) total + 0.999999), seen = 0;
+    if (target == 0) target = 1;
+    for (size_t k = 0; k < LAT_BUCKETS; k++) {
+        seen += hist[k];
+        if (seen >= target) {
+            double lo = (double) bucket_lower(k);
+            double hi = (k + 1 < LAT_BUCKETS) ? (double) bucket_lower(k + 1) : lo;
+            double mid = (lo + hi) / 2;
+            return mid < (double) max ? mid : (double) max;
+        }
+    }
+    return (double) max;
+}
+
+static int open_sensor_socket(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*) &server_addr, sizeof(server_addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static kind_t pick_kind(uint64_t *rng) {
+    unsigned r = (unsigned) (next_rand(rng) % mix_total);
+    for (int k = 0; k < KINDS; k++) {
+        if (r < cfg.mix[k]) return (kind_t) k;
+        r -= cfg.mix[k];
+    }
+    return KIND_POST;
+}
+
+// Armar el pedido con coap_build. El token lleva la secuencia y el sensor
+static size_t build_request(uint8_t *out, kind_t kind, bool non, uint16_t mid, uint32_t seq, uint32_t sensor,
+                            uint64_t *rng) {
+    coap_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.ver = 1;
+    pkt.type = non ? COAP_TYPE_NON : COAP_TYPE_CON;
+    pkt.code = kind_codes[kind];
+    pkt.message_id = mid;
+    pkt.token_len = 8;
+    for (int i = 0; i < 4; i++) {
+        pkt.token[i] = (uint8_t) (seq >> (24 - 8 * i));
+        pkt.token[4 + i] = (uint8_t) (sensor >> (24 - 8 * i));
+    }
+
+    char id[16], value[16];
+    coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+    if (kind != KIND_POST) {
+        int len = snprintf(id, sizeof(id), "%llu", (unsigned long long) (1 + next_rand(rng) % cfg.ids));
+        coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) id, (uint16_t) len);
+    }
+    if (kind == KIND_POST || kind == KIND_PUT) {
+        uint64_t r = next_rand(rng);
+        int len = snprintf(value, sizeof(value), "%u.%02u", (unsigned) (15 + r % 20), (unsigned) (r >> 8) % 100);
+        pkt.payload = (uint8_t*) value;
+        pkt.payload_len = (size_t) len;
+    }
+
+    size_t out_len = 0;
+    if (coap_build(&pkt, out, &out_len, PKT_MAX) != 0) return 0;
+    return out_len;
+}
+
+static void send_request(worker_t *w, uint32_t s) {
+    sensor_t *sensor = &w->sensors[s];
+    kind_t kind = pick_kind(&w->rng);
+    bool non = (next_rand(&w->rng) % 100) < cfg.non_pct;
+    uint32_t seq = w->next_seq;
+    flight_t *f = &w->window[seq & (WINDOW - 1)];
+    if (f->pending) {
+        // La ventana dio toda la vuelta: ese pedido se da por perdido
+        f->pending = false;
+        w->lost++;
+        if (cfg.rate == 0) w->sensors[f->sensor].busy = false;
+    }
+
+    uint8_t buf[PKT_MAX];
+    uint16_t mid = sensor->next_mid++;
+    size_t len = build_request(buf, kind, non, mid, seq, (uint32_t) (w->index << 24 | s), &w->rng);
+    // La hora se toma antes de send: la respuesta puede llegar antes de que send retorne
+    uint64_t sent_at = now_ns();
+    if (len == 0 || send(sensor->fd, buf, len, 0) < 0) return;
+
+    w->next_seq++;
+    f->seq = seq;
+    f->sensor = s;
+    f->mid = mid;
+    f->kind = (uint8_t) kind;
+    f->sent_at = sent_at;
+    f->pending = true;
+    sensor->busy = true;
+    w->sent[kind]++;
+}
+
+// Emparejar una respuesta con su pedido. Una respuesta separada (CON) se confirma con un ACK vacío
+static void handle_response(worker_t *w, int fd, const uint8_t *buf, size_t len, uint64_t now) {
+    coap_packet_t pkt;
+    if (coap_parse(buf, len, &pkt) != 0) {
+        w->mismatched++;
+        return;
+    }
+    if (pkt.type == COAP_TYPE_ACK && pkt.code == COAP_CODE_EMPTY) {
+        w->separate++;
+        return;
+    }
+    if (pkt.type == COAP_TYPE_CON) {
+        uint8_t ack[4] = { (1 << 6) | (COAP_TYPE_ACK << 4), COAP_CODE_EMPTY,
+                           (uint8_t) (pkt.message_id >> 8), (uint8_t) (pkt.message_id & 0xFF) };
+        send(fd, ack, sizeof(ack), 0);
+    }
+    if (pkt.token_len != 8) {
+        w->mismatched++;
+        return;
+    }
+    uint32_t seq = 0, tag = 0;
+    for (int i = 0; i < 4; i++) {
+        seq = (seq << 8) | pkt.token[i];
+        tag = (tag << 8) | pkt.token[4 + i];
+    }
+    flight_t *f = &w->window[seq & (WINDOW - 1)];
+    if ((tag >> 24) != w->index || f->seq != seq || f->sensor != (tag & 0xFFFFFF)) {
+        w->mismatched++;
+        return;
+    }
+    if (!f->pending) {
+        w->late++;
+        return;
+    }
+    // Las respuestas piggybacked (ACK) y las NON llevan el MID del pedido
+    if (pkt.message_id != f->mid && pkt.type == COAP_TYPE_ACK) {
+        w->mismatched++;
+        return;
+    }
+
+    f->pending = false;
+    uint64_t lat = now - f->sent_at;
+    w->hist[bucket_of(lat)]++;
+    if (lat > w->lat_max) w->lat_max = lat;
+    int cls = (pkt.code >> 5) == 2 ? CLASS_2XX : (pkt.code >> 5) == 4 ? CLASS_4XX : CLASS_5XX;
+    w->class_hist[cls][bucket_of(lat)]++;
+    w->class_count[cls]++;
+    if (lat > w->class_max[cls]) w->class_max[cls] = lat;
+    w->received[f->kind]++;
+    w->codes[pkt.code]++;
+    w->sensors[f->sensor].busy = false;
+    if (cfg.rate == 0 && now < end_ns) send_request(w, f->sensor);
+}
+
+// Dar por perdidos los pedidos más viejos que el timeout (en lazo cerrado el sensor vuelve a enviar)
+static void sweep_timeouts(worker_t *w, uint64_t now, bool all) {
+    uint64_t timeout = (uint64_t) cfg.timeout_ms * 1000000ull;
+    while (w->oldest != w->next_seq) {
+        flight_t *f = &w->window[w->oldest & (WINDOW - 1)];
+        if (f->seq == w->oldest && f->pending) {
+            if (!all && now - f->sent_at < timeout) break;
+            f->pending = false;
+            w->lost++;
+            w->sensors[f->sensor].busy = false;
+            if (cfg.rate == 0 && now < end_ns) send_request(w, f->sensor);
+        }
+        w->oldest++;
+    }
+}
+
+static void drain_socket(worker_t *w, int fd) {
+    uint8_t buf[1500];
+    while (1) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;   // EAGAIN: vacío (ECONNREFUSED: no hay servidor, el pedido vence por timeout)
+        }
+        handle_response(w, fd, buf, (size_t) n, now_ns());
+    }
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+    double interval = cfg.rate > 0 ? 1e9 * (double) cfg.threads / cfg.rate : 0;
+    double next_send = (double) start_ns;
+
+    if (cfg.rate == 0) {
+        for (size_t s = 0; s < w->n_sensors; s++) send_request(w, (uint32_t) s);
+    }
+
+    uint64_t now = now_ns();
+    uint64_t last_sweep = now;
+    uint64_t grace = end_ns + (uint64_t) cfg.timeout_ms * 1000000ull;
+    while (now < grace) {
+        if (cfg.rate > 0 && now < end_ns) {
+            // Lazo abierto: enviar todo lo que ya venció según la tasa, rotando sensores
+            while (next_send <= (double) now) {
+                send_request(w, (uint32_t) w->rr);
+                w->rr = (w->rr + 1) % w->n_sensors;
+                next_send += interval;
+            }
+        }
+        if (now >= end_ns && w->oldest == w->next_seq) break;   // nada en vuelo
+
+        int wait_ms = 1;
+        if (cfg.rate > 0 && now < end_ns && next_send - (double) now < 1e6) wait_ms = 0;
+        int n = epoll_wait(w->ep, events, MAX_EVENTS, wait_ms);
+        for (int i = 0; i < n; i++) drain_socket(w, w->sensors[events[i].data.u32].fd);
+
+        now = now_ns();
+        if (now - last_sweep > 1000000) {
+            sweep_timeouts(w, now, false);
+            last_sweep = now;
+        }
+    }
+    sweep_timeouts(w, now_ns(), true);
+    return NULL;
+}
+
+// Socket bloqueante con timeout de 1 s para la precarga y la verificación
+static int open_control_socket(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*) &server_addr, sizeof(server_addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Cargar cfg.ids registros antes de medir, para que GET/PUT/DELETE encuentren datos
+static int preload(void) {
+    int fd = open_control_socket();
+    if (fd < 0) return -1;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    uint8_t buf[PKT_MAX], in[1500];
+    size_t ok = 0;
+    for (size_t i = 0; i < cfg.ids; i++) {
+        size_t len = build_request(buf, KIND_POST, false, (uint16_t) i, (uint32_t) i, 0xFFFFFFFF, &rng);
+        if (send(fd, buf, len, 0) < 0) break;
+        ssize_t n = recv(fd, in, sizeof(in), 0);
+        coap_packet_t pkt;
+        if (n > 0 && coap_parse(in, (size_t) n, &pkt) == 0 && pkt.code == COAP_CODE_CREATED) ok++;
+    }
+    close(fd);
+    printf("precarga: %zu/%zu registros\n", ok, cfg.ids);
+    return ok == cfg.ids ? 0 : -1;
+}
+
+// Comprobar con GET que data/1..ids existen: el POST global no devuelve el id, así que si la
+// base no estaba vacía la precarga quedó en otros ids y los pedidos medirían el 4.xx de
+// "no encontrado". Verifica el primero, el último y PROBE_IDS - 2 al azar. Retorna los que faltan
+static size_t probe_ids(void) {
+    int fd = open_control_socket();
+    if (fd < 0) return PROBE_IDS;
+    uint64_t rng = 0xD1B54A32D192ED03ull;
+    uint8_t buf[PKT_MAX], in[1500];
+    size_t missing = 0;
+    for (size_t i = 0; i < PROBE_IDS; i++) {
+        size_t id = i == 0 ? 1 : i == 1 ? cfg.ids : 1 + next_rand(&rng) % cfg.ids;
+        coap_packet_t pkt;
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.ver = 1;
+        pkt.type = COAP_TYPE_CON;
+        pkt.code = COAP_CODE_GET;
+        pkt.message_id = (uint16_t) (0xF000 + i);
+        char path[24];
+        int plen = snprintf(path, sizeof(path), "%zu", id);
+        coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) "data", 4);
+        coap_add_option(&pkt, COAP_OPTION_URI_PATH, (const uint8_t*) path, (uint16_t) plen);
+        size_t len = 0;
+        ssize_t n = -1;
+        if (coap_build(&pkt, buf, &len, PKT_MAX) == 0 && send(fd, buf, len, 0) >= 0) n = recv(fd, in, sizeof(in), 0);
+        if (n <= 0 || coap_parse(in, (size_t) n, &pkt) != 0 || pkt.code != COAP_CODE_CONTENT) missing++;
+    }
+    close(fd);
+    return missing;
+}
+
+static int parse_mix(const char *text) {
+    unsigned v[KINDS];
+    if (sscanf(text, "%u,%u,%u,%u", &v[0], &v[1], &v[2], &v[3]) != KINDS) return -1;
+    mix_total = 0;
+    for (int k = 0; k < KINDS; k++) {
+        cfg.mix[k] = v[k];
+        mix_total += v[k];
+    }
+    return mix_total > 0 ? 0 : -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [host] [puerto] [--sensors N] [--threads N] [--duration S] [--rate R]\n"
+                    "          [--mix post,get,put,delete] [--non P] [--ids N] [--no-preload] [--timeout MS]\n"
+                    "  --rate 0 (por defecto) = lazo cerrado, un pedido en vuelo por sensor\n", prog);
+}
+
+static int parse_args(int argc, char *argv[]) {
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) {
+            cfg.sensors = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            cfg.threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            cfg.duration = (unsigned) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            cfg.rate = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+            if (parse_mix(argv[++i]) != 0) return -1;
+        } else if (strcmp(argv[i], "--non") == 0 && i + 1 < argc) {
+            cfg.non_pct = (unsigned) strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--ids") == 0 && i + 1 < argc) {
+            cfg.ids = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--no-preload") == 0) {
+            cfg.preload = false;
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            cfg.timeout_ms = (unsigned) strtoul(argv[++i], NULL, 10);
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            return -1;
+        } else if (positional == 0) {
+            cfg.host = argv[i];
+            positional++;
+        } else if (positional == 1) {
+            cfg.port = atoi(argv[i]);
+            positional++;
+        } else {
+            return -1;
+        }
+    }
+    if (cfg.sensors == 0 || cfg.threads == 0 || cfg.ids == 0 || cfg.timeout_ms == 0 || cfg.non_pct > 100) return -1;
+    if (cfg.threads > cfg.sensors) cfg.threads = cfg.sensors;
+    return 0;
+}
+
+static void report(worker_t *workers) {
+    uint64_t sent[KINDS] = {0}, received[KINDS] = {0}, codes[256] = {0}, hist[LAT_BUCKETS] = {0};
+    uint64_t lost = 0, late = 0, mismatched = 0, separate = 0, lat_max = 0, total_sent = 0, total_recv = 0;
+    for (size_t t = 0; t < cfg.threads; t++) {
+        worker_t *w = &workers[t];
+        for (int k = 0; k < KINDS; k++) {
+            sent[k] += w->sent[k];
+            received[k] += w->received[k];
+        }
+        for (int c = 0; c < 256; c++) codes[c] += w->codes[c];
+        for (size_t b = 0; b < LAT_BUCKETS; b++) hist[b] += w->hist[b];
+        lost += w->lost;
+        late += w->late;
+        mismatched += w->mismatched;
+        separate += w->separate;
+        if (w->lat_max > lat_max) lat_max = w->lat_max;
+    }
+    for (int k = 0; k < KINDS; k++) {
+        total_sent += sent[k];
+        total_recv += received[k];
+    }
+    double secs = (double) cfg.duration;
+
+    printf("%-7s %10s %10s\n", "pedido", "enviados", "respuestas");
+    for (int k = 0; k < KINDS; k++) {
+        if (sent[k] > 0) printf("%-7s %10llu %10llu\n", kind_names[k], (unsigned long long) sent[k], (unsigned long long) received[k]);
+    }
+    printf("códigos:");
+    for (int c = 0; c < 256; c++) {
+        if (codes[c] > 0) printf(" %d.%02d=%llu", c >> 5, c & 0x1F, (unsigned long long) codes[c]);
+    }
+    printf("\nperdidos=%llu tardíos=%llu desconocidos=%llu separadas=%llu\n",
+           (unsigned long long) lost, (unsigned long long) late, (unsigned long long) mismatched,
+           (unsigned long long) separate);
+
+    // Latencia por clase: los errores (4.xx) suelen ser mucho más baratos que un éxito
+    for (int c = 0; c < CLASSES; c++) {
+        uint64_t chist[LAT_BUCKETS] = {0}, count = 0, cmax = 0;
+        for (size_t t = 0; t < cfg.threads; t++) {
+            for (size_t b = 0; b < LAT_BUCKETS; b++) chist[b] += workers[t].class_hist[c][b];
+            count += workers[t].class_count[c];
+            if (workers[t].class_max[c] > cmax) cmax = workers[t].class_max[c];
+        }
+        if (count == 0) continue;
+        printf("clase=%s respuestas=%llu p50_us=%.1f p90_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+               class_names[c], (unsigned long long) count, percentile(chist, count, cmax, 0.50) / 1e3,
+               percentile(chist, count, cmax, 0.90) / 1e3, percentile(chist, count, cmax, 0.99) / 1e3,
+               percentile(chist, count, cmax, 0.999) / 1e3, cmax / 1e3);
+    }
+
+    // Línea única para comparar corridas (modos del servidor, regresiones)
+    printf("modo=%s sensores=%zu hilos=%zu enviados=%llu respuestas=%llu resp_s=%.0f perdida=%.3f%% "
+           "p50_us=%.1f p90_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+           cfg.rate > 0 ? "abierto" : "cerrado", cfg.sensors, cfg.threads,
+           (unsigned long long) total_sent, (unsigned long long) total_recv, (double) total_recv / secs,
+           total_sent ? 100.0 * (double) lost / (double) total_sent : 0.0,
+           percentile(hist, total_recv, lat_max, 0.50) / 1e3, percentile(hist, total_recv, lat_max, 0.90) / 1e3,
+           percentile(hist, total_recv, lat_max, 0.99) / 1e3, percentile(hist, total_recv, lat_max, 0.999) / 1e3,
+           lat_max / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+    cfg = (config_t) {
+        .host = "127.0.0.1",
+        .port = 5683,
+        .sensors = DEFAULT_SENSORS,
+        .threads = DEFAULT_THREADS,
+        .duration = DEFAULT_DURATION,
+        .rate = 0,
+        // Sin DELETE por defecto: borraría data/1..ids y nada los vuelve a crear
+        .mix = { 75, 20, 5, 0 },
+        .ids = DEFAULT_IDS,
+        .preload = true,
+        .timeout_ms = DEFAULT_TIMEOUT_MS,
+    };
+    mix_total = 100;
+    if (parse_args(argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons((uint16_t) cfg.port);
+    if (inet_pton(AF_INET, cfg.host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "host inválido: %s\n", cfg.host);
+        return 1;
+    }
+
+    // Un socket por sensor: subir el límite de descriptores hasta el máximo permitido
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < cfg.sensors + 64) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur < cfg.sensors + 64) {
+            fprintf(stderr, "el límite de descriptores (%llu) no alcanza para %zu sensores\n",
+                    (unsigned long long) rl.rlim_cur, cfg.sensors);
+            return 1;
+        }
+    }
+
+    if (cfg.mix[KIND_GET] + cfg.mix[KIND_PUT] + cfg.mix[KIND_DELETE] > 0) {
+        if (cfg.preload && preload() != 0) {
+            fprintf(stderr, "la precarga falló (¿el servidor está corriendo?)\n");
+            return 1;
+        }
+        size_t missing = probe_ids();
+        if (missing > 0) {
+            fprintf(stderr, "%zu de %d ids verificados de data/1..%zu no existen: GET/PUT/DELETE medirían "
+                            "sobre todo 4.xx (usar una base vacía o un --ids que exista)\n", missing, PROBE_IDS, cfg.ids);
+            return 1;
+        }
+        if (cfg.mix[KIND_DELETE] > 0) {
+            fprintf(stderr, "aviso: con DELETE en la mezcla data/1..%zu se va vaciando y GET/PUT/DELETE "
+                            "terminan en 4.xx (ver la latencia de la clase 2.xx)\n", cfg.ids);
+        }
+    }
+
+    worker_t *workers = calloc(cfg.threads, sizeof(worker_t));
+    if (!workers) return 1;
+    for (size_t t = 0; t < cfg.threads; t++) {
+        worker_t *w = &workers[t];
+        w->index = t;
+        w->rng = 0x2545F4914F6CDD1Dull * (t + 1);
+        w->n_sensors = cfg.sensors / cfg.threads + (t < cfg.sensors % cfg.threads ? 1 : 0);
+        w->sensors = calloc(w->n_sensors, sizeof(sensor_t));
+        w->window = calloc(WINDOW, sizeof(flight_t));
+        w->ep = epoll_create1(0);
+        if (!w->sensors || !w->window || w->ep < 0) {
+            fprintf(stderr, "sin memoria para el hilo %zu\n", t);
+            return 1;
+        }
+        for (size_t s = 0; s < w->n_sensors; s++) {
+            w->sensors[s].fd = open_sensor_socket();
+            w->sensors[s].next_mid = (uint16_t) next_rand(&w->rng);
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t) s };
+            if (w->sensors[s].fd < 0 || epoll_ctl(w->ep, EPOLL_CTL_ADD, w->sensors[s].fd, &ev) < 0) {
+                perror("socket");
+                return 1;
+            }
+        }
+    }
+
+    start_ns = now_ns();
+    end_ns = start_ns + (uint64_t) cfg.duration * 1000000000ull;
+    for (size_t t = 0; t < cfg.threads; t++) pthread_create(&workers[t].tid, NULL, worker_main, &workers[t]);
+    for (size_t t = 0; t < cfg.threads; t++) pthread_join(workers[t].tid, NULL);
+
+    report(workers);
+    return 0;
+}
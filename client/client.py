@@ -21,25 +21,36 @@ COAP_CODE_CHANGED = 68   # 2.04
 COAP_CODE_DELETED = 66   # 2.02
 COAP_CODE_BAD_REQ = 128  # 4.00
 
+# Opción Observe (número=6): 0 registra, 1 cancela
+COAP_OPTION_OBSERVE = 6
+
 # Construir paquete CoAP simple
-def build_coap_packet(code, mid, uri_path=None, payload=None, msg_type = COAP_TYPE_CON):
+def build_coap_packet(code, mid, uri_path=None, payload=None, msg_type = COAP_TYPE_CON, token=b'', observe=None):
     version = 1
-    token = b''
 
     first_byte = (version << 6) | (msg_type << 4) | len(token)
     header = bytes([first_byte, code, (mid >> 8) & 0xFF, mid & 0xFF])
     packet = header + token
 
-    # Opciones: Uri-Path (número=11)
+    # Opciones: Uri-Path (número=11) y Uri-Query (número=15, lo que va después de '?')
+    options = []
+    if observe is not None:
+        options.append((COAP_OPTION_OBSERVE, "" if observe == 0 else chr(observe)))
     if uri_path:
+        path, _, query = uri_path.partition('?')
+        options += [(11, segment) for segment in path.split('/') if segment]
+        options += [(15, param) for param in query.split('&') if param]
+    if options:
         prev_opt_num = 0
-        for segment in uri_path.split('/'):
-            if not segment: continue
-            opt_delta = 11 - prev_opt_num
-            prev_opt_num = 11
-            opt_len = len(segment)
-            packet += bytes([ (opt_delta << 4) | opt_len ])
-            packet += segment.encode()
+        for opt_num, value in options:
+            opt_delta = opt_num - prev_opt_num
+            prev_opt_num = opt_num
+            opt_len = len(value)
+            if opt_len < 13:
+                packet += bytes([ (opt_delta << 4) | opt_len ])
+            else:
+                packet += bytes([ (opt_delta << 4) | 13, opt_len - 13 ])
+            packet += value.encode()
 
     # Payload
     if payload:
@@ -48,6 +59,42 @@ def build_coap_packet(code, mid, uri_path=None, payload=None, msg_type = COAP_TY
     return packet
 
 
+# Mostrar una respuesta o notificación
+def print_response(data):
+    print("Respuesta cruda:", data)
+
+    if len(data) >= 4:
+        ver = (data[0] >> 6) & 0x03
+        msg_type = (data[0] >> 4) & 0x03
+        code_resp = data[1]
+        mid_resp = (data[2] << 8) | data[3]
+        print(f"Ver={ver} Type={msg_type} Code={code_resp} MID={mid_resp}")
+
+        if 0xFF in data:
+            i = data.index(0xFF)
+            payload = data[i+1:].decode(errors="ignore")
+            print("Payload:", payload)
+
+
+# Quedarse escuchando las notificaciones de Observe hasta Ctrl+C
+def observe_loop(sock, server, uri, token):
+    sock.settimeout(None)
+    try:
+        while True:
+            data, _ = sock.recvfrom(1500)
+            print_response(data)
+            if len(data) >= 4 and (data[0] >> 4) & 0x03 == COAP_TYPE_CON:
+                # Las notificaciones CON se confirman con un ACK vacío
+                sock.sendto(bytes([(1 << 6) | (COAP_TYPE_ACK << 4), 0, data[2], data[3]]), server)
+            if len(data) >= 2 and data[1] >= 128:
+                print("La observación terminó (el recurso ya no existe)")
+                return
+    except KeyboardInterrupt:
+        mid = random.randint(0, 65535)
+        sock.sendto(build_coap_packet(COAP_CODE_GET, mid, uri_path=uri, token=token, observe=1), server)
+        print("\nObservación cancelada")
+
+
 # Cliente principal
 def main():
     if len(sys.argv) < 3:
@@ -55,16 +102,19 @@ def main():
         print("Ejemplo: python3 client.py 127.0.0.1 GET data/1")
         print("Ejemplo: python3 client.py 127.0.0.1 PUT data/1 \"25\"")
         print("Ejemplo: python3 client.py 127.0.0.1 DELETE data/1")
+        print("Ejemplo: python3 client.py 127.0.0.1 GET data/1 --observe")
+        print("Ejemplo: python3 client.py 127.0.0.1 GET \"data?from=2025-01-01T00:00:00&agg=avg&step=3600\"")
         print("RECORDATORIO: Este cliente es de consulta, no realiza la operacion POST.")
         sys.exit(1)
 
     server_ip = sys.argv[1]
     method = sys.argv[2].upper()
     uri = sys.argv[3]
-    payload = sys.argv[4] if len(sys.argv) > 4 else None
+    payload = sys.argv[4] if len(sys.argv) > 4 and not sys.argv[4].startswith("--") else None
     use_non = False
     if "--non" in sys.argv:
         use_non = True
+    observe = "--observe" in sys.argv
 
     if method == "GET":
         code = COAP_CODE_GET
@@ -79,7 +129,9 @@ def main():
     mid = random.randint(0, 65535)
     msg_type = COAP_TYPE_NON if use_non else COAP_TYPE_CON
     
-    packet = build_coap_packet(code, mid, uri_path=uri, payload=payload, msg_type=msg_type)
+    token = random.randbytes(4) if observe else b''
+    packet = build_coap_packet(code, mid, uri_path=uri, payload=payload, msg_type=msg_type,
+                               token=token, observe=0 if observe else None)
 
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     sock.settimeout(3)
@@ -89,37 +141,14 @@ def main():
 
     try:
         data, _ = sock.recvfrom(1500)
-        print("Respuesta cruda:", data)
-
-        if len(data) >= 4:
-            ver = (data[0] >> 6) & 0x03
-            msg_type = (data[0] >> 4) & 0x03
-            tkl = data[0] & 0x0F
-            code_resp = data[1]
-            mid_resp = (data[2] << 8) | data[3]
-            print(f"Ver={ver} Type={msg_type} Code={code_resp} MID={mid_resp}")
-
-            if 0xFF in data:
-                i = data.index(0xFF)
-                payload = data[i+1:].decode(errors="ignore")
-                print("Payload:", payload)
+        print_response(data)
     except socket.timeout:
         print("Tiempo de espera agotado, retransmitiendo...")
         data, _ = sock.recvfrom(1500)
-        print("Respuesta cruda:", data)
-
-        if len(data) >= 4:
-            ver = (data[0] >> 6) & 0x03
-            msg_type = (data[0] >> 4) & 0x03
-            tkl = data[0] & 0x0F
-            code_resp = data[1]
-            mid_resp = (data[2] << 8) | data[3]
-            print(f"Ver={ver} Type={msg_type} Code={code_resp} MID={mid_resp}")
-
-            if 0xFF in data:
-                i = data.index(0xFF)
-                payload = data[i+1:].decode(errors="ignore")
-                print("Payload:", payload)
+        print_response(data)
+
+    if observe:
+        observe_loop(sock, server, uri, token)
 
     sock.close()
 
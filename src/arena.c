@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "arena.h"
+
+// Reserva que no entró en la arena: se encadena para liberarla en el reset
+typedef struct fallback {
+    struct fallback *next;
+    max_align_t data[];
+} fallback_t;
+
+static _Thread_local _Alignas(ARENA_ALIGN) uint8_t block[ARENA_SIZE];
+static _Thread_local size_t used = 0;
+static _Thread_local size_t peak = 0;        // máximo de este hilo, para no tocar el global en cada reset
+static _Thread_local fallback_t *fallbacks = NULL;
+
+static atomic_size_t high_water = 0;
+static atomic_uint_fast64_t fallback_count = 0;
+static atomic_uint_fast64_t fallback_bytes = 0;
+
+void *arena_alloc(size_t size) {
+    size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if (aligned >= size && aligned <= ARENA_SIZE - used) {
+        void *p = block + used;
+        used += aligned;
+        return p;
+    }
+
+    fallback_t *f = malloc(sizeof(fallback_t) + size);
+    if (!f) return NULL;
+    f->next = fallbacks;
+    fallbacks = f;
+    atomic_fetch_add_explicit(&fallback_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fallback_bytes, size, memory_order_relaxed);
+    return f->data;
+}
+
+void arena_reset(void) {
+    if (used > peak) {
+        peak = used;
+        size_t hw = atomic_load_explicit(&high_water, memory_order_relaxed);
+        while (peak > hw && !atomic_compare_exchange_weak_explicit(&high_water, &hw, peak,
+                                                                    memory_order_relaxed, memory_order_relaxed)) {
+        }
+    }
+    used = 0;
+    while (fallbacks) {
+        fallback_t *next = fallbacks->next;
+        free(fallbacks);
+        fallbacks = next;
+    }
+}
+
+void arena_get_stats(arena_stats_t *st) {
+    st->high_water = atomic_load_explicit(&high_water, memory_order_relaxed);
+    st->fallbacks = atomic_load_explicit(&fallback_count, memory_order_relaxed);
+    st->fallback_bytes = atomic_load_explicit(&fallback_bytes, memory_order_relaxed);
+}
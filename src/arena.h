@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Arena por hilo para la memoria temporal de un pedido (buffers de los handlers, payloads
+// de respuesta): cada reserva avanza un puntero dentro de un bloque fijo de ARENA_SIZE y
+// arena_reset libera todo junto en O(1) antes del pedido siguiente. Lo que no entra sale de
+// malloc (fallback) y se devuelve en el mismo reset, así que nunca falla por falta de lugar.
+
+#define ARENA_SIZE (16 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct {
+    size_t high_water;               // bytes máximos usados por un pedido (cualquier hilo)
+    uint64_t fallbacks;              // reservas que no entraron en la arena
+    uint64_t fallback_bytes;
+} arena_stats_t;
+
+// Reservar size bytes alineados a ARENA_ALIGN, válidos hasta el próximo arena_reset del hilo.
+// Retorna NULL sólo si tampoco hay memoria en el heap
+void *arena_alloc(size_t size);
+
+// Liberar todo lo reservado por este hilo desde el reset anterior
+void arena_reset(void);
+
+void arena_get_stats(arena_stats_t *st);
+
+#endif
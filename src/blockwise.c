@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "blockwise.h"
+#include "storage.h"
+#include "partition.h"
+
+#define PENDING_CAP (16 * 1024)     // texto ya generado y todavía no entregado
+#define UPLOAD_LINE_MAX 100         // mismo límite que un POST individual
+
+// Estado de una exportación: dónde va el cursor y el último bloque (para retransmisiones)
+typedef struct {
+    int state;                  // 0 = falta '[', 1 = registros, 2 = terminado
+    int last_id;                // último id ya generado
+    char sensor[PARTITION_NAME_MAX + 1];    // partición que se exporta ("" = los registros globales)
+    bool first;
+    bool full;                  // pending no admite más registros en esta pasada
+    uint64_t produced;          // bytes entregados desde el inicio
+    time_t stamp_minute;        // minuto ya formateado en stamp (sólo cambian los segundos)
+    char stamp[32];
+    char pending[PENDING_CAP];
+    size_t pending_len, pending_off;
+    bool has_last;
+    uint64_t last_offset;
+    size_t last_len, last_size;
+    bool last_more;
+    uint8_t last_block[1024];
+} export_t;
+
+// Estado de una carga masiva: próximo bloque esperado y la línea que quedó partida
+typedef struct {
+    uint32_t next_num;
+    bool done;
+    size_t added;
+    size_t line_len;
+    bool overflow;
+    char line[UPLOAD_LINE_MAX + 1];
+} upload_t;
+
+typedef struct {
+    struct sockaddr_in peer;
+    bool used;
+    int refs;                   // pedidos en curso (no se puede reutilizar mientras > 0)
+    time_t last_used;
+    pthread_mutex_t lock;
+    union {
+        export_t exp;
+        upload_t up;
+    };
+} session_t;
+
+static session_t exports[BLOCK_SESSIONS];
+static session_t uploads[BLOCK_SESSIONS];
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void init_sessions(void) {
+    for (size_t i = 0; i < BLOCK_SESSIONS; i++) {
+        pthread_mutex_init(&exports[i].lock, NULL);
+        pthread_mutex_init(&uploads[i].lock, NULL);
+    }
+}
+
+static bool same_peer(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Tomar la sesión del endpoint (o una libre / vencida / la más vieja). Queda bloqueada.
+// fresh indica que la sesión es nueva y hay que inicializar su estado
+static session_t *acquire(session_t *table, const struct sockaddr_in *peer, bool *fresh) {
+    pthread_once(&init_once, init_sessions);
+    time_t now = time(NULL);
+    session_t *match = NULL, *victim = NULL;
+
+    pthread_mutex_lock(&table_mutex);
+    for (size_t i = 0; i < BLOCK_SESSIONS && !match; i++) {
+        session_t *s = &table[i];
+        if (s->used && same_peer(&s->peer, peer)) {
+            match = s;
+        } else if (s->refs == 0) {
+            bool expired = !s->used || now - s->last_used > BLOCK_SESSION_TIMEOUT;
+            if (!victim || (expired && victim->used) || (victim->used && s->last_used < victim->last_used)) victim = s;
+        }
+    }
+    *fresh = false;
+    if (!match && victim) {
+        match = victim;
+        match->used = true;
+        match->peer = *peer;
+        *fresh = true;
+    }
+    if (match) {
+        match->refs++;
+        match->last_used = now;
+    }
+    pthread_mutex_unlock(&table_mutex);
+
+    if (match) pthread_mutex_lock(&match->lock);
+    return match;
+}
+
+static void release(session_t *s) {
+    pthread_mutex_unlock(&s->lock);
+    pthread_mutex_lock(&table_mutex);
+    s->refs--;
+    s->last_used = time(NULL);
+    pthread_mutex_unlock(&table_mutex);
+}
+
+static void export_reset(export_t *e) {
+    e->state = 0;
+    e->last_id = 0;
+    e->first = true;
+    e->produced = 0;
+    e->pending_len = e->pending_off = 0;
+    e->has_last = false;
+    e->stamp_minute = -1;
+}
+
+// Agregar un registro al texto pendiente, como en data.json
+static void render_record(int id, time_t ts, const char *value, void *ctx) {
+    export_t *e = (export_t*) ctx;
+    if (e->full) return;
+
+    // localtime_r domina el costo por registro: se reutiliza mientras no cambie el minuto
+    time_t minute = ts - ts % 60;
+    if (minute != e->stamp_minute) {
+        struct tm tm_info;
+        localtime_r(&ts, &tm_info);
+        strftime(e->stamp, sizeof(e->stamp), "%Y-%m-%dT%H:%M:", &tm_info);
+        e->stamp_minute = minute;
+    }
+    char stamp[40];
+    snprintf(stamp, sizeof(stamp), "%s%02d", e->stamp, (int) (ts % 60));
+
+    size_t room = PENDING_CAP - e->pending_len;
+    int n = snprintf(e->pending + e->pending_len, room, "%s{\"id\":%d,\"ts\":\"%s\",\"value\":\"%s\"}",
+                     e->first ? "" : ",", id, stamp, value);
+    if (n < 0 || (size_t) n >= room) {
+        // No entra: se vuelve a pedir en la próxima pasada (salvo que no entre ni con el buffer vacío)
+        if (e->pending_len == 0) e->last_id = id;
+        e->full = true;
+        return;
+    }
+    e->pending_len += (size_t) n;
+    e->first = false;
+    e->last_id = id;
+}
+
+// Generar el siguiente tramo de texto
+static void export_refill(export_t *e) {
+    e->pending_len = e->pending_off = 0;
+    if (e->state == 0) {
+        e->pending[e->pending_len++] = '[';
+        e->state = 1;
+        return;
+    }
+    if (e->state == 1) {
+        e->full = false;
+        int prev_id = e->last_id;
+        int visited = e->sensor[0] ? partition_scan(e->sensor, e->last_id, STORAGE_SCAN_MAX, render_record, e)
+                                   : storage_scan(e->last_id, STORAGE_SCAN_MAX, render_record, e);
+        if (visited == 0 || (e->pending_len == 0 && e->last_id == prev_id)) {
+            e->pending[e->pending_len++] = ']';
+            e->state = 2;
+        }
+    }
+}
+
+// Copiar hasta want bytes del flujo de la exportación
+static size_t export_read(export_t *e, uint8_t *out, size_t want) {
+    size_t n = 0;
+    while (n < want) {
+        if (e->pending_off == e->pending_len) {
+            if (e->state == 2) break;
+            export_refill(e);
+            continue;
+        }
+        size_t chunk = e->pending_len - e->pending_off;
+        if (chunk > want - n) chunk = want - n;
+        if (out) memcpy(out + n, e->pending + e->pending_off, chunk);
+        e->pending_off += chunk;
+        n += chunk;
+    }
+    e->produced += n;
+    return n;
+}
+
+static bool export_done(export_t *e) {
+    // Completar el estado si sólo falta el cierre, para anunciar M=0 en el último bloque
+    if (e->pending_off == e->pending_len && e->state == 1) export_refill(e);
+    return e->state == 2 && e->pending_off == e->pending_len;
+}
+
+int block_export(const struct sockaddr_in *peer, const char *sensor, const coap_block_t *req, coap_block_t *resp,
+                 uint8_t *payload, size_t *len) {
+    if (!sensor) sensor = "";
+    uint8_t szx = req ? req->szx : BLOCK_DEFAULT_SZX;
+    if (szx > BLOCK_DEFAULT_SZX) szx = BLOCK_DEFAULT_SZX;
+    uint32_t num = req ? req->num : 0;
+    size_t size = COAP_BLOCK_SIZE(szx);
+    uint64_t offset = (uint64_t) num * size;
+
+    bool fresh;
+    session_t *s = acquire(exports, peer, &fresh);
+    if (!s) return -1;
+    export_t *e = &s->exp;
+    // Pasar a exportar otro recurso también reinicia el cursor
+    if (fresh || offset == 0 || strcmp(e->sensor, sensor) != 0) {
+        export_reset(e);
+        snprintf(e->sensor, sizeof(e->sensor), "%s", sensor);
+    }
+
+    int res = 0;
+    if (e->has_last && offset == e->last_offset && size == e->last_size) {
+        // Retransmisión del último bloque
+        memcpy(payload, e->last_block, e->last_len);
+        *len = e->last_len;
+        resp->more = e->last_more;
+    } else {
+        // Un pedido hacia atrás reinicia el cursor; uno salteado avanza descartando
+        if (offset < e->produced) export_reset(e);
+        while (e->produced < offset && export_read(e, NULL, offset - e->produced) > 0) {}
+
+        if (e->produced < offset) {
+            res = -1;
+        } else {
+            *len = export_read(e, payload, size);
+            resp->more = !export_done(e);
+            memcpy(e->last_block, payload, *len);
+            e->last_len = *len;
+            e->last_offset = offset;
+            e->last_size = size;
+            e->last_more = resp->more;
+            e->has_last = true;
+        }
+    }
+    resp->num = num;
+    resp->szx = szx;
+    release(s);
+    return res;
+}
+
+// Guardar una línea completa de la carga
+static int upload_line(upload_t *u) {
+    if (u->overflow || u->line_len == 0) {
+        u->line_len = 0;
+        u->overflow = false;
+        return 0;
+    }
+    u->line[u->line_len] = '\0';
+    u->line_len = 0;
+    if (storage_add(u->line) != 0) return -1;
+    u->added++;
+    return 0;
+}
+
+int block_upload(const struct sockaddr_in *peer, const coap_block_t *block,
+                 const uint8_t *data, size_t len, size_t *added) {
+    bool fresh;
+    session_t *s = acquire(uploads, peer, &fresh);
+    if (!s) return -1;
+    upload_t *u = &s->up;
+
+    if (block->num == 0 && (fresh || u->next_num != 1 || u->done)) {
+        memset(u, 0, sizeof(*u));
+    } else if (fresh) {
+        release(s);
+        return -2;
+    }
+
+    int res;
+    if (block->num + 1 == u->next_num) {
+        // Retransmisión de un bloque ya guardado: sólo se vuelve a confirmar
+        res = u->done ? 0 : 1;
+    } else if (block->num != u->next_num || u->done) {
+        res = -2;
+    } else {
+        res = 0;
+        for (size_t i = 0; i < len && res == 0; i++) {
+            char c = (char) data[i];
+            if (c == '\n' || c == '\r') {
+                res = upload_line(u);
+            } else if (u->line_len < UPLOAD_LINE_MAX) {
+                u->line[u->line_len++] = c;
+            } else {
+                u->overflow = true;   // línea demasiado larga: se descarta entera
+            }
+        }
+        if (res == 0 && !block->more) {
+            res = upload_line(u);
+            u->done = true;
+        }
+        u->next_num++;
+        if (res == 0 && block->more) res = 1;
+    }
+    *added = u->added;
+    release(s);
+    return res;
+}
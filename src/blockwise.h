@@ -0,0 +1,32 @@
+#ifndef BLOCKWISE_H
+#define BLOCKWISE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "coap_packet.h"
+
+// Transferencias por bloques (RFC 7959), una sesión por endpoint.
+// Block2: exportación de todos los registros (GET data) o de los de un sensor
+// (GET data/<sensor>) como un arreglo JSON que produce un cursor sobre storage_scan o
+// partition_scan; cada bloque se genera al pedirlo, así el resultado completo nunca está en memoria.
+// Block1: carga masiva (POST data con Block1), un valor por línea, que se guarda
+// bloque a bloque a medida que llega.
+
+#define BLOCK_SESSIONS 64            // transferencias simultáneas de cada tipo
+#define BLOCK_SESSION_TIMEOUT 60     // segundos sin pedidos antes de reutilizar una sesión
+#define BLOCK_DEFAULT_SZX 6          // 1024 bytes si el cliente no pide otro tamaño
+
+// Producir el bloque pedido de la exportación (req NULL = primer bloque con el tamaño por defecto)
+// de la partición sensor, o de los registros globales si es NULL. resp recibe la opción Block2
+// de la respuesta y payload (de al menos 1024 bytes) el contenido
+int block_export(const struct sockaddr_in *peer, const char *sensor, const coap_block_t *req, coap_block_t *resp,
+                 uint8_t *payload, size_t *len);
+
+// Guardar un bloque de una carga masiva. Retorna 1 si faltan bloques (2.31 Continue),
+// 0 si terminó (added = valores guardados en total), -2 si no es el bloque esperado (4.08)
+// y -1 si falla el almacenamiento
+int block_upload(const struct sockaddr_in *peer, const coap_block_t *block,
+                 const uint8_t *data, size_t len, size_t *added);
+
+#endif
@@ -1,12 +1,5 @@
 #include "coap_packet.h"
 
-// Macros que nos ayudaran más adelante :)
-#define COAP_VER(b) (((b)[0] & 0xC0) >> 6)
-#define COAP_TYPE(b) (((b)[0] & 0x30) >> 4)
-#define COAP_TKL(b) ((b)[0] & 0x0F)
-#define COAP_CODE(b) ((b)[1])
-#define COAP_MID(b) (((uint16_t)(b)[2] << 8) | (b)[3])
-
 // Validamos el paquete que se recibe
 bool coap_validate(const coap_packet_t *paquete){
     if (paquete->ver != 0x01) return false;
@@ -14,9 +7,165 @@ bool coap_validate(const coap_packet_t *paquete){
     return true;
 }
 
+const coap_option_t *coap_find_option(const coap_packet_t *paquete, uint16_t number){
+    size_t count = paquete->options_count > COAP_MAX_OPTIONS ? COAP_MAX_OPTIONS : paquete->options_count;
+    if (number < COAP_OPTION_INDEX) {
+        if (!(paquete->option_mask & (1ULL << number))) return NULL;
+        uint8_t pos = paquete->option_index[number];
+        return pos < count ? &paquete->options[pos] : NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (paquete->options[i].number == number) return &paquete->options[i];
+    }
+    return NULL;
+}
+
+const coap_option_t *coap_next_option(const coap_packet_t *paquete, const coap_option_t *prev){
+    size_t count = paquete->options_count > COAP_MAX_OPTIONS ? COAP_MAX_OPTIONS : paquete->options_count;
+    for (size_t i = (size_t) (prev - paquete->options) + 1; i < count; i++) {
+        if (paquete->options[i].number == prev->number) return &paquete->options[i];
+    }
+    return NULL;
+}
+
+int coap_get_path(const coap_packet_t *paquete, const coap_option_t *segments[], size_t max){
+    size_t n = 0;
+    for (const coap_option_t *opt = coap_find_option(paquete, COAP_OPTION_URI_PATH); opt; opt = coap_next_option(paquete, opt)) {
+        if (n == max) return -1;
+        segments[n++] = opt;
+    }
+    return (int) n;
+}
+
+bool coap_option_is(const coap_option_t *opt, const char *text){
+    size_t len = strlen(text);
+    return opt->length == len && memcmp(opt->value, text, len) == 0;
+}
+
+int coap_option_decimal(const coap_option_t *opt, uint32_t *value){
+    if (opt->length == 0 || opt->length > 9) return -1;
+    uint32_t v = 0;
+    for (uint16_t k = 0; k < opt->length; k++) {
+        uint8_t c = opt->value[k];
+        if (c < '0' || c > '9') return -1;
+        v = v * 10 + (c - '0');
+    }
+    *value = v;
+    return 0;
+}
+
+int coap_get_uri_id(const coap_packet_t *paquete){
+    if (!paquete) return -1;
+    for (const coap_option_t *opt = coap_find_option(paquete, COAP_OPTION_URI_PATH); opt; opt = coap_next_option(paquete, opt)) {
+        uint32_t id;
+        if (coap_option_decimal(opt, &id) == 0 && id > 0) return (int) id;
+    }
+    return -1;
+}
+
+// Buscar un parámetro de la consulta entre las opciones Uri-Query
+int coap_get_query(const coap_packet_t *paquete, const char *key, char *out, size_t max_len){
+    size_t key_len = strlen(key);
+    for (const coap_option_t *opt = coap_find_option(paquete, COAP_OPTION_URI_QUERY); opt; opt = coap_next_option(paquete, opt)) {
+        if (opt->length <= key_len || opt->value[key_len] != '=' || memcmp(opt->value, key, key_len) != 0) continue;
+
+        size_t len = opt->length - key_len - 1;
+        if (len >= max_len) return -1;
+        memcpy(out, opt->value + key_len + 1, len);
+        out[len] = '\0';
+        return (int) len;
+    }
+    return -1;
+}
+
+int coap_add_option(coap_packet_t *paquete, uint16_t number, const uint8_t *value, uint16_t length){
+    if (paquete->options_count >= COAP_MAX_OPTIONS) return -1;
+    coap_option_t *opt = &paquete->options[paquete->options_count++];
+    opt->number = number;
+    opt->length = length;
+    opt->value = (uint8_t*) value;
+    if (number < COAP_OPTION_INDEX && !(paquete->option_mask & (1ULL << number))) {
+        paquete->option_mask |= 1ULL << number;
+        paquete->option_index[number] = (uint8_t) (paquete->options_count - 1);
+    }
+    return 0;
+}
+
+int coap_get_block(const coap_packet_t *paquete, uint16_t number, coap_block_t *block){
+    const coap_option_t *opt = coap_find_option(paquete, number);
+    if (!opt) return -1;
+    if (opt->length > 3) return -2;
+
+    uint32_t v = 0;
+    for (uint16_t k = 0; k < opt->length; k++) v = (v << 8) | opt->value[k];
+    block->num = v >> 4;
+    block->more = (v >> 3) & 1;
+    block->szx = v & 0x07;
+    return block->szx > COAP_BLOCK_MAX_SZX ? -2 : 0;
+}
+
+uint16_t coap_encode_block(const coap_block_t *block, uint8_t out[3]){
+    uint32_t v = (block->num << 4) | ((uint32_t) block->more << 3) | (block->szx & 0x07);
+    uint8_t buf[4];
+    uint16_t len = coap_encode_uint(v & 0xFFFFFF, buf);
+    memcpy(out, buf, len);
+    return len;
+}
+
+int coap_get_uint(const coap_packet_t *paquete, uint16_t number, uint32_t *value){
+    const coap_option_t *opt = coap_find_option(paquete, number);
+    if (!opt) return -1;
+    if (opt->length > 4) return -2;
+
+    uint32_t v = 0;
+    for (uint16_t k = 0; k < opt->length; k++) v = (v << 8) | opt->value[k];
+    *value = v;
+    return 0;
+}
+
+uint16_t coap_encode_uint(uint32_t value, uint8_t out[4]){
+    uint16_t len = value == 0 ? 0 : value < 0x100 ? 1 : value < 0x10000 ? 2 : value < 0x1000000 ? 3 : 4;
+    for (uint16_t k = 0; k < len; k++) out[k] = (uint8_t) (value >> (8 * (len - 1 - k)));
+    return len;
+}
+
+// Escribir el delta o la longitud de una opción: nibble y bytes extendidos
+static size_t option_nibble(uint16_t v, uint8_t *nibble, uint8_t ext[2]){
+    if (v < 13) {
+        *nibble = (uint8_t) v;
+        return 0;
+    }
+    if (v < 269) {
+        *nibble = 13;
+        ext[0] = (uint8_t) (v - 13);
+        return 1;
+    }
+    *nibble = 14;
+    ext[0] = (uint8_t) ((v - 269) >> 8);
+    ext[1] = (uint8_t) ((v - 269) & 0xFF);
+    return 2;
+}
+
+// Bytes extendidos y valor base de cada nibble de delta/longitud (RFC 7252 §3.1).
+// El nibble 15 está reservado (sólo es válido como marcador de payload completo 0xFF)
+static const uint8_t nibble_ext[16] = { 0,0,0,0,0,0,0,0,0,0,0,0,0, 1, 2, 0xFF };
+static const uint16_t nibble_base[16] = { 0,1,2,3,4,5,6,7,8,9,10,11,12, 13, 269, 0 };
+
+// Leer un delta o una longitud a partir de su nibble. Retorna 0 o -1 si se sale del buffer
+static inline int read_nibble(uint8_t nibble, const uint8_t *buffer, size_t len, size_t *index, uint32_t *value){
+    uint8_t ext = nibble_ext[nibble];
+    if (ext == 0xFF || *index + ext > len) return -1;
+    uint32_t v = nibble_base[nibble];
+    if (ext == 1) v += buffer[*index];
+    else if (ext == 2) v += ((uint32_t) buffer[*index] << 8) | buffer[*index + 1];
+    *index += ext;
+    *value = v;
+    return 0;
+}
+
 // Extraemos la información de los paquetes que nos llegan
 int coap_parse(const uint8_t *buffer, size_t len, coap_packet_t *paquete){
-    if (len < 4) return -1; // El mensaje es muy corto. Rechazar inmediatamente
+    if (len < 4) return COAP_ERR_SHORT; // El mensaje es muy corto. Rechazar inmediatamente
     // Revisar el primer byte del mensaje (Versión, Tipo, y Longitud del Token)
     paquete->ver = COAP_VER(buffer);
     paquete->type = COAP_TYPE(buffer);
@@ -24,64 +173,63 @@ int coap_parse(const uint8_t *buffer, size_t len, coap_packet_t *paquete){
     // Extraer el código del paquete y el ID del mensaje
     paquete->code = COAP_CODE(buffer);
     paquete->message_id = COAP_MID(buffer);
+    paquete->options_count = 0;
+    paquete->option_mask = 0;
+    paquete->payload = NULL;
+    paquete->payload_len = 0;
 
     // Extraer el token
-    if (paquete->tkl > 8 || 4 + paquete->tkl > len) return -2; // El token es inválido porque la longitud está mal configurada.
+    if (paquete->tkl > 8 || 4u + paquete->tkl > len) return COAP_ERR_TOKEN; // El token es inválido porque la longitud está mal configurada.
     paquete->token_len = paquete->tkl;
     memcpy(paquete->token, buffer + 4, paquete->token_len); // Copia los datos del buffer al token del paquete que estamos recibiendo.
 
+    // Opciones hasta el marcador 0xFF o el fin del datagrama, en una sola pasada.
+    // El conteo y la máscara van en variables locales y se guardan al final
     size_t index = 4 + paquete->token_len;
-    paquete->options_count = 0;
-    uint16_t running_delta = 0;
-    while (index < len && buffer[index] != 0xFF) {
+    size_t count = 0;
+    uint64_t mask = 0;
+    uint32_t number = 0;
+    int res = 0;
+    while (index < len) {
         uint8_t byte = buffer[index++];
-
-        uint16_t opt_delta = (byte & 0xF0) >> 4;
-        uint16_t opt_len   = (byte & 0x0F);
-
-        // Extensiones (si delta=13 o 14, length=13 o 14 → bytes extra)
-        if (opt_delta == 13) { opt_delta = buffer[index++] + 13; }
-        else if (opt_delta == 14) {
-            opt_delta = ((buffer[index]<<8)|buffer[index+1]) + 269;
-            index+=2;
-        }
-
-        if (opt_len == 13) { opt_len = buffer[index++] + 13; }
-        else if (opt_len == 14) {
-            opt_len = ((buffer[index]<<8)|buffer[index+1]) + 269;
-            index+=2;
+        if (byte == 0xFF) {
+            if (index == len) { res = COAP_ERR_PAYLOAD; break; } // Marcador sin payload: mensaje mal formado
+            paquete->payload = (uint8_t*) (buffer + index); // Un apuntador al buffer, no el original
+            paquete->payload_len = len - index;
+            break;
         }
 
-        running_delta += opt_delta;
+        uint32_t delta = byte >> 4, opt_len = byte & 0x0F;
+        // Camino rápido: sin bytes extendidos (delta y longitud menores a 13)
+        if ((delta >= 13 || opt_len >= 13) &&
+            (read_nibble(byte >> 4, buffer, len, &index, &delta) != 0 ||
+             read_nibble(byte & 0x0F, buffer, len, &index, &opt_len) != 0)) { res = COAP_ERR_OPTION; break; }
+        number += delta;
+        if (number > UINT16_MAX || opt_len > UINT16_MAX || opt_len > len - index) { res = COAP_ERR_OPTION; break; }
+        if (count == COAP_MAX_OPTIONS) { res = COAP_ERR_TOO_MANY; break; }
 
-        coap_option_t *opt = &paquete->options[paquete->options_count++];
-        opt->number = running_delta;
-        opt->length = opt_len;
-        opt->value  = (uint8_t*)(buffer + index);
-
-        index += opt_len;
-    }
-    // Buscar el payload del mensaje si hay (el marcador 0xFF)
-    size_t payload_start = 0;
-    for (size_t i = index; i<len; i++){
-        if (buffer[i] == 0xFF){
-            payload_start = i + 1;
-            break;
+        coap_option_t *opt = &paquete->options[count];
+        opt->number = (uint16_t) number;
+        opt->length = (uint16_t) opt_len;
+        opt->value  = (uint8_t*) (buffer + index);
+        // Los números llegan en orden, así que la primera de cada número es la que queda indexada
+        if (number < COAP_OPTION_INDEX && !(mask & (1ULL << number))) {
+            mask |= 1ULL << number;
+            paquete->option_index[number] = (uint8_t) count;
         }
+        count++;
+        index += opt_len;
     }
-    if (payload_start > 0 && payload_start < len){
-        paquete->payload_len = len - payload_start;
-        paquete->payload = (uint8_t*) (buffer + payload_start); // Un apuntador al buffer, no el original
-    } else {
-        paquete->payload = NULL;
-        paquete->payload_len = 0;
-    }
-    return 0; // Si llegamos hasta aquí, es porque extraímos la información del mensaje sin problemas
+    paquete->options_count = count;
+    paquete->option_mask = mask;
+    return res; // 0 si extraímos la información del mensaje sin problemas
 }
 
-int coap_build(const coap_packet_t *paquete, uint8_t *out_buffer, size_t *out_len, size_t max_len){
+// Cabecera, token y opciones (todo menos el payload). Retorna los bytes escritos o -1/-2
+static long build_head(const coap_packet_t *paquete, uint8_t *out_buffer, size_t max_len){
     size_t index = 0;
     if (paquete->token_len > 8) return -1; // Inmediatamente descartar un mensaje con una longitud de token inválida
+    if (4 + paquete->token_len > max_len) return -2;
 
     // Armar el primer byte (Versión, Tipo, y TKL)
     out_buffer[index++] = ((paquete->ver & 0x03) << 6) | ((paquete->type & 0x03) << 4) | (paquete->token_len & 0x0F);
@@ -95,6 +243,43 @@ int coap_build(const coap_packet_t *paquete, uint8_t *out_buffer, size_t *out_le
     memcpy(out_buffer + index, paquete->token, paquete->token_len);
     index += paquete->token_len;
 
+    // Opciones en orden creciente de número (cada una se codifica como delta del anterior)
+    size_t count = paquete->options_count > COAP_MAX_OPTIONS ? COAP_MAX_OPTIONS : paquete->options_count;
+    const coap_option_t *sorted[COAP_MAX_OPTIONS];
+    for (size_t i = 0; i < count; i++) {
+        size_t j = i;
+        while (j > 0 && sorted[j - 1]->number > paquete->options[i].number) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = &paquete->options[i];
+    }
+    uint16_t prev = 0;
+    for (size_t i = 0; i < count; i++) {
+        const coap_option_t *opt = sorted[i];
+        uint8_t dn, ln, dext[2], lext[2];
+        size_t dlen = option_nibble(opt->number - prev, &dn, dext);
+        size_t llen = option_nibble(opt->length, &ln, lext);
+        if (index + 1 + dlen + llen + opt->length > max_len) return -2;
+
+        out_buffer[index++] = (uint8_t) ((dn << 4) | ln);
+        memcpy(out_buffer + index, dext, dlen);
+        index += dlen;
+        memcpy(out_buffer + index, lext, llen);
+        index += llen;
+        if (opt->length) memcpy(out_buffer + index, opt->value, opt->length);
+        index += opt->length;
+        prev = opt->number;
+    }
+
+    return (long) index;
+}
+
+int coap_build(const coap_packet_t *paquete, uint8_t *out_buffer, size_t *out_len, size_t max_len){
+    long head = build_head(paquete, out_buffer, max_len);
+    if (head < 0) return (int) head;
+    size_t index = (size_t) head;
+
     // Payload
     if (paquete->payload && paquete->payload_len > 0){
         if (index + 1 + paquete->payload_len > max_len) return -2; // El payload es más grande de lo que está permitido y se rechaza
@@ -106,3 +291,22 @@ int coap_build(const coap_packet_t *paquete, uint8_t *out_buffer, size_t *out_le
     *out_len = index;
     return 0; // Mensaje construido con éxito
 }
+
+int coap_build_iov(const coap_packet_t *paquete, uint8_t *head, size_t head_cap, size_t max_len,
+                   struct iovec iov[2], size_t *iovcnt){
+    long len = build_head(paquete, head, head_cap);
+    if (len < 0) return (int) len;
+    size_t index = (size_t) len;
+
+    *iovcnt = 1;
+    if (paquete->payload && paquete->payload_len > 0){
+        if (index + 1 > head_cap || index + 1 + paquete->payload_len > max_len) return -2;
+        head[index++] = 0xFF;
+        iov[1].iov_base = paquete->payload;
+        iov[1].iov_len = paquete->payload_len;
+        *iovcnt = 2;
+    }
+    iov[0].iov_base = head;
+    iov[0].iov_len = index;
+    return 0;
+}
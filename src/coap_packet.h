@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
 #define COAP_VER(b) (((b)[0] & 0xC0) >> 6)
 #define COAP_TYPE(b) (((b)[0] & 0x30) >> 4)
@@ -14,6 +15,33 @@
 #define COAP_CODE(b) ((b)[1])
 #define COAP_MID(b) (((uint16_t)(b)[2] << 8) | (b)[3])
 
+// Números de opción que usa el servidor
+#define COAP_OPTION_ETAG 4
+#define COAP_OPTION_OBSERVE 6
+#define COAP_OPTION_LOCATION_PATH 8
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_MAX_AGE 14
+#define COAP_OPTION_URI_QUERY 15
+#define COAP_OPTION_BLOCK2 23
+#define COAP_OPTION_BLOCK1 27
+#define COAP_OPTION_SIZE1 60
+
+// Límites del parser: más opciones que COAP_MAX_OPTIONS se rechazan; las de número menor
+// a COAP_OPTION_INDEX quedan indexadas (acceso O(1)), las demás se buscan recorriendo
+#define COAP_MAX_OPTIONS 16
+#define COAP_OPTION_INDEX 64
+
+// Errores de coap_parse
+#define COAP_ERR_SHORT -1            // menos de 4 bytes
+#define COAP_ERR_TOKEN -2            // TKL mayor a 8 o token cortado
+#define COAP_ERR_OPTION -3           // opción mal formada (nibble 15, extensión o valor fuera del buffer)
+#define COAP_ERR_TOO_MANY -4         // más de COAP_MAX_OPTIONS opciones
+#define COAP_ERR_PAYLOAD -5          // marcador 0xFF sin payload
+
+// Tamaño de bloque según SZX (16 a 1024 bytes; SZX 7 está reservado)
+#define COAP_BLOCK_SIZE(szx) (16u << (szx))
+#define COAP_BLOCK_MAX_SZX 6
+
 // Definimos las opciones de un mensaje
 typedef struct {
     uint16_t number;     // número de opción CoAP (ej. 11 = Uri-Path)
@@ -30,8 +58,10 @@ typedef struct {
     uint16_t message_id;
     uint8_t token[8];
     size_t token_len;
-    coap_option_t options[16];
+    coap_option_t options[COAP_MAX_OPTIONS];
     size_t options_count;
+    uint64_t option_mask;                      // bit n = hay alguna opción con número n (< COAP_OPTION_INDEX)
+    uint8_t option_index[COAP_OPTION_INDEX];   // posición de la primera opción con ese número (válida si su bit está)
     uint8_t *payload;
     size_t payload_len;
 } coap_packet_t;
@@ -57,14 +87,73 @@ typedef enum {
     COAP_CODE_VALID = 67,
     COAP_CODE_CHANGED = 68,
     COAP_CODE_CONTENT = 69,
+    COAP_CODE_CONTINUE = 95,        // 2.31
     // Errores 4.xx
-    COAP_CODE_BAD_REQ = 128
+    COAP_CODE_BAD_REQ = 128,
+    COAP_CODE_NOT_FOUND = 132,      // 4.04
+    COAP_CODE_INCOMPLETE = 136,     // 4.08
+    COAP_CODE_TOO_LARGE = 141,      // 4.13
+    // Errores 5.xx
+    COAP_CODE_UNAVAILABLE = 163     // 5.03
 } coap_code_t;
 
+// Valor de una opción Block1/Block2: número de bloque, si hay más y tamaño
+typedef struct {
+    uint32_t num;
+    bool more;
+    uint8_t szx;
+} coap_block_t;
+
+// Decodificar un datagrama en una sola pasada. Cada longitud se valida contra len y las
+// opciones quedan apuntando al buffer (que debe vivir mientras se use el paquete).
+// Retorna 0 o un COAP_ERR_*
 int coap_parse(const uint8_t *buffer, size_t len, coap_packet_t *paquete);
 
 int coap_build(const coap_packet_t *paquete, uint8_t *out_buffer, size_t *out_len, size_t max_len);
 
+// Variante sin copia del payload: la cabecera, el token, las opciones y el marcador van a
+// head; iov[1] apunta directamente a paquete->payload (que debe vivir hasta el envío).
+// max_len limita el datagrama completo. iovcnt recibe 1 (sin payload) o 2
+int coap_build_iov(const coap_packet_t *paquete, uint8_t *head, size_t head_cap, size_t max_len,
+                   struct iovec iov[2], size_t *iovcnt);
+
 bool coap_validate(const coap_packet_t *paquete);
 
+// Buscar un parámetro Uri-Query ("clave=valor") y copiar su valor terminado en '\0'.
+// Retorna la longitud del valor o -1 si no está (o no cabe en out)
+int coap_get_query(const coap_packet_t *paquete, const char *key, char *out, size_t max_len);
+
+// Agregar una opción a un paquete a construir. value debe vivir hasta coap_build
+int coap_add_option(coap_packet_t *paquete, uint16_t number, const uint8_t *value, uint16_t length);
+
+// Primera opción con ese número, o NULL si no está
+const coap_option_t *coap_find_option(const coap_packet_t *paquete, uint16_t number);
+
+// Siguiente opción con el mismo número que prev (opciones repetibles como Uri-Path o ETag)
+const coap_option_t *coap_next_option(const coap_packet_t *paquete, const coap_option_t *prev);
+
+// Segmentos del Uri-Path en orden. Retorna cuántos hay, o -1 si son más que max
+int coap_get_path(const coap_packet_t *paquete, const coap_option_t *segments[], size_t max);
+
+// true si el valor de la opción es exactamente text
+bool coap_option_is(const coap_option_t *opt, const char *text);
+
+// Leer un segmento decimal (sólo dígitos, hasta 9). Retorna 0 si es válido, -1 si no
+int coap_option_decimal(const coap_option_t *opt, uint32_t *value);
+
+// ID del Uri-Path: el primer segmento decimal positivo (data/<id>). Retorna -1 si no hay
+int coap_get_uri_id(const coap_packet_t *paquete);
+
+// Leer una opción Block1/Block2. Retorna 0 si está y es válida, -1 si no está, -2 si es inválida
+int coap_get_block(const coap_packet_t *paquete, uint16_t number, coap_block_t *block);
+
+// Codificar el valor de una opción Block (hasta 3 bytes). Retorna la longitud
+uint16_t coap_encode_block(const coap_block_t *block, uint8_t out[3]);
+
+// Leer una opción entera sin signo (hasta 4 bytes). Retorna 0 si está, -1 si no, -2 si es inválida
+int coap_get_uint(const coap_packet_t *paquete, uint16_t number, uint32_t *value);
+
+// Codificar un entero sin signo con la menor cantidad de bytes (0 no ocupa bytes). Retorna la longitud
+uint16_t coap_encode_uint(uint32_t value, uint8_t out[4]);
+
 #endif
\ No newline at end of file
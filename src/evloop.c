@@ -0,0 +1,419 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <linux/io_uring.h>
+
+#include "evloop.h"
+#include "server.h"
+#include "netio.h"
+#include "shard.h"
+#include "timer.h"
+#include "ring.h"
+#include "observe.h"
+#include "separate.h"
+#include "metrics.h"
+#include "log.h"
+
+#define MAX_LOOPS 64
+#define URING_SLOTS 128          // recepciones en vuelo por loop
+#define URING_ENTRIES 512
+
+// Etiquetas en user_data de io_uring (índice de slot << 2 | operación)
+#define OP_RECV 0
+#define OP_SEND 1
+#define OP_TIMER 2
+
+typedef struct {
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t rx;
+    atomic_uint_fast64_t tx;
+    atomic_uint_fast64_t wakeups;     // retornos de epoll_wait / io_uring_enter
+    int index;
+    int sock;
+    int cpu;
+    size_t batch;
+    evloop_backend_t backend;
+    pthread_t tid;
+} evloop_t;
+
+static evloop_t loops_state[MAX_LOOPS];
+static size_t loop_count = 0;
+
+int evloop_parse_backend(const char *name, evloop_backend_t *backend) {
+    if (strcmp(name, "epoll") == 0) {
+        *backend = EVLOOP_EPOLL;
+    } else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+        *backend = EVLOOP_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------------------------- Backend epoll ---------------------------- */
+
+// Leer todo lo pendiente en el socket (no bloqueante) por lotes y responder
+static void drain_socket(evloop_t *lp, uint8_t (*in)[MAX_BUF], uint8_t (*out)[MAX_BUF]) {
+    netio_msg_t rx[NETIO_MAX_BATCH], tx[NETIO_MAX_BATCH];
+
+    for (;;) {
+        for (size_t i = 0; i < lp->batch; i++) {
+            rx[i].buf = in[i];
+            rx[i].cap = MAX_BUF;
+        }
+        int n = netio_recv_batch(lp->sock, rx, lp->batch);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_text("[ERROR] Loop %d: error recibiendo: %s", lp->index, strerror(errno));
+            }
+            return;
+        }
+        atomic_fetch_add_explicit(&lp->rx, n, memory_order_relaxed);
+
+        size_t k = 0;
+        for (int i = 0; i < n; i++) {
+            if (process_request(&rx[i].addr, rx[i].buf, rx[i].len, out[k], &tx[k].len, MAX_BUF) == 0) {
+                tx[k].buf = out[k];
+                tx[k].addr = rx[i].addr;
+                k++;
+            }
+        }
+        uint64_t start = metrics_now_ns();
+        int sent = netio_send_batch(lp->sock, tx, k);
+        if (sent > 0) atomic_fetch_add_explicit(&lp->tx, sent, memory_order_relaxed);
+        if (k > 0) metrics_record(METRIC_SEND, (metrics_now_ns() - start) / k, k);
+
+        if ((size_t) n < lp->batch) return; // el socket quedó vacío
+    }
+}
+
+static int loop_epoll(evloop_t *lp) {
+    uint8_t (*in)[MAX_BUF] = malloc(NETIO_MAX_BATCH * MAX_BUF);
+    uint8_t (*out)[MAX_BUF] = malloc(NETIO_MAX_BATCH * MAX_BUF);
+    int ep = epoll_create1(0);
+    if (!in || !out || ep < 0) {
+        free(in);
+        free(out);
+        if (ep >= 0) close(ep);
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = lp->sock };
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, lp->sock, &ev) < 0) {
+        close(ep);
+        free(in);
+        free(out);
+        return -1;
+    }
+
+    while (1) {
+        // Sólo el loop 0 despierta por temporizadores
+        int timeout = (lp->index == 0) ? timer_next_ms() : -1;
+        struct epoll_event events[1];
+        int n = epoll_wait(ep, events, 1, timeout);
+        atomic_fetch_add_explicit(&lp->wakeups, 1, memory_order_relaxed);
+        if (n < 0 && errno != EINTR) {
+            log_text("[ERROR] Loop %d: epoll_wait: %s", lp->index, strerror(errno));
+            break;
+        }
+        if (n > 0) drain_socket(lp, in, out);
+        if (lp->index == 0) timer_run_due();
+    }
+
+    close(ep);
+    free(in);
+    free(out);
+    return -1;
+}
+
+/* --------------------------- Backend io_uring --------------------------- */
+
+// Anillos de io_uring mapeados a mano (sin liburing)
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned pending;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size;
+} uring_t;
+
+// Cada slot tiene su propio buffer de entrada, de salida y cabeceras de mensaje
+typedef struct {
+    uint8_t in[MAX_BUF];
+    uint8_t out[MAX_BUF];
+    struct sockaddr_in addr;
+    struct iovec iov_in, iov_out;
+    struct msghdr msg_in, msg_out;
+    uint64_t send_ns;              // preparación del envío, para medir hasta que se completa
+} uring_slot_t;
+
+static int uring_setup(uring_t *u, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(u, 0, sizeof(*u));
+
+    u->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0) return -1;
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) goto fail;
+    if (single) {
+        u->cq_ptr = u->sq_ptr;
+    } else {
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ptr == MAP_FAILED) goto fail;
+    }
+    u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) goto fail;
+
+    char *sq = u->sq_ptr, *cq = u->cq_ptr;
+    u->sq_head = (unsigned*) (sq + p.sq_off.head);
+    u->sq_tail = (unsigned*) (sq + p.sq_off.tail);
+    u->sq_mask = (unsigned*) (sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*) (sq + p.sq_off.array);
+    u->cq_head = (unsigned*) (cq + p.cq_off.head);
+    u->cq_tail = (unsigned*) (cq + p.cq_off.tail);
+    u->cq_mask = (unsigned*) (cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    u->sq_entries = p.sq_entries;
+    return 0;
+
+fail:
+    close(u->fd);
+    return -1;
+}
+
+// Enviar al kernel las SQE pendientes y esperar al menos una completación
+static int uring_enter(uring_t *u, unsigned wait_nr) {
+    int res;
+    do {
+        res = (int) syscall(__NR_io_uring_enter, u->fd, u->pending, wait_nr,
+                            wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (res < 0 && errno == EINTR);
+    if (res >= 0) u->pending -= (unsigned) res < u->pending ? (unsigned) res : u->pending;
+    return res;
+}
+
+static struct io_uring_sqe *uring_get_sqe(uring_t *u) {
+    unsigned tail = *u->sq_tail;
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= u->sq_entries) {
+        uring_enter(u, 0); // anillo lleno: enviar lo que hay
+        head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= u->sq_entries) return NULL;
+    }
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void uring_commit_sqe(uring_t *u) {
+    __atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+    u->pending++;
+}
+
+static void uring_prep_recv(uring_t *u, int sock, uring_slot_t *slot, uint64_t index) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (!sqe) return;
+    slot->iov_in.iov_base = slot->in;
+    slot->iov_in.iov_len = MAX_BUF;
+    memset(&slot->msg_in, 0, sizeof(slot->msg_in));
+    slot->msg_in.msg_name = &slot->addr;
+    slot->msg_in.msg_namelen = sizeof(slot->addr);
+    slot->msg_in.msg_iov = &slot->iov_in;
+    slot->msg_in.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sock;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->msg_in;
+    sqe->len = 1;
+    sqe->user_data = (index << 2) | OP_RECV;
+    uring_commit_sqe(u);
+}
+
+static void uring_prep_send(uring_t *u, int sock, uring_slot_t *slot, uint64_t index, size_t len) {
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (!sqe) return;
+    slot->iov_out.iov_base = slot->out;
+    slot->iov_out.iov_len = len;
+    memset(&slot->msg_out, 0, sizeof(slot->msg_out));
+    slot->msg_out.msg_name = &slot->addr;
+    slot->msg_out.msg_namelen = sizeof(slot->addr);
+    slot->msg_out.msg_iov = &slot->iov_out;
+    slot->msg_out.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sock;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->msg_out;
+    sqe->len = 1;
+    sqe->user_data = (index << 2) | OP_SEND;
+    uring_commit_sqe(u);
+}
+
+static void uring_prep_timer(uring_t *u, struct __kernel_timespec *ts) {
+    int wait = timer_next_ms();
+    if (wait < 0) return;
+    struct io_uring_sqe *sqe = uring_get_sqe(u);
+    if (!sqe) return;
+    ts->tv_sec = wait / 1000;
+    ts->tv_nsec = (long long) (wait % 1000) * 1000000LL;
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t) (uintptr_t) ts;
+    sqe->len = 1;
+    sqe->user_data = OP_TIMER;
+    uring_commit_sqe(u);
+}
+
+static int loop_uring(evloop_t *lp, uring_t *u) {
+    uring_slot_t *slots = calloc(URING_SLOTS, sizeof(uring_slot_t));
+    if (!slots) return -1;
+
+    struct __kernel_timespec ts;
+    for (uint64_t i = 0; i < URING_SLOTS; i++) uring_prep_recv(u, lp->sock, &slots[i], i);
+    if (lp->index == 0) uring_prep_timer(u, &ts);
+
+    while (1) {
+        if (uring_enter(u, 1) < 0) {
+            log_text("[ERROR] Loop %d: io_uring_enter: %s", lp->index, strerror(errno));
+            break;
+        }
+        atomic_fetch_add_explicit(&lp->wakeups, 1, memory_order_relaxed);
+
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            uint64_t op = cqe->user_data & 3;
+            uint64_t index = cqe->user_data >> 2;
+            int res = cqe->res;
+            head++;
+
+            if (op == OP_TIMER) {
+                timer_run_due();
+                uring_prep_timer(u, &ts);
+                continue;
+            }
+
+            uring_slot_t *slot = &slots[index];
+            if (op == OP_RECV && res > 0) {
+                atomic_fetch_add_explicit(&lp->rx, 1, memory_order_relaxed);
+                size_t out_len;
+                if (process_request(&slot->addr, slot->in, (size_t) res, slot->out, &out_len, MAX_BUF) == 0) {
+                    // El slot vuelve a recibir cuando termine el envío
+                    slot->send_ns = metrics_now_ns();
+                    uring_prep_send(u, lp->sock, slot, index, out_len);
+                    continue;
+                }
+            } else if (op == OP_SEND && res >= 0) {
+                atomic_fetch_add_explicit(&lp->tx, 1, memory_order_relaxed);
+                metrics_record(METRIC_SEND, metrics_now_ns() - slot->send_ns, 1);
+            }
+            uring_prep_recv(u, lp->sock, slot, index);
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    free(slots);
+    return -1;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static int loop_run(evloop_t *lp) {
+    shard_pin_cpu(lp->cpu);
+
+    if (lp->backend == EVLOOP_URING) {
+        uring_t u;
+        if (uring_setup(&u, URING_ENTRIES) == 0) {
+            return loop_uring(lp, &u);
+        }
+        log_text("[WARNING] Loop %d: io_uring no disponible (%s), usando epoll", lp->index, strerror(errno));
+        lp->backend = EVLOOP_EPOLL;
+    }
+    return loop_epoll(lp);
+}
+
+static void *loop_main(void *arg) {
+    loop_run((evloop_t*) arg);
+    return NULL;
+}
+
+int evloop_run(int port, size_t loops, evloop_backend_t backend, size_t batch) {
+    if (loops == 0 || loops > MAX_LOOPS) return -1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+
+    for (size_t i = 0; i < loops; i++) {
+        evloop_t *lp = &loops_state[i];
+        lp->sock = shard_open_socket(port);
+        if (lp->sock < 0) {
+            log_text("[ERROR] Loop %zu: no se pudo abrir el socket: %s", i, strerror(errno));
+            return -1;
+        }
+        fcntl(lp->sock, F_SETFL, fcntl(lp->sock, F_GETFL) | O_NONBLOCK);
+        if (i == 0) {   // las notificaciones y las respuestas separadas salen por el primer loop
+            observe_set_socket(lp->sock);
+            separate_set_socket(lp->sock);
+        }
+        lp->index = (int) i;
+        lp->cpu = (int) (i % (size_t) cpus);
+        lp->batch = (batch > 0) ? batch : 1;
+        lp->backend = backend;
+        atomic_init(&lp->rx, 0);
+        atomic_init(&lp->tx, 0);
+        atomic_init(&lp->wakeups, 0);
+    }
+    loop_count = loops;
+
+    for (size_t i = 1; i < loops; i++) {
+        int res = pthread_create(&loops_state[i].tid, NULL, loop_main, &loops_state[i]);
+        if (res != 0) {
+            log_text("[ERROR] Loop %zu: error creando thread: %s", i, strerror(res));
+            return -1;
+        }
+        pthread_detach(loops_state[i].tid);
+    }
+    return loop_run(&loops_state[0]);
+}
+
+void evloop_report(void) {
+    for (size_t i = 0; i < loop_count; i++) {
+        evloop_t *lp = &loops_state[i];
+        uint64_t rx = atomic_load_explicit(&lp->rx, memory_order_relaxed);
+        uint64_t wakeups = atomic_load_explicit(&lp->wakeups, memory_order_relaxed);
+        log_text("[INFO] Loop %zu (%s, core %d): recibidos=%llu enviados=%llu despertares=%llu (%.1f por despertar)",
+                 i, lp->backend == EVLOOP_URING ? "io_uring" : "epoll", lp->cpu,
+                 (unsigned long long) rx,
+                 (unsigned long long) atomic_load_explicit(&lp->tx, memory_order_relaxed),
+                 (unsigned long long) wakeups, wakeups ? (double) rx / wakeups : 0.0);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stddef.h>
+
+// Backends disponibles para el loop de eventos
+typedef enum {
+    EVLOOP_NONE = 0,     // modelo con hilos bloqueantes (pool o shards)
+    EVLOOP_EPOLL,
+    EVLOOP_URING,
+} evloop_backend_t;
+
+// Traducir "epoll" / "uring" al backend. Retorna -1 si el nombre no existe
+int evloop_parse_backend(const char *name, evloop_backend_t *backend);
+
+// Arrancar un loop por core, cada uno con su socket SO_REUSEPORT.
+// El loop 0 corre en el hilo que llama y además ejecuta los temporizadores.
+// Si io_uring no está disponible se usa epoll. Sólo retorna en caso de error
+int evloop_run(int port, size_t loops, evloop_backend_t backend, size_t batch);
+
+// Registrar en el log los contadores de cada loop
+void evloop_report(void);
+
+#endif
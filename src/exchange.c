@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "exchange.h"
+#include "timer.h"
+#include "slab.h"
+
+#define WHEEL_SLOTS 256              // un slot por segundo, más que el mayor tiempo de vida
+#define SHARD_CAPACITY (EXCHANGE_CAPACITY / EXCHANGE_SHARDS)
+#define SHARD_BUCKETS (SHARD_CAPACITY * 2)
+#define NIL (-1)
+
+typedef struct {
+    uint32_t addr;
+    uint16_t port;
+    uint16_t mid;
+    bool hashed;                 // false = ya olvidada, sólo espera que la rueda la libere
+    bool pending;                // el pedido se está procesando (todavía sin respuesta)
+    uint16_t len;
+    uint64_t expires;            // segundo monotónico de vencimiento
+    int32_t next;                // siguiente en la cadena del bucket (o en la lista libre)
+    int32_t wheel_next;          // siguiente en el slot de la rueda
+    uint8_t *heap;               // respuesta si no entra en inline_buf (bloque del slab)
+    uint8_t inline_buf[EXCHANGE_INLINE];
+} entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    entry_t *entries;
+    int32_t *buckets;
+    int32_t free_head;
+    int32_t wheel_head[WHEEL_SLOTS];
+    int32_t wheel_tail[WHEEL_SLOTS];
+    uint64_t wheel_sec;          // último segundo ya vencido
+    size_t count;
+    uint64_t replays, in_progress, evicted;
+} shard_t;
+
+static shard_t shards[EXCHANGE_SHARDS];
+static bool initialized = false;
+
+static uint64_t now_sec(void) {
+    return timer_now_ms() / 1000;
+}
+
+static uint32_t key_hash(uint32_t addr, uint16_t port, uint16_t mid) {
+    uint64_t k = ((uint64_t) addr << 32) | ((uint64_t) port << 16) | mid;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (uint32_t) k;
+}
+
+int exchange_init(void) {
+    if (initialized) return 0;
+    uint64_t now = now_sec();
+    for (size_t s = 0; s < EXCHANGE_SHARDS; s++) {
+        shard_t *sh = &shards[s];
+        sh->entries = calloc(SHARD_CAPACITY, sizeof(entry_t));
+        sh->buckets = malloc(SHARD_BUCKETS * sizeof(int32_t));
+        if (!sh->entries || !sh->buckets) return -1;
+        pthread_mutex_init(&sh->lock, NULL);
+        for (size_t i = 0; i < SHARD_BUCKETS; i++) sh->buckets[i] = NIL;
+        for (size_t i = 0; i < SHARD_CAPACITY; i++) sh->entries[i].next = (i + 1 < SHARD_CAPACITY) ? (int32_t) (i + 1) : NIL;
+        sh->free_head = 0;
+        for (size_t i = 0; i < WHEEL_SLOTS; i++) sh->wheel_head[i] = sh->wheel_tail[i] = NIL;
+        sh->wheel_sec = now;
+    }
+    initialized = true;
+    return 0;
+}
+
+static int32_t find(shard_t *sh, uint32_t h, uint32_t addr, uint16_t port, uint16_t mid) {
+    for (int32_t i = sh->buckets[h % SHARD_BUCKETS]; i != NIL; i = sh->entries[i].next) {
+        entry_t *e = &sh->entries[i];
+        if (e->mid == mid && e->addr == addr && e->port == port) return i;
+    }
+    return NIL;
+}
+
+// Sacar una entrada de la cadena de su bucket
+static void unhash(shard_t *sh, int32_t idx) {
+    entry_t *e = &sh->entries[idx];
+    int32_t *link = &sh->buckets[key_hash(e->addr, e->port, e->mid) % SHARD_BUCKETS];
+    while (*link != NIL && *link != idx) link = &sh->entries[*link].next;
+    if (*link == idx) *link = e->next;
+    e->hashed = false;
+}
+
+// Devolver una entrada (ya fuera de la rueda) a la lista libre
+static void release_entry(shard_t *sh, int32_t idx) {
+    entry_t *e = &sh->entries[idx];
+    if (e->hashed) unhash(sh, idx);
+    slab_free(e->heap);
+    e->heap = NULL;
+    e->next = sh->free_head;
+    sh->free_head = idx;
+    sh->count--;
+}
+
+// Liberar los slots de la rueda cuyo segundo ya pasó. Cada slot sólo tiene entradas
+// que vencen en ese segundo, porque la rueda es más larga que cualquier tiempo de vida
+static void advance(shard_t *sh, uint64_t now) {
+    if (now <= sh->wheel_sec) return;
+    uint64_t steps = now - sh->wheel_sec;
+    if (steps > WHEEL_SLOTS) steps = WHEEL_SLOTS;
+    for (uint64_t i = 1; i <= steps; i++) {
+        size_t slot = (size_t) ((sh->wheel_sec + i) % WHEEL_SLOTS);
+        int32_t idx = sh->wheel_head[slot];
+        while (idx != NIL) {
+            int32_t next = sh->entries[idx].wheel_next;
+            release_entry(sh, idx);
+            idx = next;
+        }
+        sh->wheel_head[slot] = sh->wheel_tail[slot] = NIL;
+    }
+    sh->wheel_sec = now;
+}
+
+// Tabla llena: descartar la entrada que vence primero
+static void evict_oldest(shard_t *sh) {
+    for (uint64_t i = 1; i <= WHEEL_SLOTS; i++) {
+        size_t slot = (size_t) ((sh->wheel_sec + i) % WHEEL_SLOTS);
+        int32_t idx = sh->wheel_head[slot];
+        if (idx == NIL) continue;
+        sh->wheel_head[slot] = sh->entries[idx].wheel_next;
+        if (sh->wheel_head[slot] == NIL) sh->wheel_tail[slot] = NIL;
+        if (sh->entries[idx].hashed) sh->evicted++;
+        release_entry(sh, idx);
+        return;
+    }
+}
+
+int exchange_begin(const struct sockaddr_in *peer, uint16_t mid, bool confirmable,
+                   uint8_t *out, size_t *out_len, size_t max_len) {
+    if (!initialized) return -1;
+    uint32_t addr = peer->sin_addr.s_addr;
+    uint16_t port = peer->sin_port;
+    uint32_t h = key_hash(addr, port, mid);
+    shard_t *sh = &shards[(h >> 24) % EXCHANGE_SHARDS];
+    uint64_t now = now_sec();
+
+    pthread_mutex_lock(&sh->lock);
+    advance(sh, now);
+
+    int32_t idx = find(sh, h, addr, port, mid);
+    if (idx != NIL) {
+        entry_t *e = &sh->entries[idx];
+        int res = EXCHANGE_IN_PROGRESS;
+        if (e->pending) {
+            sh->in_progress++;
+        } else if (e->len <= max_len) {
+            memcpy(out, e->heap ? e->heap : e->inline_buf, e->len);
+            *out_len = e->len;
+            sh->replays++;
+            res = EXCHANGE_REPLAY;
+        }
+        pthread_mutex_unlock(&sh->lock);
+        return res;
+    }
+
+    if (sh->free_head == NIL) evict_oldest(sh);
+    idx = sh->free_head;
+    entry_t *e = &sh->entries[idx];
+    sh->free_head = e->next;
+    sh->count++;
+
+    e->addr = addr;
+    e->port = port;
+    e->mid = mid;
+    e->pending = true;
+    e->hashed = true;
+    e->len = 0;
+    e->expires = now + (confirmable ? EXCHANGE_LIFETIME : NON_LIFETIME);
+    e->next = sh->buckets[h % SHARD_BUCKETS];
+    sh->buckets[h % SHARD_BUCKETS] = idx;
+
+    size_t slot = (size_t) (e->expires % WHEEL_SLOTS);
+    e->wheel_next = NIL;
+    if (sh->wheel_tail[slot] != NIL) sh->entries[sh->wheel_tail[slot]].wheel_next = idx;
+    else sh->wheel_head[slot] = idx;
+    sh->wheel_tail[slot] = idx;
+
+    pthread_mutex_unlock(&sh->lock);
+    return EXCHANGE_NEW;
+}
+
+void exchange_finish(const struct sockaddr_in *peer, uint16_t mid, const struct iovec *iov, size_t iovcnt) {
+    if (!initialized) return;
+    size_t len = 0;
+    for (size_t i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+    uint32_t addr = peer->sin_addr.s_addr;
+    uint16_t port = peer->sin_port;
+    uint32_t h = key_hash(addr, port, mid);
+    shard_t *sh = &shards[(h >> 24) % EXCHANGE_SHARDS];
+
+    pthread_mutex_lock(&sh->lock);
+    int32_t idx = find(sh, h, addr, port, mid);
+    if (idx != NIL && sh->entries[idx].pending) {
+        entry_t *e = &sh->entries[idx];
+        uint8_t *dst = e->inline_buf;
+        if (len > EXCHANGE_INLINE) dst = e->heap = slab_alloc(len);
+        if (dst && len <= UINT16_MAX) {
+            for (size_t i = 0, off = 0; i < iovcnt; off += iov[i].iov_len, i++) memcpy(dst + off, iov[i].iov_base, iov[i].iov_len);
+            e->len = (uint16_t) len;
+            e->pending = false;
+        } else {
+            // Sin memoria: se olvida el pedido y una retransmisión se vuelve a procesar
+            unhash(sh, idx);
+        }
+    }
+    pthread_mutex_unlock(&sh->lock);
+}
+
+void exchange_abort(const struct sockaddr_in *peer, uint16_t mid) {
+    if (!initialized) return;
+    uint32_t addr = peer->sin_addr.s_addr;
+    uint16_t port = peer->sin_port;
+    uint32_t h = key_hash(addr, port, mid);
+    shard_t *sh = &shards[(h >> 24) % EXCHANGE_SHARDS];
+
+    pthread_mutex_lock(&sh->lock);
+    int32_t idx = find(sh, h, addr, port, mid);
+    if (idx != NIL) unhash(sh, idx);
+    pthread_mutex_unlock(&sh->lock);
+}
+
+void exchange_expire(void *ctx) {
+    (void) ctx;
+    if (!initialized) return;
+    uint64_t now = now_sec();
+    for (size_t s = 0; s < EXCHANGE_SHARDS; s++) {
+        pthread_mutex_lock(&shards[s].lock);
+        advance(&shards[s], now);
+        pthread_mutex_unlock(&shards[s].lock);
+    }
+}
+
+void exchange_get_stats(exchange_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    if (!initialized) return;
+    for (size_t s = 0; s < EXCHANGE_SHARDS; s++) {
+        pthread_mutex_lock(&shards[s].lock);
+        st->entries += shards[s].count;
+        st->replays += shards[s].replays;
+        st->in_progress += shards[s].in_progress;
+        st->evicted += shards[s].evicted;
+        pthread_mutex_unlock(&shards[s].lock);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef EXCHANGE_H
+#define EXCHANGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+// Caché de intercambios (RFC 7252 §4.5): recuerda la respuesta ya serializada de cada
+// pedido por (endpoint, Message ID) durante EXCHANGE_LIFETIME, así una retransmisión
+// se contesta con los mismos bytes sin volver a ejecutar el handler.
+// La tabla está repartida en shards con su propio mutex; cada shard tiene una rueda
+// de tiempo de un slot por segundo que vence las entradas sin recorrer la tabla.
+
+#define EXCHANGE_LIFETIME 247        // segundos (valores por defecto del RFC) para CON
+#define NON_LIFETIME 145             // segundos para NON
+#define EXCHANGE_SHARDS 16
+#define EXCHANGE_CAPACITY 65536      // entradas en total; si se llena se descarta la más vieja
+#define EXCHANGE_INLINE 64           // respuestas de hasta este tamaño no piden memoria aparte
+
+// Resultado de exchange_begin
+#define EXCHANGE_NEW 0               // primer pedido: procesarlo y llamar a exchange_finish
+#define EXCHANGE_REPLAY 1            // duplicado ya respondido: out tiene la respuesta guardada
+#define EXCHANGE_IN_PROGRESS 2       // duplicado de un pedido que todavía se está procesando
+
+typedef struct {
+    size_t entries;
+    uint64_t replays;
+    uint64_t in_progress;
+    uint64_t evicted;                // descartadas antes de vencer por falta de lugar
+} exchange_stats_t;
+
+// Reservar la tabla (una sola vez, antes de atender pedidos)
+int exchange_init(void);
+
+// Buscar el pedido; si no estaba se registra como en curso. Retorna EXCHANGE_* o -1 si no hay tabla
+int exchange_begin(const struct sockaddr_in *peer, uint16_t mid, bool confirmable,
+                   uint8_t *out, size_t *out_len, size_t max_len);
+
+// Guardar la respuesta (en iovcnt partes, como sale de coap_build_iov) de un pedido registrado con exchange_begin
+void exchange_finish(const struct sockaddr_in *peer, uint16_t mid, const struct iovec *iov, size_t iovcnt);
+
+// Olvidar un pedido que no tuvo respuesta (para que una retransmisión se vuelva a procesar)
+void exchange_abort(const struct sockaddr_in *peer, uint16_t mid);
+
+// Vencer las entradas viejas de todos los shards (temporizador periódico)
+void exchange_expire(void *ctx);
+
+void exchange_get_stats(exchange_stats_t *st);
+
+#endif
@@ -1,56 +1,318 @@
+#define _GNU_SOURCE
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sys/uio.h>
 #include "log.h"
 
-static FILE *logfile = NULL;
-static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define LOG_BATCH 64                 // líneas por writev
+#define LOG_IDLE_US 2000             // espera del hilo escritor cuando no hay nada
+#define LOG_CACHELINE 64
 
-int log_init(const char *path) {
-    logfile = fopen(path, "a");
-    if (!logfile) return -1;
+typedef struct {
+    uint16_t len;
+    char text[LOG_LINE_MAX];
+} log_line_t;
+
+// Anillo de un hilo: sólo ese hilo avanza head y sólo el hilo escritor avanza tail
+typedef struct {
+    _Alignas(LOG_CACHELINE) atomic_size_t head;
+    _Alignas(LOG_CACHELINE) atomic_size_t tail;
+    atomic_uint_fast64_t dropped;
+    atomic_bool orphan;              // el hilo dueño terminó: se reutiliza cuando esté vacío
+    log_line_t lines[LOG_RING_SIZE];
+} log_ring_t;
+
+static log_ring_t *rings[LOG_MAX_THREADS];
+static atomic_size_t ring_count = 0;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static _Thread_local log_ring_t *my_ring = NULL;
+static _Thread_local bool without_ring = false;
+
+static int log_fd = -1;
+static atomic_int min_level = LOG_INFO;
+static atomic_bool running = false;
+static atomic_bool stopping = false;
+static pthread_t writer;
+static pthread_mutex_t direct_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint_fast64_t written = 0, batches = 0;
+
+// Nivel según el prefijo del mensaje
+static log_level_t level_of(const char *fmt) {
+    if (fmt[0] != '[') return LOG_INFO;
+    switch (fmt[1]) {
+        case 'E': return LOG_ERROR;
+        case 'W': return LOG_WARNING;
+        case 'D': return LOG_DEBUG;
+        default: return LOG_INFO;
+    }
+}
+
+// "[YYYY-mm-dd HH:MM:SS] " formateado una vez por segundo en cada hilo
+static size_t format_timestamp(char *out) {
+    static _Thread_local time_t cached_sec = -1;
+    static _Thread_local char cached[32];
+    static _Thread_local size_t cached_len = 0;
+    time_t now = time(NULL);
+    if (now != cached_sec) {
+        struct tm tm_info;
+        localtime_r(&now, &tm_info);
+        cached_len = strftime(cached, sizeof(cached), "[%Y-%m-%d %H:%M:%S] ", &tm_info);
+        cached_sec = now;
+    }
+    memcpy(out, cached, cached_len);
+    return cached_len;
+}
+
+// Armar la línea completa (hora, mensaje y salto) en out, de LOG_LINE_MAX bytes
+static uint16_t format_line(char *out, const char *fmt, va_list args) {
+    size_t n = format_timestamp(out);
+    int res = vsnprintf(out + n, LOG_LINE_MAX - n, fmt, args);
+    if (res < 0) res = 0;
+    if ((size_t) res > LOG_LINE_MAX - n - 1) res = (int) (LOG_LINE_MAX - n - 1); // truncada
+    n += (size_t) res;
+    out[n++] = '\n';
+    return (uint16_t) n;
+}
 
-    // opcional: escritura sin buffer para debug inmediato
-    setvbuf(logfile, NULL, _IONBF, 0);
+// Escribir todo el vector aunque writev escriba de a partes
+static void write_all(int fd, const struct iovec *src, size_t count) {
+    if (fd < 0) return;
+    struct iovec iov[LOG_BATCH];
+    memcpy(iov, src, count * sizeof(struct iovec));
+    struct iovec *cur = iov;
+    while (count > 0) {
+        ssize_t res = writev(fd, cur, (int) count);
+        if (res < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        size_t done = (size_t) res;
+        while (count > 0 && done >= cur->iov_len) {
+            done -= cur->iov_len;
+            cur++;
+            count--;
+        }
+        if (count > 0) {
+            cur->iov_base = (char*) cur->iov_base + done;
+            cur->iov_len -= done;
+        }
+    }
+}
 
+// Al terminar un hilo su anillo queda para que lo reutilice otro
+static void ring_release(void *ptr) {
+    log_ring_t *ring = ptr;
+    atomic_store_explicit(&ring->orphan, true, memory_order_release);
+}
+
+static void key_create(void) {
+    pthread_key_create(&ring_key, ring_release);
+}
+
+// Anillo del hilo actual; se asigna en el primer mensaje. NULL si ya no quedan
+static log_ring_t *thread_ring(void) {
+    if (my_ring || without_ring) return my_ring;
+    pthread_once(&key_once, key_create);
+
+    pthread_mutex_lock(&registry_mutex);
+    log_ring_t *ring = NULL;
+    size_t count = atomic_load_explicit(&ring_count, memory_order_relaxed);
+    for (size_t i = 0; i < count && !ring; i++) {
+        log_ring_t *r = rings[i];
+        if (atomic_load_explicit(&r->orphan, memory_order_acquire) &&
+            atomic_load_explicit(&r->head, memory_order_relaxed) == atomic_load_explicit(&r->tail, memory_order_acquire)) {
+            atomic_store_explicit(&r->orphan, false, memory_order_relaxed);
+            ring = r;
+        }
+    }
+    if (!ring && count < LOG_MAX_THREADS) {
+        ring = aligned_alloc(LOG_CACHELINE, sizeof(log_ring_t));
+        if (ring) {
+            atomic_init(&ring->head, 0);
+            atomic_init(&ring->tail, 0);
+            atomic_init(&ring->dropped, 0);
+            atomic_init(&ring->orphan, false);
+            rings[count] = ring;
+            atomic_store_explicit(&ring_count, count + 1, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    if (!ring) {
+        without_ring = true;
+        return NULL;
+    }
+    pthread_setspecific(ring_key, ring);
+    my_ring = ring;
+    return ring;
+}
+
+// Sin hilo escritor (antes de log_init o sin anillo libre): escribir en el momento
+static void write_direct(const char *fmt, va_list args) {
+    char line[LOG_LINE_MAX];
+    struct iovec iov = { .iov_base = line, .iov_len = format_line(line, fmt, args) };
+    pthread_mutex_lock(&direct_mutex);
+    write_all(STDOUT_FILENO, &iov, 1);
+    write_all(log_fd, &iov, 1);
+    pthread_mutex_unlock(&direct_mutex);
+    atomic_fetch_add_explicit(&written, 1, memory_order_relaxed);
+}
+
+void log_text(const char *fmt, ...) {
+    if ((int) level_of(fmt) < atomic_load_explicit(&min_level, memory_order_relaxed)) return;
+
+    va_list args;
+    va_start(args, fmt);
+    log_ring_t *ring = atomic_load_explicit(&running, memory_order_acquire) ? thread_ring() : NULL;
+    if (!ring) {
+        write_direct(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    } else {
+        log_line_t *line = &ring->lines[head & (LOG_RING_SIZE - 1)];
+        line->len = format_line(line->text, fmt, args);
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    }
+    va_end(args);
+}
+
+// Escribir un lote y liberar sus líneas en los anillos de donde salieron
+static void flush_batch(struct iovec *iov, size_t n, log_ring_t **owners, size_t *new_tails, size_t n_owners) {
+    write_all(log_fd, iov, n);
+    write_all(STDOUT_FILENO, iov, n);
+    for (size_t i = 0; i < n_owners; i++) atomic_store_explicit(&owners[i]->tail, new_tails[i], memory_order_release);
+    atomic_fetch_add_explicit(&written, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batches, 1, memory_order_relaxed);
+}
+
+// Juntar las líneas pendientes de todos los anillos en lotes de LOG_BATCH. Retorna cuántas escribió
+static size_t drain(void) {
+    struct iovec iov[LOG_BATCH];
+    log_ring_t *owners[LOG_BATCH];
+    size_t new_tails[LOG_BATCH];
+    size_t n = 0, n_owners = 0, total = 0;
+
+    size_t count = atomic_load_explicit(&ring_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        log_ring_t *ring = rings[i];
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail != head) {
+            log_line_t *line = &ring->lines[tail & (LOG_RING_SIZE - 1)];
+            iov[n].iov_base = line->text;
+            iov[n].iov_len = line->len;
+            n++;
+            tail++;
+            if (n_owners == 0 || owners[n_owners - 1] != ring) owners[n_owners++] = ring;
+            new_tails[n_owners - 1] = tail;
+            if (n == LOG_BATCH) {
+                flush_batch(iov, n, owners, new_tails, n_owners);
+                total += n;
+                n = n_owners = 0;
+            }
+        }
+    }
+    if (n > 0) {
+        flush_batch(iov, n, owners, new_tails, n_owners);
+        total += n;
+    }
+    return total;
+}
+
+static void *writer_main(void *arg) {
+    (void) arg;
+    while (!atomic_load_explicit(&stopping, memory_order_acquire)) {
+        if (drain() == 0) usleep(LOG_IDLE_US);
+    }
+    drain();
+    return NULL;
+}
+
+int log_init(const char *path) {
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) return -1;
+
+    atomic_store(&stopping, false);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) return -1;
+    atomic_store_explicit(&running, true, memory_order_release);
+    // Lo que quede en los anillos se escribe aunque el proceso termine con exit()
+    static bool registered = false;
+    if (!registered) {
+        atexit(log_close);
+        registered = true;
+    }
     return 0;
 }
 
 void log_close(void) {
-    if (logfile) {
-        fclose(logfile);
-        logfile = NULL;
+    if (atomic_exchange(&running, false)) {
+        atomic_store_explicit(&stopping, true, memory_order_release);
+        pthread_join(writer, NULL);
+    }
+    if (log_fd >= 0) {
+        pthread_mutex_lock(&direct_mutex);
+        close(log_fd);
+        log_fd = -1;
+        pthread_mutex_unlock(&direct_mutex);
     }
 }
 
-void log_text(const char *fmt, ...) {
-    pthread_mutex_lock(&log_mutex);
-    
-    va_list args1, args2;
-    va_start(args1, fmt);
-    va_copy(args2, args1);
+void log_set_level(log_level_t level) {
+    if (level > LOG_OFF) level = LOG_OFF;
+    atomic_store_explicit(&min_level, (int) level, memory_order_relaxed);
+}
 
-    // timestamp
-    time_t now = time(NULL);
-    char ts[32];
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&now));
-
-    // consola
-    printf("[%s] ", ts);
-    vprintf(fmt, args1);
-    printf("\n");
-    fflush(stdout);
-
-    // archivo
-    if (logfile) {
-        fprintf(logfile, "[%s] ", ts);
-        vfprintf(logfile, fmt, args2);
-        fprintf(logfile, "\n");
-        fflush(logfile);
-    }
-
-    va_end(args1);
-    va_end(args2);
-    
-    pthread_mutex_unlock(&log_mutex);
+log_level_t log_get_level(void) {
+    return (log_level_t) atomic_load_explicit(&min_level, memory_order_relaxed);
+}
+
+int log_parse_level(const char *text, log_level_t *level) {
+    static const char *names[] = { "debug", "info", "warning", "error", "off" };
+    for (int i = 0; i <= LOG_OFF; i++) {
+        if (strcmp(text, names[i]) == 0) {
+            *level = (log_level_t) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void log_flush(void) {
+    // El hilo escritor avanza tail después de escribir: vacío = todo escrito
+    for (int attempt = 0; attempt < 1000 && atomic_load(&running); attempt++) {
+        bool empty = true;
+        size_t count = atomic_load_explicit(&ring_count, memory_order_acquire);
+        for (size_t i = 0; i < count && empty; i++) {
+            empty = atomic_load_explicit(&rings[i]->head, memory_order_acquire) ==
+                    atomic_load_explicit(&rings[i]->tail, memory_order_acquire);
+        }
+        if (empty) return;
+        usleep(1000);
+    }
+}
+
+void log_get_stats(log_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->written = atomic_load_explicit(&written, memory_order_relaxed);
+    st->batches = atomic_load_explicit(&batches, memory_order_relaxed);
+    size_t count = atomic_load_explicit(&ring_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        st->dropped += atomic_load_explicit(&rings[i]->dropped, memory_order_relaxed);
+        if (!atomic_load_explicit(&rings[i]->orphan, memory_order_relaxed)) st->threads++;
+    }
 }
@@ -2,11 +2,52 @@
 #define LOG_H
 
 #include <stdio.h>
+#include <stdint.h>
 
+// Log asíncrono: cada hilo formatea su línea en un anillo propio (un productor, un
+// consumidor, sin locks) y un hilo aparte las junta y las escribe con writev en el
+// archivo y en la consola. Si el anillo de un hilo está lleno la línea se descarta y se cuenta.
+// El nivel sale del prefijo del mensaje ("[ERROR]", "[WARNING]", "[INFO]", "[DEBUG]";
+// sin prefijo cuenta como INFO) y los mensajes por debajo del nivel mínimo no se formatean.
+
+#define LOG_RING_SIZE 1024           // líneas por hilo (potencia de 2)
+#define LOG_LINE_MAX 384             // las líneas más largas se truncan
+#define LOG_MAX_THREADS 256          // hilos con anillo propio; los demás escriben directo
+
+typedef enum {
+    LOG_DEBUG = 0,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR,
+    LOG_OFF,
+} log_level_t;
+
+typedef struct {
+    uint64_t written;                // líneas escritas
+    uint64_t dropped;                // líneas descartadas por anillos llenos
+    uint64_t batches;                // llamadas a writev
+    size_t threads;                  // hilos con anillo
+} log_stats_t;
+
+// Abrir el archivo y arrancar el hilo escritor
 int log_init(const char *path);
 
+// Escribir lo pendiente, detener el hilo escritor y cerrar el archivo
 void log_close(void);
 
 void log_text(const char *fmt, ...);
 
-#endif
\ No newline at end of file
+// Cambiar el nivel mínimo (se puede llamar en cualquier momento, también desde un manejador de señal)
+void log_set_level(log_level_t level);
+
+log_level_t log_get_level(void);
+
+// "debug", "info", "warning", "error" u "off". Retorna 0 o -1 si no es un nivel
+int log_parse_level(const char *text, log_level_t *level);
+
+// Esperar a que el hilo escritor vacíe todos los anillos
+void log_flush(void);
+
+void log_get_stats(log_stats_t *st);
+
+#endif
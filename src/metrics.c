@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "metrics.h"
+#include "coap_packet.h"
+
+#define METRICS_CACHELINE 64
+#define METHODS 5                    // GET, POST, PUT, DELETE y otros
+
+typedef struct {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum;        // ns
+    atomic_uint_fast64_t max;
+    atomic_uint_fast64_t buckets[METRICS_BUCKETS];
+} histogram_t;
+
+// Bloque de un hilo: sólo su dueño escribe (carga y guarda relajadas, sin lock)
+typedef struct {
+    _Alignas(METRICS_CACHELINE) atomic_uint_fast64_t methods[METHODS];
+    atomic_uint_fast64_t responses[256];
+    atomic_uint_fast64_t parse_failures;
+    atomic_uint_fast64_t rst_sent;
+    atomic_uint_fast64_t rst_received;
+    histogram_t stages[METRIC_STAGES];
+    atomic_bool orphan;              // el hilo terminó: otro hilo lo continúa
+} thread_metrics_t;
+
+// Suma de todos los bloques
+typedef struct {
+    uint64_t methods[METHODS];
+    uint64_t responses[256];
+    uint64_t parse_failures, rst_sent, rst_received;
+    struct {
+        uint64_t count, sum, max;
+        uint64_t buckets[METRICS_BUCKETS];
+    } stages[METRIC_STAGES];
+} snapshot_t;
+
+static thread_metrics_t *blocks[METRICS_MAX_THREADS];
+static atomic_size_t block_count = 0;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t block_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static _Thread_local thread_metrics_t *my_block = NULL;
+static _Thread_local bool without_block = false;
+
+static const char *method_names[METHODS] = { "GET", "POST", "PUT", "DELETE", "other" };
+static const char *stage_names[METRIC_STAGES] = { "parse", "storage", "build", "send", "ingest", "query" };
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// Sumar en un contador propio: un único escritor, así que no hace falta un atómico con lock
+static inline void bump(atomic_uint_fast64_t *c, uint64_t n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static size_t bucket_of(uint64_t v) {
+    if (v < METRICS_SUB) return (size_t) v;
+    unsigned e = 63 - (unsigned) __builtin_clzll(v);
+    size_t idx = (size_t) (e - METRICS_SUB_BITS + 1) * METRICS_SUB + ((v >> (e - METRICS_SUB_BITS)) & (METRICS_SUB - 1));
+    return idx < METRICS_BUCKETS ? idx : METRICS_BUCKETS - 1;
+}
+
+// Menor valor que cae en el bucket idx
+static uint64_t bucket_lower(size_t idx) {
+    if (idx < METRICS_SUB) return idx;
+    unsigned e = (unsigned) (idx / METRICS_SUB) + METRICS_SUB_BITS - 1;
+    return (uint64_t) (METRICS_SUB + idx % METRICS_SUB) << (e - METRICS_SUB_BITS);
+}
+
+static void block_release(void *ptr) {
+    thread_metrics_t *block = ptr;
+    atomic_store_explicit(&block->orphan, true, memory_order_release);
+}
+
+static void key_create(void) {
+    pthread_key_create(&block_key, block_release);
+}
+
+// Bloque del hilo actual; se asigna en la primera medición. NULL si ya no quedan
+static thread_metrics_t *thread_block(void) {
+    if (my_block || without_block) return my_block;
+    pthread_once(&key_once, key_create);
+
+    pthread_mutex_lock(&registry_mutex);
+    thread_metrics_t *block = NULL;
+    size_t count = atomic_load_explicit(&block_count, memory_order_relaxed);
+    for (size_t i = 0; i < count && !block; i++) {
+        // Un bloque huérfano conserva sus cuentas y las sigue acumulando el nuevo dueño
+        if (atomic_load_explicit(&blocks[i]->orphan, memory_order_acquire)) {
+            atomic_store_explicit(&blocks[i]->orphan, false, memory_order_relaxed);
+            block = blocks[i];
+        }
+    }
+    if (!block && count < METRICS_MAX_THREADS) {
+        block = aligned_alloc(METRICS_CACHELINE, sizeof(thread_metrics_t));
+        if (block) {
+            memset(block, 0, sizeof(*block));
+            blocks[count] = block;
+            atomic_store_explicit(&block_count, count + 1, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    if (!block) {
+        without_block = true;
+        return NULL;
+    }
+    pthread_setspecific(block_key, block);
+    my_block = block;
+    return block;
+}
+
+void metrics_count_request(uint8_t code) {
+    thread_metrics_t *b = thread_block();
+    if (!b) return;
+    size_t m = (code >= COAP_CODE_GET && code <= COAP_CODE_DELETE) ? (size_t) (code - 1) : METHODS - 1;
+    bump(&b->methods[m], 1);
+}
+
+void metrics_count_response(uint8_t type, uint8_t code) {
+    thread_metrics_t *b = thread_block();
+    if (!b) return;
+    if (type == COAP_TYPE_RST) bump(&b->rst_sent, 1);
+    else bump(&b->responses[code], 1);
+}
+
+void metrics_count_parse_failure(void) {
+    thread_metrics_t *b = thread_block();
+    if (b) bump(&b->parse_failures, 1);
+}
+
+void metrics_count_rst_received(void) {
+    thread_metrics_t *b = thread_block();
+    if (b) bump(&b->rst_received, 1);
+}
+
+void metrics_record(metrics_stage_t stage, uint64_t ns, uint64_t count) {
+    thread_metrics_t *b = thread_block();
+    if (!b || stage >= METRIC_STAGES || count == 0) return;
+    histogram_t *h = &b->stages[stage];
+    bump(&h->count, count);
+    bump(&h->sum, ns * count);
+    bump(&h->buckets[bucket_of(ns)], count);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed)) atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+}
+
+static void take_snapshot(snapshot_t *s) {
+    memset(s, 0, sizeof(*s));
+    size_t count = atomic_load_explicit(&block_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        thread_metrics_t *b = blocks[i];
+        for (size_t m = 0; m < METHODS; m++) s->methods[m] += atomic_load_explicit(&b->methods[m], memory_order_relaxed);
+        for (size_t c = 0; c < 256; c++) s->responses[c] += atomic_load_explicit(&b->responses[c], memory_order_relaxed);
+        s->parse_failures += atomic_load_explicit(&b->parse_failures, memory_order_relaxed);
+        s->rst_sent += atomic_load_explicit(&b->rst_sent, memory_order_relaxed);
+        s->rst_received += atomic_load_explicit(&b->rst_received, memory_order_relaxed);
+        for (size_t st = 0; st < METRIC_STAGES; st++) {
+            histogram_t *h = &b->stages[st];
+            s->stages[st].count += atomic_load_explicit(&h->count, memory_order_relaxed);
+            s->stages[st].sum += atomic_load_explicit(&h->sum, memory_order_relaxed);
+            uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+            if (max > s->stages[st].max) s->stages[st].max = max;
+            for (size_t k = 0; k < METRICS_BUCKETS; k++) {
+                s->stages[st].buckets[k] += atomic_load_explicit(&h->buckets[k], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// Percentil q (0..1) de una etapa: el mayor valor del bucket donde cae, acotado por el máximo visto
+static uint64_t percentile(const snapshot_t *s, size_t st, double q) {
+    uint64_t total = 0;
+    for (size_t k = 0; k < METRICS_BUCKETS; k++) total += s->stages[st].buckets[k];
+    if (total == 0) return 0;
+    uint64_t target = (uint64_t) (q * (double) total + 0.999999);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (size_t k = 0; k < METRICS_BUCKETS; k++) {
+        seen += s->stages[st].buckets[k];
+        if (seen >= target) {
+            uint64_t upper = (k + 1 < METRICS_BUCKETS) ? bucket_lower(k + 1) - 1 : s->stages[st].max;
+            return upper < s->stages[st].max ? upper : s->stages[st].max;
+        }
+    }
+    return s->stages[st].max;
+}
+
+// Agregar texto a out sin pasarse de max_len. Retorna false si no entró
+static bool append(char *out, size_t max_len, size_t *len, const char *fmt, ...) {
+    if (*len >= max_len) return false;
+    va_list args;
+    va_start(args, fmt);
+    int res = vsnprintf(out + *len, max_len - *len, fmt, args);
+    va_end(args);
+    if (res < 0 || (size_t) res >= max_len - *len) {
+        *len = max_len;
+        return false;
+    }
+    *len += (size_t) res;
+    return true;
+}
+
+// Cuerpo JSON común; con buckets agrega los histogramas completos ([límite inferior en ns, cantidad])
+static int render(const snapshot_t *s, const metrics_gauges_t *g, bool buckets, char *out, size_t max_len) {
+    size_t len = 0;
+    append(out, max_len, &len, "{\"requests\":{");
+    for (size_t m = 0; m < METHODS; m++) {
+        append(out, max_len, &len, "%s\"%s\":%llu", m ? "," : "", method_names[m], (unsigned long long) s->methods[m]);
+    }
+    append(out, max_len, &len, "},\"responses\":{");
+    bool first = true;
+    for (size_t c = 0; c < 256; c++) {
+        if (s->responses[c] == 0) continue;
+        append(out, max_len, &len, "%s\"%zu.%02zu\":%llu", first ? "" : ",", c >> 5, c & 0x1F, (unsigned long long) s->responses[c]);
+        first = false;
+    }
+    append(out, max_len, &len, "},\"parse_failures\":%llu,\"rst_sent\":%llu,\"rst_received\":%llu",
+           (unsigned long long) s->parse_failures, (unsigned long long) s->rst_sent, (unsigned long long) s->rst_received);
+    if (g) {
+        append(out, max_len, &len, ",\"active_threads\":%zu,\"workers_busy\":%zu,\"queue_depth\":%zu,\"queue_capacity\":%zu",
+               g->active_threads, g->workers_busy, g->queue_depth, g->queue_capacity);
+        append(out, max_len, &len, ",\"slots_high_water\":%zu,\"arena_high_water\":%zu,\"arena_fallbacks\":%llu,\"slab_fallbacks\":%llu",
+               g->slots_high_water, g->arena_high_water, (unsigned long long) g->arena_fallbacks,
+               (unsigned long long) g->slab_fallbacks);
+    }
+    append(out, max_len, &len, ",\"latency_us\":{");
+    for (size_t st = 0; st < METRIC_STAGES; st++) {
+        uint64_t n = s->stages[st].count;
+        append(out, max_len, &len, "%s\"%s\":{\"count\":%llu,\"mean\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f",
+               st ? "," : "", stage_names[st], (unsigned long long) n,
+               n ? (double) s->stages[st].sum / (double) n / 1000.0 : 0.0,
+               percentile(s, st, 0.50) / 1000.0, percentile(s, st, 0.90) / 1000.0,
+               percentile(s, st, 0.99) / 1000.0, percentile(s, st, 0.999) / 1000.0,
+               s->stages[st].max / 1000.0);
+        if (buckets) {
+            append(out, max_len, &len, ",\"buckets\":[");
+            bool first_bucket = true;
+            for (size_t k = 0; k < METRICS_BUCKETS; k++) {
+                if (s->stages[st].buckets[k] == 0) continue;
+                append(out, max_len, &len, "%s[%llu,%llu]", first_bucket ? "" : ",",
+                       (unsigned long long) bucket_lower(k), (unsigned long long) s->stages[st].buckets[k]);
+                first_bucket = false;
+            }
+            append(out, max_len, &len, "]");
+        }
+        append(out, max_len, &len, "}");
+    }
+    if (!append(out, max_len, &len, "}}")) return -1;
+    return (int) len;
+}
+
+int metrics_render(char *out, size_t max_len, const metrics_gauges_t *gauges) {
+    snapshot_t *s = malloc(sizeof(snapshot_t));
+    if (!s) return -1;
+    take_snapshot(s);
+    int res = render(s, gauges, false, out, max_len);
+    free(s);
+    return res;
+}
+
+int metrics_get_stage(metrics_stage_t stage, metrics_stage_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    if (stage >= METRIC_STAGES) return -1;
+    snapshot_t *s = malloc(sizeof(snapshot_t));
+    if (!s) return -1;
+    take_snapshot(s);
+    st->count = s->stages[stage].count;
+    st->p50 = percentile(s, stage, 0.50);
+    st->p99 = percentile(s, stage, 0.99);
+    st->max = s->stages[stage].max;
+    free(s);
+    return 0;
+}
+
+int metrics_dump(const char *path, const metrics_gauges_t *gauges) {
+    size_t cap = 64 * 1024;
+    snapshot_t *s = malloc(sizeof(snapshot_t));
+    char *buf = malloc(cap);
+    char tmp[512];
+    int res = -1;
+    if (!s || !buf) goto out;
+    take_snapshot(s);
+    int len = render(s, gauges, true, buf, cap);
+    if (len < 0) goto out;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) goto out;
+    bool ok = fwrite(buf, 1, (size_t) len, f) == (size_t) len && fputc('\n', f) != EOF;
+    if (fclose(f) != 0) ok = false;
+    if (ok && rename(tmp, path) == 0) res = 0;
+    else unlink(tmp);
+out:
+    free(s);
+    free(buf);
+    return res;
+}
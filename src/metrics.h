@@ -0,0 +1,73 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Métricas del servidor: contadores por método y por código de respuesta, fallos de
+// parseo, RST, y latencias por etapa en histogramas logarítmicos (estilo HDR: cada
+// potencia de 2 partida en METRICS_SUB sub-buckets, error relativo menor al 12.5%).
+// Cada hilo escribe en su propio bloque alineado a línea de caché, sin atómicos con
+// lock ni contención; los bloques sólo se suman al leer.
+
+#define METRICS_SUB_BITS 3
+#define METRICS_SUB (1 << METRICS_SUB_BITS)
+#define METRICS_BUCKETS 312          // hasta ~2^40 ns (unos 18 minutos)
+#define METRICS_MAX_THREADS 1024     // hilos con bloque propio; los demás no se miden
+
+// Etapas medidas de cada pedido
+typedef enum {
+    METRIC_PARSE = 0,
+    METRIC_STORAGE,                  // handler (almacenamiento incluido)
+    METRIC_BUILD,
+    METRIC_SEND,                     // en los modos por lotes, el costo del lote repartido por datagrama
+    METRIC_INGEST,                   // total en el servidor (cola incluida) de los pedidos del carril de ingesta
+    METRIC_QUERY,                    // lo mismo para el carril de consultas
+    METRIC_STAGES,
+} metrics_stage_t;
+
+// Valores instantáneos que aporta el servidor al leer las métricas
+typedef struct {
+    size_t active_threads;
+    size_t workers_busy;
+    size_t queue_depth;
+    size_t queue_capacity;
+    size_t slots_high_water;         // máximo de slots de recepción en uso
+    size_t arena_high_water;         // bytes máximos de la arena de un pedido
+    uint64_t arena_fallbacks;        // reservas de la arena que fueron a malloc
+    uint64_t slab_fallbacks;         // bloques más grandes que el slab
+} metrics_gauges_t;
+
+// Hora monotónica en nanosegundos
+uint64_t metrics_now_ns(void);
+
+// Pedido recibido con ese código de método
+void metrics_count_request(uint8_t code);
+
+// Respuesta enviada con ese código (el RST vacío cuenta aparte en rst_sent)
+void metrics_count_response(uint8_t type, uint8_t code);
+
+void metrics_count_parse_failure(void);
+
+// RST recibido de un cliente
+void metrics_count_rst_received(void);
+
+// Registrar la duración de una etapa (count muestras iguales, para lotes)
+void metrics_record(metrics_stage_t stage, uint64_t ns, uint64_t count);
+
+// JSON resumido (contadores, valores instantáneos y percentiles por etapa). Retorna la longitud o -1 si no entra
+int metrics_render(char *out, size_t max_len, const metrics_gauges_t *gauges);
+
+// Cantidad y percentiles (en ns) acumulados de una etapa
+typedef struct {
+    uint64_t count;
+    uint64_t p50, p99, max;
+} metrics_stage_stats_t;
+
+int metrics_get_stage(metrics_stage_t stage, metrics_stage_stats_t *st);
+
+// Escribir el JSON completo (con los buckets de cada histograma) en path, reemplazándolo de forma atómica
+int metrics_dump(const char *path, const metrics_gauges_t *gauges);
+
+#endif
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#include "netio.h"
+
+#define GSO_MAX_BYTES 65000      // límite de un envío segmentado
+
+static atomic_bool gso_enabled = false;
+
+static atomic_uint_fast64_t recv_calls = 0;
+static atomic_uint_fast64_t recv_dgrams = 0;
+static atomic_uint_fast64_t send_calls = 0;
+static atomic_uint_fast64_t send_dgrams = 0;
+static atomic_uint_fast64_t gso_sends = 0;
+
+void netio_set_gso(bool enabled) {
+    atomic_store(&gso_enabled, enabled);
+}
+
+int netio_recv_batch(int sock, netio_msg_t *msgs, size_t count) {
+    struct mmsghdr hdrs[NETIO_MAX_BATCH];
+    struct iovec iov[NETIO_MAX_BATCH];
+
+    if (count == 0) return 0;
+    if (count > NETIO_MAX_BATCH) count = NETIO_MAX_BATCH;
+
+    memset(hdrs, 0, sizeof(struct mmsghdr) * count);
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = msgs[i].buf;
+        iov[i].iov_len = msgs[i].cap;
+        hdrs[i].msg_hdr.msg_iov = &iov[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        hdrs[i].msg_hdr.msg_name = &msgs[i].addr;
+        hdrs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    // MSG_WAITFORONE: bloquear por el primero y devolver lo que ya esté en cola
+    int n;
+    do {
+        n = recvmmsg(sock, hdrs, count, MSG_WAITFORONE, NULL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return -1;
+
+    for (int i = 0; i < n; i++) msgs[i].len = hdrs[i].msg_len;
+
+    atomic_fetch_add_explicit(&recv_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&recv_dgrams, n, memory_order_relaxed);
+    return n;
+}
+
+static bool same_addr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+int netio_send_batch(int sock, const netio_msg_t *msgs, size_t count) {
+    struct mmsghdr hdrs[NETIO_MAX_BATCH];
+    struct iovec iov[NETIO_MAX_BATCH];
+    char ctrl[NETIO_MAX_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+    size_t dgrams_per_hdr[NETIO_MAX_BATCH];
+
+    if (count == 0) return 0;
+    if (count > NETIO_MAX_BATCH) count = NETIO_MAX_BATCH;
+
+    bool gso = atomic_load(&gso_enabled);
+    size_t nhdrs = 0;
+    memset(hdrs, 0, sizeof(hdrs));
+
+    for (size_t i = 0; i < count; ) {
+        // Agrupar respuestas consecutivas al mismo destino y del mismo tamaño
+        size_t j = i + 1;
+        size_t total = msgs[i].len;
+        while (gso && j < count && msgs[j].len == msgs[i].len &&
+               same_addr(&msgs[j].addr, &msgs[i].addr) && total + msgs[j].len <= GSO_MAX_BYTES) {
+            total += msgs[j].len;
+            j++;
+        }
+
+        struct msghdr *mh = &hdrs[nhdrs].msg_hdr;
+        for (size_t k = i; k < j; k++) {
+            iov[k].iov_base = msgs[k].buf;
+            iov[k].iov_len = msgs[k].len;
+        }
+        mh->msg_iov = &iov[i];
+        mh->msg_iovlen = j - i;
+        mh->msg_name = (void*) &msgs[i].addr;
+        mh->msg_namelen = sizeof(struct sockaddr_in);
+
+        if (j - i > 1) {
+            mh->msg_control = ctrl[nhdrs];
+            mh->msg_controllen = sizeof(ctrl[nhdrs]);
+            struct cmsghdr *cm = CMSG_FIRSTHDR(mh);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t seg = (uint16_t) msgs[i].len;
+            memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+        }
+        dgrams_per_hdr[nhdrs++] = j - i;
+        i = j;
+    }
+
+    size_t done = 0;
+    int sent_dgrams = 0;
+    while (done < nhdrs) {
+        int n = sendmmsg(sock, hdrs + done, nhdrs - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (gso && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                // El kernel o la interfaz no soportan GSO: desactivar y reenviar sin agrupar
+                atomic_store(&gso_enabled, false);
+                atomic_fetch_add_explicit(&send_dgrams, sent_dgrams, memory_order_relaxed);
+                size_t first = 0;
+                for (size_t k = 0; k < done; k++) first += dgrams_per_hdr[k];
+                int rest = netio_send_batch(sock, msgs + first, count - first);
+                return (rest < 0) ? sent_dgrams : sent_dgrams + rest;
+            }
+            return sent_dgrams > 0 ? sent_dgrams : -1;
+        }
+        atomic_fetch_add_explicit(&send_calls, 1, memory_order_relaxed);
+        for (int k = 0; k < n; k++) {
+            if (dgrams_per_hdr[done + k] > 1) {
+                atomic_fetch_add_explicit(&gso_sends, 1, memory_order_relaxed);
+            }
+            sent_dgrams += dgrams_per_hdr[done + k];
+        }
+        done += n;
+    }
+
+    atomic_fetch_add_explicit(&send_dgrams, sent_dgrams, memory_order_relaxed);
+    return sent_dgrams;
+}
+
+ssize_t netio_sendv(int sock, const struct sockaddr_in *addr, const struct iovec *iov, size_t iovcnt) {
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_name = (void*) addr;
+    mh.msg_namelen = sizeof(struct sockaddr_in);
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = iovcnt;
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &mh, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+void netio_get_stats(netio_stats_t *stats) {
+    stats->recv_calls = atomic_load_explicit(&recv_calls, memory_order_relaxed);
+    stats->recv_dgrams = atomic_load_explicit(&recv_dgrams, memory_order_relaxed);
+    stats->send_calls = atomic_load_explicit(&send_calls, memory_order_relaxed);
+    stats->send_dgrams = atomic_load_explicit(&send_dgrams, memory_order_relaxed);
+    stats->gso_sends = atomic_load_explicit(&gso_sends, memory_order_relaxed);
+}
@@ -0,0 +1,45 @@
+#ifndef NETIO_H
+#define NETIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+#define NETIO_MAX_BATCH 64
+
+// Un datagrama de entrada o salida para las operaciones por lotes
+typedef struct {
+    uint8_t *buf;
+    size_t cap;                  // capacidad de buf (sólo recepción)
+    size_t len;
+    struct sockaddr_in addr;
+} netio_msg_t;
+
+// Contadores acumulados de E/S por lotes
+typedef struct {
+    uint64_t recv_calls;
+    uint64_t recv_dgrams;
+    uint64_t send_calls;
+    uint64_t send_dgrams;
+    uint64_t gso_sends;          // mensajes enviados con segmentación UDP (GSO)
+} netio_stats_t;
+
+// Activar GSO (UDP_SEGMENT) para respuestas consecutivas al mismo destino
+void netio_set_gso(bool enabled);
+
+// Recibir hasta count datagramas con una sola llamada a recvmmsg.
+// Bloquea hasta que llegue al menos uno. Retorna la cantidad recibida o -1
+int netio_recv_batch(int sock, netio_msg_t *msgs, size_t count);
+
+// Enviar count datagramas con sendmmsg. Retorna la cantidad enviada o -1
+int netio_send_batch(int sock, const netio_msg_t *msgs, size_t count);
+
+// Enviar un datagrama armado en iovcnt partes con sendmsg (sin juntarlas antes). Retorna sendmsg
+ssize_t netio_sendv(int sock, const struct sockaddr_in *addr, const struct iovec *iov, size_t iovcnt);
+
+// Leer los contadores de E/S
+void netio_get_stats(netio_stats_t *stats);
+
+#endif
@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "observe.h"
+#include "coap_packet.h"
+#include "netio.h"
+#include "timer.h"
+#include "separate.h"
+#include "log.h"
+
+#define RESOURCE_BUCKETS 1024
+#define PEER_BUCKETS 4096
+#define NIL (-1)
+
+typedef struct resource {
+    char path[OBSERVE_PATH_MAX];
+    uint32_t seq;                // número de secuencia de la última notificación (24 bits)
+    bool dirty;                  // en la lista de pendientes del notificador
+    int32_t *obs;                // índices de sus observadores
+    size_t count, cap;
+    struct resource *next;       // cadena del bucket
+    struct resource *next_dirty;
+} resource_t;
+
+typedef struct {
+    bool used;
+    struct sockaddr_in peer;
+    uint8_t token[8];
+    uint8_t tkl;
+    resource_t *res;
+    size_t slot;                 // posición en res->obs
+    uint16_t last_mid;           // MID de la última notificación enviada
+    uint16_t con_mid;            // MID de la última CON (se sigue retransmitiendo hasta el ACK)
+    bool con_pending;            // la última CON todavía no tuvo ACK
+    uint64_t con_sent_ms;
+    uint32_t since_con;          // notificaciones NON desde la última CON
+    int32_t next_peer;           // cadena por endpoint (o lista libre)
+} observer_t;
+
+// Destino de una notificación, copiado para enviar sin el lock tomado
+typedef struct {
+    struct sockaddr_in peer;
+    uint8_t token[8];
+    uint8_t tkl;
+    uint8_t type;
+    uint16_t mid;
+} target_t;
+
+static pthread_mutex_t observe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t observe_cond = PTHREAD_COND_INITIALIZER;
+static resource_t *resources[RESOURCE_BUCKETS];
+static resource_t *dirty_head = NULL, *dirty_tail = NULL;
+static observer_t *observers = NULL;
+static int32_t peer_heads[PEER_BUCKETS];
+static int32_t free_head = NIL;
+static atomic_size_t observer_count = 0;
+static uint16_t next_mid;
+static int notify_sock = -1;
+static observe_render_t render_cb = NULL;
+static observe_stats_t stats;
+
+static uint32_t path_hash(const char *path) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (; *path; path++) h = (h ^ (uint8_t) *path) * 16777619u;
+    return h;
+}
+
+static uint32_t peer_hash(const struct sockaddr_in *peer) {
+    uint32_t h = peer->sin_addr.s_addr * 2654435761u;
+    return (h ^ peer->sin_port) % PEER_BUCKETS;
+}
+
+static bool same_peer(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static resource_t *resource_find(const char *path, bool create) {
+    resource_t **link = &resources[path_hash(path) % RESOURCE_BUCKETS];
+    for (resource_t *r = *link; r; r = r->next) {
+        if (strcmp(r->path, path) == 0) return r;
+    }
+    if (!create) return NULL;
+    resource_t *r = calloc(1, sizeof(resource_t));
+    if (!r) return NULL;
+    snprintf(r->path, sizeof(r->path), "%s", path);
+    r->seq = (uint32_t) timer_now_ms() & 0xFFFFFF;
+    r->next = *link;
+    *link = r;
+    return r;
+}
+
+// Liberar un recurso sin observadores (salvo que el notificador lo tenga pendiente)
+static void resource_maybe_free(resource_t *r) {
+    if (r->count > 0 || r->dirty) return;
+    resource_t **link = &resources[path_hash(r->path) % RESOURCE_BUCKETS];
+    while (*link && *link != r) link = &(*link)->next;
+    if (*link) *link = r->next;
+    free(r->obs);
+    free(r);
+}
+
+static int32_t observer_find(const struct sockaddr_in *peer, const uint8_t *token, size_t token_len) {
+    for (int32_t i = peer_heads[peer_hash(peer)]; i != NIL; i = observers[i].next_peer) {
+        observer_t *o = &observers[i];
+        if (same_peer(&o->peer, peer) && o->tkl == token_len && memcmp(o->token, token, token_len) == 0) return i;
+    }
+    return NIL;
+}
+
+static void observer_remove(int32_t idx) {
+    observer_t *o = &observers[idx];
+    int32_t *link = &peer_heads[peer_hash(&o->peer)];
+    while (*link != NIL && *link != idx) link = &observers[*link].next_peer;
+    if (*link == idx) *link = o->next_peer;
+
+    // Sacarlo del arreglo del recurso moviendo el último a su lugar
+    resource_t *r = o->res;
+    int32_t last = r->obs[--r->count];
+    r->obs[o->slot] = last;
+    observers[last].slot = o->slot;
+    resource_maybe_free(r);
+
+    o->used = false;
+    o->next_peer = free_head;
+    free_head = idx;
+    atomic_fetch_sub(&observer_count, 1);
+}
+
+int observe_register(const struct sockaddr_in *peer, const uint8_t *token, size_t token_len,
+                     const char *path, uint32_t *seq) {
+    if (!observers || token_len > 8 || strlen(path) >= OBSERVE_PATH_MAX) return -1;
+    pthread_mutex_lock(&observe_mutex);
+
+    int32_t idx = observer_find(peer, token, token_len);
+    if (idx != NIL && strcmp(observers[idx].res->path, path) == 0) {
+        // Renovación: misma suscripción
+        *seq = observers[idx].res->seq;
+        pthread_mutex_unlock(&observe_mutex);
+        return 0;
+    }
+    if (idx != NIL) {
+        // El mismo token pasa a observar otro recurso
+        observer_remove(idx);
+    }
+
+    resource_t *r = resource_find(path, true);
+    if (!r || free_head == NIL) {
+        if (r) resource_maybe_free(r);
+        pthread_mutex_unlock(&observe_mutex);
+        return -1;
+    }
+    if (r->count == r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : 8;
+        int32_t *obs = realloc(r->obs, cap * sizeof(int32_t));
+        if (!obs) {
+            resource_maybe_free(r);
+            pthread_mutex_unlock(&observe_mutex);
+            return -1;
+        }
+        r->obs = obs;
+        r->cap = cap;
+    }
+
+    idx = free_head;
+    observer_t *o = &observers[idx];
+    free_head = o->next_peer;
+    memset(o, 0, sizeof(*o));
+    o->used = true;
+    o->peer = *peer;
+    memcpy(o->token, token, token_len);
+    o->tkl = (uint8_t) token_len;
+    o->res = r;
+    o->slot = r->count;
+    o->con_sent_ms = timer_now_ms();
+    r->obs[r->count++] = idx;
+
+    uint32_t h = peer_hash(peer);
+    o->next_peer = peer_heads[h];
+    peer_heads[h] = idx;
+    atomic_fetch_add(&observer_count, 1);
+
+    *seq = r->seq;
+    pthread_mutex_unlock(&observe_mutex);
+    return 0;
+}
+
+void observe_cancel(const struct sockaddr_in *peer, const uint8_t *token, size_t token_len) {
+    if (!observers || token_len > 8) return;
+    pthread_mutex_lock(&observe_mutex);
+    int32_t idx = observer_find(peer, token, token_len);
+    if (idx != NIL) observer_remove(idx);
+    pthread_mutex_unlock(&observe_mutex);
+}
+
+void observe_changed(const char *path) {
+    // Camino rápido: sin suscripciones una mutación no toma ningún lock
+    if (atomic_load(&observer_count) == 0) return;
+
+    pthread_mutex_lock(&observe_mutex);
+    resource_t *r = resource_find(path, false);
+    if (r && r->count > 0 && !r->dirty) {
+        r->dirty = true;
+        r->next_dirty = NULL;
+        if (dirty_tail) dirty_tail->next_dirty = r;
+        else dirty_head = r;
+        dirty_tail = r;
+        pthread_cond_signal(&observe_cond);
+    }
+    pthread_mutex_unlock(&observe_mutex);
+}
+
+void observe_reply(const struct sockaddr_in *peer, uint16_t mid, bool reset) {
+    if (!observers || atomic_load(&observer_count) == 0) return;
+    pthread_mutex_lock(&observe_mutex);
+    for (int32_t i = peer_heads[peer_hash(peer)]; i != NIL; i = observers[i].next_peer) {
+        observer_t *o = &observers[i];
+        bool con = o->con_pending && o->con_mid == mid;
+        if (!same_peer(&o->peer, peer) || (!con && o->last_mid != mid)) continue;
+        if (reset) {
+            log_text("[INFO] Observe: RST de la notificación MID=0x%04X, observador dado de baja", mid);
+            observer_remove(i);
+            stats.removed++;
+        } else if (con) {
+            o->con_pending = false;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&observe_mutex);
+}
+
+void observe_set_socket(int sock) {
+    pthread_mutex_lock(&observe_mutex);
+    if (notify_sock < 0) {
+        notify_sock = sock;
+        pthread_cond_signal(&observe_cond);
+    }
+    pthread_mutex_unlock(&observe_mutex);
+}
+
+// Elegir el tipo y el MID de la notificación de cada observador (con el lock tomado y
+// el recurso todavía marcado como pendiente, para que no se libere al dar bajas).
+// Retorna cuántos destinos quedaron en targets
+static size_t collect_targets(resource_t *r, target_t *targets, uint64_t now) {
+    size_t n = 0;
+    size_t i = 0;
+    while (i < r->count) {
+        int32_t idx = r->obs[i];
+        observer_t *o = &observers[idx];
+        bool con = o->since_con + 1 >= OBSERVE_CON_EVERY || now - o->con_sent_ms >= OBSERVE_CON_INTERVAL * 1000ull;
+        if (con && o->con_pending) {
+            if (now - o->con_sent_ms >= OBSERVE_ACK_TIMEOUT * 1000ull) {
+                // Ninguna retransmisión de la CON anterior tuvo ACK: el cliente ya no está
+                observer_remove(idx);   // mueve el último a la posición i
+                stats.removed++;
+                continue;
+            }
+            con = false;
+        }
+
+        target_t *t = &targets[n++];
+        t->peer = o->peer;
+        memcpy(t->token, o->token, o->tkl);
+        t->tkl = o->tkl;
+        t->type = con ? COAP_TYPE_CON : COAP_TYPE_NON;
+        t->mid = next_mid++;
+        o->last_mid = t->mid;
+        if (con) {
+            o->con_mid = t->mid;
+            o->con_pending = true;
+            o->con_sent_ms = now;
+            o->since_con = 0;
+            stats.confirmable++;
+        } else {
+            o->since_con++;
+        }
+        i++;
+    }
+    return n;
+}
+
+// Enviar la notificación a todos los destinos: el mensaje se arma una vez y para
+// cada observador sólo cambian el tipo, el MID y el token. Las NON salen por lotes y las
+// CON por separate, que las retransmite hasta el ACK
+static void fan_out(int sock, const uint8_t *tmpl, size_t tmpl_len, const target_t *targets, size_t count) {
+    static uint8_t bufs[NETIO_MAX_BATCH][OBSERVE_PAYLOAD_MAX + 64];
+    netio_msg_t msgs[NETIO_MAX_BATCH];
+
+    for (size_t base = 0; base < count; base += NETIO_MAX_BATCH) {
+        size_t end = count - base < NETIO_MAX_BATCH ? count : base + NETIO_MAX_BATCH;
+        size_t k = 0;
+        for (size_t j = base; j < end; j++) {
+            const target_t *t = &targets[j];
+            uint8_t *out = bufs[k];
+            out[0] = (uint8_t) ((1 << 6) | (t->type << 4) | t->tkl);
+            out[1] = tmpl[1];
+            out[2] = (uint8_t) (t->mid >> 8);
+            out[3] = (uint8_t) (t->mid & 0xFF);
+            memcpy(out + 4, t->token, t->tkl);
+            memcpy(out + 4 + t->tkl, tmpl + 4, tmpl_len - 4);
+            if (t->type == COAP_TYPE_CON) {
+                if (separate_send_con(&t->peer, out, tmpl_len + t->tkl) != 0) {
+                    log_text("[WARNING] Observe: no se pudo enviar la notificación CON MID=0x%04X", t->mid);
+                }
+                continue;
+            }
+            msgs[k].buf = out;
+            msgs[k].len = tmpl_len + t->tkl;
+            msgs[k].addr = t->peer;
+            k++;
+        }
+        if (k == 0) continue;
+        if (netio_send_batch(sock, msgs, k) < (int) k) {
+            log_text("[WARNING] Observe: no se pudieron enviar todas las notificaciones");
+        }
+    }
+}
+
+static void *notifier_main(void *arg) {
+    (void) arg;
+    target_t *targets = NULL;
+    size_t targets_cap = 0;
+    char path[OBSERVE_PATH_MAX];
+    char payload[OBSERVE_PAYLOAD_MAX];
+    uint8_t tmpl[OBSERVE_PAYLOAD_MAX + 64];
+
+    pthread_mutex_lock(&observe_mutex);
+    while (1) {
+        while (!dirty_head || notify_sock < 0) pthread_cond_wait(&observe_cond, &observe_mutex);
+
+        resource_t *r = dirty_head;
+        dirty_head = r->next_dirty;
+        if (!dirty_head) dirty_tail = NULL;
+        r->seq = (r->seq + 1) & 0xFFFFFF;
+        uint32_t seq = r->seq;
+        memcpy(path, r->path, sizeof(path));
+
+        size_t count = 0;
+        if (r->count > targets_cap) {
+            size_t cap = r->count * 2;
+            target_t *grown = realloc(targets, cap * sizeof(target_t));
+            if (grown) {
+                targets = grown;
+                targets_cap = cap;
+            }
+        }
+        if (r->count <= targets_cap) {
+            count = collect_targets(r, targets, timer_now_ms());
+        } else {
+            log_text("[ERROR] Observe: sin memoria para notificar %s", path);
+        }
+        r->dirty = false;
+        resource_maybe_free(r);
+        int sock = notify_sock;
+        stats.rounds++;
+        stats.notifications += count;
+        pthread_mutex_unlock(&observe_mutex);
+
+        // Representación actual (el estado más reciente, aunque haya habido varios cambios)
+        size_t len = 0;
+        uint8_t code = render_cb(path, payload, sizeof(payload), &len);
+        bool success = (code >> 5) == 2;
+
+        coap_packet_t pkt;
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.ver = 1;
+        pkt.type = COAP_TYPE_NON;
+        pkt.code = code;
+        uint8_t seq_opt[4];
+        if (success) {
+            coap_add_option(&pkt, COAP_OPTION_OBSERVE, seq_opt, coap_encode_uint(seq, seq_opt));
+            pkt.payload = (uint8_t*) payload;
+            pkt.payload_len = len;
+        }
+        size_t tmpl_len;
+        if (count > 0 && coap_build(&pkt, tmpl, &tmpl_len, sizeof(tmpl)) == 0) {
+            fan_out(sock, tmpl, tmpl_len, targets, count);
+        }
+
+        pthread_mutex_lock(&observe_mutex);
+        if (!success) {
+            // Una respuesta de error termina la observación (RFC 7641 §3.2)
+            resource_t *gone = resource_find(path, false);
+            size_t left = gone ? gone->count : 0;
+            while (left-- > 0) {
+                observer_remove(gone->obs[left]);   // el último: no mueve a los demás
+                stats.removed++;
+            }
+        }
+    }
+    return NULL;
+}
+
+int observe_start(observe_render_t render) {
+    if (!render || observers) return -1;
+    observers = calloc(OBSERVE_MAX_OBSERVERS, sizeof(observer_t));
+    if (!observers) return -1;
+    for (int32_t i = 0; i < OBSERVE_MAX_OBSERVERS; i++) {
+        observers[i].next_peer = (i + 1 < OBSERVE_MAX_OBSERVERS) ? i + 1 : NIL;
+    }
+    free_head = 0;
+    for (size_t i = 0; i < PEER_BUCKETS; i++) peer_heads[i] = NIL;
+    render_cb = render;
+    next_mid = (uint16_t) timer_now_ms();
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, notifier_main, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+void observe_get_stats(observe_stats_t *st) {
+    pthread_mutex_lock(&observe_mutex);
+    *st = stats;
+    st->observers = atomic_load(&observer_count);
+    pthread_mutex_unlock(&observe_mutex);
+}
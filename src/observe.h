@@ -0,0 +1,56 @@
+#ifndef OBSERVE_H
+#define OBSERVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+// Observe (RFC 7641): los clientes se suscriben con GET + Observe=0 y reciben una
+// notificación cada vez que cambia el recurso, en vez de consultarlo periódicamente.
+// Las mutaciones sólo marcan el recurso como modificado (cambios seguidos se agrupan
+// en una notificación con el estado más reciente); un hilo notificador arma la
+// respuesta una vez y la envía a todos los observadores con sendmmsg por lotes. Las
+// notificaciones CON se retransmiten como las respuestas separadas (separate.h).
+
+#define OBSERVE_MAX_OBSERVERS 16384  // suscripciones simultáneas en total
+#define OBSERVE_PATH_MAX 64
+#define OBSERVE_PAYLOAD_MAX 512
+#define OBSERVE_CON_EVERY 20         // una de cada N notificaciones va como CON
+#define OBSERVE_CON_INTERVAL 60      // segundos máximos sin una CON a un observador
+#define OBSERVE_ACK_TIMEOUT 93       // MAX_TRANSMIT_WAIT: una CON sin ACK tras sus retransmisiones da de baja al observador
+
+// Representación actual de un recurso: escribe el payload y retorna el código CoAP
+typedef uint8_t (*observe_render_t)(const char *path, char *out, size_t max_len, size_t *len);
+
+typedef struct {
+    size_t observers;
+    uint64_t rounds;                 // recursos notificados
+    uint64_t notifications;          // mensajes enviados
+    uint64_t confirmable;
+    uint64_t removed;                // bajas por RST, ACK vencido o recurso borrado
+} observe_stats_t;
+
+// Arrancar el hilo notificador (antes de atender pedidos)
+int observe_start(observe_render_t render);
+
+// Socket desde el que salen las notificaciones (se usa el primero que se registra)
+void observe_set_socket(int sock);
+
+// Registrar (o renovar) al observador (peer, token) de path. seq recibe el número de
+// secuencia actual. Retorna 0, o -1 si no hay lugar
+int observe_register(const struct sockaddr_in *peer, const uint8_t *token, size_t token_len,
+                     const char *path, uint32_t *seq);
+
+// Cancelar la suscripción (peer, token) (GET con Observe=1)
+void observe_cancel(const struct sockaddr_in *peer, const uint8_t *token, size_t token_len);
+
+// Avisar que path cambió
+void observe_changed(const char *path);
+
+// ACK o RST de un cliente a una notificación (un RST lo da de baja)
+void observe_reply(const struct sockaddr_in *peer, uint16_t mid, bool reset);
+
+void observe_get_stats(observe_stats_t *st);
+
+#endif
@@ -0,0 +1,597 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "partition.h"
+#include "wal.h"
+#include "slab.h"
+
+#define PARTITION_SLOTS (PARTITION_MAX * 2)     // tabla de nombres llena a lo sumo hasta la mitad
+
+// Un registro de la partición. value NULL = borrado (o un id que nunca se usó)
+typedef struct {
+    time_t ts;
+    char *value;
+} part_record_t;
+
+// Último registro vivo de la partición, para leerlo sin locks (seqlock): el escritor, que ya
+// tiene el lock de escritura, pone seq en impar, cambia los campos y lo vuelve a par; el lector
+// copia los campos y reintenta si seq era impar o cambió mientras copiaba. Todos los campos son
+// atómicos relajados para que la lectura concurrente esté definida. Ocupa dos líneas de caché
+// propias, así leerlo no comparte línea con el lock ni con el resto de la partición
+#define LATEST_WORDS 13                     // 104 bytes de valor
+#define LATEST_TOO_LONG UINT32_MAX          // el valor no entra en el slot: se lee con el lock
+
+typedef struct {
+    _Alignas(64) atomic_uint_fast64_t seq;  // impar mientras se escribe
+    atomic_int id;                          // 0 = sin registros
+    atomic_uint len;
+    atomic_int_fast64_t ts;
+    atomic_uint_fast64_t words[LATEST_WORDS];
+} latest_t;
+
+typedef struct {
+    latest_t latest;
+    char name[PARTITION_NAME_MAX + 1];
+    // Lectores en paralelo, escritores exclusivos y con preferencia, como el lock global
+    pthread_rwlock_t lock;
+    // Los ids de un sensor son densos: se indexan directo en la ventana [base, base + cap).
+    // Borrar desde el principio corre lo (primer id que puede estar vivo) y, cuando la mitad
+    // de la ventana quedó atrás, se desplaza hasta lo en vez de crecer
+    part_record_t *records;
+    size_t cap;
+    int base, lo;
+    int next_id;
+    size_t live;
+    size_t log_records;             // registros en el segmento, vivos o reemplazados
+    int fd;
+    off_t file_len;
+    // Group commit del segmento: el primero que llega hace el fdatasync por todos los que
+    // escribieron antes que él
+    pthread_mutex_t sync_lock;
+    atomic_uint_fast64_t appended;  // bytes escritos desde que se abrió (no baja al reescribir)
+    uint64_t synced;                // con sync_lock
+} partition_t;
+
+// Las particiones no se borran: la búsqueda por nombre lee la tabla sin locks y sólo
+// la creación se serializa
+static _Atomic(partition_t*) slots[PARTITION_SLOTS];
+static pthread_mutex_t create_lock = PTHREAD_MUTEX_INITIALIZER;
+static char part_dir[256];
+static bool part_sync = false;
+
+static atomic_size_t partition_count = 0;
+static atomic_size_t live_records = 0;
+static atomic_uint_fast64_t compactions = 0;
+static atomic_size_t window_cells = 0;
+
+bool partition_valid_name(const char *name) {
+    bool digits_only = true;
+    size_t len = 0;
+    for (; name[len]; len++) {
+        char c = name[len];
+        bool digit = c >= '0' && c <= '9';
+        if (len == PARTITION_NAME_MAX) return false;
+        if (!digit && !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') && c != '_' && c != '-') return false;
+        if (!digit) digits_only = false;
+    }
+    return len > 0 && !digits_only;
+}
+
+static size_t hash_name(const char *name) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *name; name++) h = (h ^ (uint8_t) *name) * 1099511628211ULL;
+    return (size_t) (h ^ (h >> 32));
+}
+
+static void segment_path(const char *name, char *out, size_t max) {
+    snprintf(out, max, "%s/%s.wal", part_dir, name);
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+// Celda de un id, o NULL si está fuera de la ventana
+static part_record_t *record_at(partition_t *p, int id) {
+    if (id < p->base || id >= p->base + (int) p->cap) return NULL;
+    return &p->records[id - p->base];
+}
+
+// Hacer lugar en la ventana para id
+static int window_reserve(partition_t *p, int id) {
+    if (id < p->base) return -1;
+    if (id < p->base + (int) p->cap) return 0;
+
+    size_t dead = (size_t) (p->lo - p->base);
+    if (dead >= p->cap / 2 && id < p->lo + (int) p->cap) {
+        memmove(p->records, p->records + dead, (p->cap - dead) * sizeof(part_record_t));
+        memset(p->records + (p->cap - dead), 0, dead * sizeof(part_record_t));
+        p->base = p->lo;
+        return 0;
+    }
+    size_t cap = p->cap ? p->cap : 64;
+    while (id >= p->base + (int) cap) cap <<= 1;
+    part_record_t *grown = realloc(p->records, cap * sizeof(part_record_t));
+    if (!grown) return -1;
+    memset(grown + p->cap, 0, (cap - p->cap) * sizeof(part_record_t));
+    atomic_fetch_add_explicit(&window_cells, cap - p->cap, memory_order_relaxed);
+    p->records = grown;
+    p->cap = cap;
+    return 0;
+}
+
+// Correr lo sobre los borrados del principio
+static void advance_lo(partition_t *p) {
+    while (p->lo < p->next_id) {
+        part_record_t *r = record_at(p, p->lo);
+        if (r && r->value) break;
+        p->lo++;
+    }
+}
+
+// Publicar el último registro (con el lock de escritura; id 0 = la partición quedó vacía)
+static void latest_store(partition_t *p, int id, time_t ts, const char *value) {
+    latest_t *l = &p->latest;
+    uint64_t words[LATEST_WORDS] = { 0 };
+    size_t len = value ? strlen(value) : 0;
+    uint32_t stored = len <= sizeof(words) ? (uint32_t) len : LATEST_TOO_LONG;
+    size_t count = 0;
+    if (stored != LATEST_TOO_LONG) {
+        memcpy(words, value, len);
+        count = (len + 7) / 8;
+    }
+
+    uint64_t seq = atomic_load_explicit(&l->seq, memory_order_relaxed);
+    atomic_store_explicit(&l->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&l->id, id, memory_order_relaxed);
+    atomic_store_explicit(&l->len, stored, memory_order_relaxed);
+    atomic_store_explicit(&l->ts, (int_fast64_t) ts, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) atomic_store_explicit(&l->words[i], words[i], memory_order_relaxed);
+    atomic_store_explicit(&l->seq, seq + 2, memory_order_release);
+}
+
+// Volver a publicar el registro vivo de mayor id (con el lock de escritura)
+static void latest_refresh(partition_t *p) {
+    for (int id = p->next_id - 1; id >= p->lo; id--) {
+        part_record_t *r = record_at(p, id);
+        if (r && r->value) {
+            latest_store(p, id, r->ts, r->value);
+            return;
+        }
+    }
+    latest_store(p, 0, 0, NULL);
+}
+
+static int latest_id(partition_t *p) {
+    return atomic_load_explicit(&p->latest.id, memory_order_relaxed);
+}
+
+// Agregar un registro al segmento (con el lock de escritura). Retorna la posición que hay
+// que esperar con segment_sync, o 0 si falla (el segmento queda como estaba)
+static uint64_t segment_append(partition_t *p, wal_op_t op, int id, time_t ts, const char *value) {
+    uint8_t buf[WAL_RECORD_HEADER + PARTITION_VALUE_MAX];
+    wal_record_t rec = { .op = op, .id = id, .ts = ts, .value = value, .value_len = value ? strlen(value) : 0 };
+    size_t len = wal_encode(&rec, buf, sizeof(buf));
+    if (len == 0) return 0;
+    if (write_all(p->fd, buf, len) != 0) {
+        // Un registro a medias cortaría el replay de los siguientes
+        if (ftruncate(p->fd, p->file_len) != 0) return 0;
+        return 0;
+    }
+    p->file_len += (off_t) len;
+    p->log_records++;
+    return (uint64_t) atomic_fetch_add_explicit(&p->appended, len, memory_order_relaxed) + len;
+}
+
+// Esperar a que el segmento esté en disco hasta pos (sin el lock de la partición)
+static int segment_sync(partition_t *p, uint64_t pos) {
+    if (!part_sync) return 0;
+    pthread_mutex_lock(&p->sync_lock);
+    int res = 0;
+    if (p->synced < pos) {
+        uint64_t target = atomic_load_explicit(&p->appended, memory_order_relaxed);
+        res = fdatasync(p->fd);
+        if (res == 0) p->synced = target;
+    }
+    pthread_mutex_unlock(&p->sync_lock);
+    return res;
+}
+
+// Reescribir el segmento sólo con los registros vivos (con el lock de escritura)
+static int segment_compact(partition_t *p) {
+    char path[320], tmp[328];
+    segment_path(p->name, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    uint8_t chunk[16 * 1024];
+    size_t len = 0, count = 0;
+    off_t total = 0;
+    int res = 0;
+    for (int id = p->lo; res == 0 && id <= p->next_id; id++) {
+        part_record_t *r = record_at(p, id);
+        wal_record_t rec = { .op = WAL_OP_ADD, .id = id };
+        if (id == p->next_id) {
+            // Si el último id está borrado, un DELETE suyo conserva el contador al recargar
+            r = record_at(p, id - 1);
+            if (id == 1 || (r && r->value)) break;
+            rec.op = WAL_OP_DELETE;
+            rec.id = id - 1;
+        } else if (!r || !r->value) {
+            continue;
+        } else {
+            rec.ts = r->ts;
+            rec.value = r->value;
+            rec.value_len = strlen(r->value);
+        }
+        if (len + WAL_RECORD_HEADER + rec.value_len > sizeof(chunk)) {
+            res = write_all(fd, chunk, len);
+            total += (off_t) len;
+            len = 0;
+        }
+        size_t n = wal_encode(&rec, chunk + len, sizeof(chunk) - len);
+        if (n == 0) res = -1;
+        len += n;
+        count++;
+    }
+    if (res == 0 && len > 0) {
+        res = write_all(fd, chunk, len);
+        total += (off_t) len;
+    }
+    if (res == 0) res = fdatasync(fd);
+    if (res == 0) res = rename(tmp, path);
+    if (res != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+
+    // El descriptor nuevo ya apunta al segmento renombrado, y todo lo escrito antes quedó en disco
+    pthread_mutex_lock(&p->sync_lock);
+    close(p->fd);
+    p->fd = fd;
+    p->synced = atomic_load_explicit(&p->appended, memory_order_relaxed);
+    pthread_mutex_unlock(&p->sync_lock);
+    p->file_len = total;
+    p->log_records = count;
+    atomic_fetch_add_explicit(&compactions, 1, memory_order_relaxed);
+    return 0;
+}
+
+// Reescribir cuando los registros reemplazados superan a los vivos (con el lock de escritura).
+// Si falla se sigue con el segmento actual, que está completo
+static void maybe_compact(partition_t *p) {
+    if (p->log_records >= 2 * p->live + PARTITION_COMPACT_MIN) segment_compact(p);
+}
+
+// Reaplicar un registro del segmento al cargar la partición
+static int apply_record(const wal_record_t *rec, void *ctx) {
+    partition_t *p = (partition_t*) ctx;
+    if (rec->id <= 0) return -1;
+    if (rec->id >= p->next_id) p->next_id = rec->id + 1;
+    p->log_records++;
+
+    part_record_t *r = record_at(p, rec->id);
+    if (rec->op == WAL_OP_DELETE) {
+        if (r && r->value) {
+            slab_free(r->value);
+            r->value = NULL;
+            p->live--;
+            // Como en partition_delete: así la ventana se desplaza durante la carga en vez de crecer
+            if (rec->id == p->lo) advance_lo(p);
+        }
+        return 0;
+    }
+    if (rec->op == WAL_OP_UPDATE && (!r || !r->value)) return 0;
+    if (!r) {
+        // Los ADD llegan en orden creciente (también los de un segmento reescrito): la
+        // ventana empieza en el primer id vivo, no en 1
+        if (p->cap == 0) p->base = p->lo = rec->id;
+        if (window_reserve(p, rec->id) != 0) return -1;
+        r = record_at(p, rec->id);
+    }
+    char *value = slab_strndup(rec->value, rec->value_len);
+    if (!value) return -1;
+    if (r->value) {
+        slab_free(r->value);
+    } else {
+        p->live++;
+    }
+    r->value = value;
+    if (rec->op == WAL_OP_ADD) r->ts = rec->ts;
+    return 0;
+}
+
+static void partition_free(partition_t *p) {
+    for (size_t i = 0; i < p->cap; i++) slab_free(p->records[i].value);
+    atomic_fetch_sub_explicit(&window_cells, p->cap, memory_order_relaxed);
+    free(p->records);
+    pthread_rwlock_destroy(&p->lock);
+    pthread_mutex_destroy(&p->sync_lock);
+    free(p);
+}
+
+// Crear una partición y cargar su segmento si ya existe
+static partition_t *partition_open(const char *name) {
+    // Alineada a la línea de caché por el slot del último registro
+    partition_t *p = aligned_alloc(_Alignof(partition_t), sizeof(partition_t));
+    if (!p) return NULL;
+    memset(p, 0, sizeof(partition_t));
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&p->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&p->sync_lock, NULL);
+    p->base = p->lo = p->next_id = 1;
+    p->fd = -1;
+
+    char path[320];
+    segment_path(name, path, sizeof(path));
+    struct stat st;
+    if (wal_replay(path, apply_record, p) < 0 ||
+        (p->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0 || fstat(p->fd, &st) != 0) {
+        if (p->fd >= 0) close(p->fd);
+        partition_free(p);
+        return NULL;
+    }
+    p->file_len = st.st_size;
+    advance_lo(p);
+    latest_refresh(p);
+    atomic_fetch_add_explicit(&live_records, p->live, memory_order_relaxed);
+    return p;
+}
+
+// Buscar la partición de un sensor; con create la crea (y su segmento) si no existe
+static partition_t *partition_find(const char *name, bool create) {
+    size_t mask = PARTITION_SLOTS - 1;
+    size_t i = hash_name(name) & mask;
+    partition_t *p;
+    while ((p = atomic_load_explicit(&slots[i], memory_order_acquire))) {
+        if (strcmp(p->name, name) == 0) return p;
+        i = (i + 1) & mask;
+    }
+    if (!create || !partition_valid_name(name)) return NULL;
+
+    pthread_mutex_lock(&create_lock);
+    // Otro hilo pudo crear particiones mientras tanto: seguir el sondeo desde la celda vacía
+    while ((p = atomic_load_explicit(&slots[i], memory_order_acquire))) {
+        if (strcmp(p->name, name) == 0) break;
+        i = (i + 1) & mask;
+    }
+    if (!p && atomic_load(&partition_count) < PARTITION_MAX) {
+        p = partition_open(name);
+        if (p) {
+            atomic_store_explicit(&slots[i], p, memory_order_release);
+            atomic_fetch_add(&partition_count, 1);
+        }
+    }
+    pthread_mutex_unlock(&create_lock);
+    return p;
+}
+
+int partition_init(const char *dir, bool sync) {
+    snprintf(part_dir, sizeof(part_dir), "%s", dir);
+    part_sync = sync;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    int res = 0;
+    struct dirent *ent;
+    while (res == 0 && (ent = readdir(d))) {
+        // Sólo <sensor>.wal: un .tmp es una reescritura que no llegó a terminar
+        size_t len = strlen(ent->d_name);
+        if (len <= 4 || len - 4 > PARTITION_NAME_MAX || strcmp(ent->d_name + len - 4, ".wal") != 0) continue;
+        char name[PARTITION_NAME_MAX + 1];
+        memcpy(name, ent->d_name, len - 4);
+        name[len - 4] = '\0';
+        if (partition_valid_name(name) && !partition_find(name, true)) res = -1;
+    }
+    closedir(d);
+    return res;
+}
+
+int partition_add(const char *sensor, const char *value) {
+    if (!sensor || !value) return -1;
+    size_t len = strlen(value);
+    if (len > PARTITION_VALUE_MAX) return -1;
+    partition_t *p = partition_find(sensor, true);
+    if (!p) return atomic_load(&partition_count) >= PARTITION_MAX ? -3 : -1;
+
+    char *copy = slab_strndup(value, len);
+    if (!copy) return -1;
+
+    pthread_rwlock_wrlock(&p->lock);
+    int id = p->next_id;
+    time_t now = time(NULL);
+    uint64_t pos = 0;
+    if (window_reserve(p, id) != 0 || (pos = segment_append(p, WAL_OP_ADD, id, now, copy)) == 0) {
+        pthread_rwlock_unlock(&p->lock);
+        slab_free(copy);
+        return -1;
+    }
+    part_record_t *r = record_at(p, id);
+    r->ts = now;
+    r->value = copy;
+    p->next_id++;
+    p->live++;
+    latest_store(p, id, now, copy);
+    atomic_fetch_add_explicit(&live_records, 1, memory_order_relaxed);
+    maybe_compact(p);
+    pthread_rwlock_unlock(&p->lock);
+    return segment_sync(p, pos) == 0 ? id : -1;
+}
+
+int partition_get(const char *sensor, int id, char *out, size_t max_len) {
+    if (!sensor || !out || max_len == 0) return -1;
+    partition_t *p = partition_find(sensor, false);
+    if (!p) return -2;
+
+    pthread_rwlock_rdlock(&p->lock);
+    part_record_t *r = record_at(p, id);
+    if (!r || !r->value) {
+        pthread_rwlock_unlock(&p->lock);
+        return -2;
+    }
+    size_t len = strlen(r->value);
+    if (len >= max_len) len = max_len - 1;
+    memcpy(out, r->value, len);
+    out[len] = '\0';
+    pthread_rwlock_unlock(&p->lock);
+    return 0;
+}
+
+int partition_update(const char *sensor, int id, const char *value) {
+    if (!sensor || !value) return -1;
+    size_t len = strlen(value);
+    if (len > PARTITION_VALUE_MAX) return -1;
+    partition_t *p = partition_find(sensor, false);
+    if (!p) return -2;
+
+    char *copy = slab_strndup(value, len);
+    if (!copy) return -1;
+
+    pthread_rwlock_wrlock(&p->lock);
+    part_record_t *r = record_at(p, id);
+    if (!r || !r->value) {
+        pthread_rwlock_unlock(&p->lock);
+        slab_free(copy);
+        return -2;
+    }
+    uint64_t pos = segment_append(p, WAL_OP_UPDATE, id, r->ts, copy);
+    if (pos == 0) {
+        pthread_rwlock_unlock(&p->lock);
+        slab_free(copy);
+        return -1;
+    }
+    slab_free(r->value);
+    r->value = copy;
+    if (id == latest_id(p)) latest_store(p, id, r->ts, copy);
+    maybe_compact(p);
+    pthread_rwlock_unlock(&p->lock);
+    return segment_sync(p, pos);
+}
+
+int partition_delete(const char *sensor, int id) {
+    if (!sensor) return -1;
+    partition_t *p = partition_find(sensor, false);
+    if (!p) return -2;
+
+    pthread_rwlock_wrlock(&p->lock);
+    part_record_t *r = record_at(p, id);
+    if (!r || !r->value) {
+        pthread_rwlock_unlock(&p->lock);
+        return -2;
+    }
+    uint64_t pos = segment_append(p, WAL_OP_DELETE, id, 0, NULL);
+    if (pos == 0) {
+        pthread_rwlock_unlock(&p->lock);
+        return -1;
+    }
+    slab_free(r->value);
+    r->value = NULL;
+    p->live--;
+    atomic_fetch_sub_explicit(&live_records, 1, memory_order_relaxed);
+    advance_lo(p);
+    if (id == latest_id(p)) latest_refresh(p);
+    maybe_compact(p);
+    pthread_rwlock_unlock(&p->lock);
+    return segment_sync(p, pos);
+}
+
+// El último registro con el lock de lectura (valores que no entran en el slot)
+static int latest_locked(partition_t *p, int *id, time_t *ts, char *out, size_t max_len) {
+    pthread_rwlock_rdlock(&p->lock);
+    int res = -2;
+    part_record_t *r = record_at(p, latest_id(p));
+    if (r && r->value) {
+        *id = latest_id(p);
+        *ts = r->ts;
+        size_t len = strlen(r->value);
+        if (len >= max_len) len = max_len - 1;
+        memcpy(out, r->value, len);
+        out[len] = '\0';
+        res = 0;
+    }
+    pthread_rwlock_unlock(&p->lock);
+    return res;
+}
+
+int partition_latest(const char *sensor, int *id, time_t *ts, char *out, size_t max_len) {
+    if (!sensor || !out || max_len == 0) return -1;
+    partition_t *p = partition_find(sensor, false);
+    if (!p) return -2;
+
+    latest_t *l = &p->latest;
+    uint64_t words[LATEST_WORDS];
+    int rid;
+    uint32_t len;
+    int_fast64_t rts;
+    for (;;) {
+        uint64_t seq = atomic_load_explicit(&l->seq, memory_order_acquire);
+        if (seq & 1) continue;
+        rid = atomic_load_explicit(&l->id, memory_order_relaxed);
+        len = atomic_load_explicit(&l->len, memory_order_relaxed);
+        rts = atomic_load_explicit(&l->ts, memory_order_relaxed);
+        size_t count = len <= sizeof(words) ? (len + 7) / 8 : 0;
+        for (size_t i = 0; i < count; i++) words[i] = atomic_load_explicit(&l->words[i], memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&l->seq, memory_order_relaxed) == seq) break;
+    }
+    if (rid == 0) return -2;
+    if (len == LATEST_TOO_LONG) return latest_locked(p, id, ts, out, max_len);
+
+    if (len >= max_len) len = (uint32_t) max_len - 1;
+    memcpy(out, words, len);
+    out[len] = '\0';
+    *id = rid;
+    *ts = (time_t) rts;
+    return 0;
+}
+
+int partition_scan(const char *sensor, int after_id, size_t max, storage_scan_cb cb, void *ctx) {
+    if (!sensor) return 0;
+    if (max > STORAGE_SCAN_MAX) max = STORAGE_SCAN_MAX;
+    partition_t *p = partition_find(sensor, false);
+    if (!p) return 0;
+
+    pthread_rwlock_rdlock(&p->lock);
+    size_t visited = 0;
+    int id = after_id + 1 > p->lo ? after_id + 1 : p->lo;
+    for (; id < p->next_id && visited < max; id++) {
+        part_record_t *r = record_at(p, id);
+        if (!r || !r->value) continue;
+        cb(id, r->ts, r->value, ctx);
+        visited++;
+    }
+    pthread_rwlock_unlock(&p->lock);
+    return (int) visited;
+}
+
+void partition_get_stats(partition_stats_t *stats) {
+    stats->partitions = atomic_load(&partition_count);
+    stats->records = atomic_load_explicit(&live_records, memory_order_relaxed);
+    stats->compactions = atomic_load_explicit(&compactions, memory_order_relaxed);
+    stats->window_cells = atomic_load_explicit(&window_cells, memory_order_relaxed);
+}
@@ -0,0 +1,59 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "storage.h"
+
+// Registros particionados por sensor (data/<sensor>/<id>).
+// Cada sensor tiene su propio segmento en el directorio de particiones (<dir>/<sensor>.wal,
+// en el formato del WAL), su propio contador de ids y su propio lock: las escrituras de
+// sensores distintos no se esperan entre sí y recorrer un sensor no lee los datos de los demás.
+// El segmento se reescribe sólo con los registros vivos cuando los reemplazados lo duplican.
+
+#define PARTITION_NAME_MAX 32       // letras, dígitos, '_' y '-'; no puede ser sólo dígitos (eso es un id)
+#define PARTITION_MAX 4096          // sensores distintos
+#define PARTITION_VALUE_MAX 1024    // bytes de un valor
+#define PARTITION_COMPACT_MIN 1024  // registros reemplazados que se toleran antes de reescribir
+
+// Abrir el directorio (se crea si no existe) y cargar los segmentos que tenga.
+// Con sync cada mutación espera su fdatasync, compartido entre los escritores del mismo sensor
+int partition_init(const char *dir, bool sync);
+
+// true si name sirve como nombre de partición
+bool partition_valid_name(const char *name);
+
+// Guardar un dato nuevo en la partición (se crea con el primero). Retorna su id (> 0),
+// -1 si falla el almacenamiento o -3 si ya no hay lugar para otra partición
+int partition_add(const char *sensor, const char *value);
+
+// Obtener un dato por id. Retorna 0, o -2 si no existe
+int partition_get(const char *sensor, int id, char *out, size_t max_len);
+
+// Actualizar un dato por id. Retorna 0, -2 si no existe o -1 si falla el almacenamiento
+int partition_update(const char *sensor, int id, const char *value);
+
+// Eliminar un dato por id. Retorna 0, -2 si no existe o -1 si falla el almacenamiento
+int partition_delete(const char *sensor, int id);
+
+// Último registro vivo del sensor (el de mayor id), sin locks ni memoria dinámica: cada
+// escritura lo publica en un slot de la partición protegido por un seqlock. Retorna 0, o -2
+// si el sensor no existe o no tiene registros
+int partition_latest(const char *sensor, int *id, time_t *ts, char *out, size_t max_len);
+
+// Recorrer hasta max registros (como mucho STORAGE_SCAN_MAX) del sensor con id > after_id,
+// en orden creciente y con el lock de lectura de esa partición. Retorna cuántos visitó
+int partition_scan(const char *sensor, int after_id, size_t max, storage_scan_cb cb, void *ctx);
+
+// Estadísticas de todas las particiones
+typedef struct {
+    size_t partitions;
+    size_t records;             // registros vivos
+    uint64_t compactions;       // segmentos reescritos
+    size_t window_cells;        // celdas de las ventanas de ids (la memoria crece con esto, no con los ids)
+} partition_stats_t;
+
+void partition_get_stats(partition_stats_t *stats);
+
+#endif
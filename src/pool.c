@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "pool.h"
+#include "ring.h"
+
+typedef struct {
+    ring_t queue;
+    size_t max_busy;
+    int weight;
+    int current;                // crédito del round-robin ponderado (suave, como el de nginx), con el lock
+    _Alignas(RING_CACHELINE) atomic_size_t busy;
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t processed;
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t submitted;
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t dropped;
+} lane_t;
+
+struct worker_pool {
+    lane_t lanes[POOL_MAX_LANES];
+    size_t lane_count;
+    // El lock sólo elige carril cuando hay más de uno y duerme a los workers sin trabajo.
+    // Encolar no lo toma salvo que haya alguien durmiendo: con un solo carril, mientras
+    // llegan datagramas, ni el loop de recepción ni los workers pasan por él
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    bool stopping;
+    pthread_t *threads;
+    size_t workers;
+    pool_handler_t handler;
+    pool_batch_handler_t batch_handler;
+    size_t max_batch;
+    _Alignas(RING_CACHELINE) atomic_size_t sleeping;
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t dropped;   // antes de llegar a una cola
+};
+
+// true si el carril tiene elementos y le quedan workers
+static bool lane_ready(lane_t *lane) {
+    return atomic_load_explicit(&lane->busy, memory_order_relaxed) < lane->max_busy && ring_count(&lane->queue) > 0;
+}
+
+static bool pool_has_work(worker_pool_t *pool) {
+    for (size_t i = 0; i < pool->lane_count; i++) {
+        if (lane_ready(&pool->lanes[i])) return true;
+    }
+    return false;
+}
+
+// Elegir el carril a atender (con el lock tomado): entre los que tienen elementos y no
+// llegaron a su tope de workers, round-robin ponderado. NULL si no hay ninguno
+static lane_t *pick_lane(worker_pool_t *pool) {
+    lane_t *best = NULL;
+    int total = 0;
+    for (size_t i = 0; i < pool->lane_count; i++) {
+        lane_t *lane = &pool->lanes[i];
+        if (!lane_ready(lane)) continue;
+        lane->current += lane->weight;
+        total += lane->weight;
+        if (!best || lane->current > best->current) best = lane;
+    }
+    if (best) best->current -= total;
+    return best;
+}
+
+// Despertar a un worker si hay alguno durmiendo. El fence ordena lo encolado antes de leer
+// sleeping, y worker_wait hace lo mismo al revés: o el que encola ve al que duerme, o el
+// que se va a dormir ve el elemento
+static void wake_one(worker_pool_t *pool) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->sleeping, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Esperar a que haya trabajo. Retorna false si el pool se detiene y ya no queda nada
+static bool worker_wait(worker_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add_explicit(&pool->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    bool pending = pool_has_work(pool);
+    bool running = true;
+    if (!pending) {
+        // Al detener, los workers terminan de vaciar las colas antes de salir
+        if (pool->stopping) running = false;
+        else pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    atomic_fetch_sub_explicit(&pool->sleeping, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&pool->lock);
+    // Hay un elemento contado que todavía se está encolando: ceder el core en vez de girar
+    if (pending) sched_yield();
+    return running;
+}
+
+// Tomar lo que ya esté en cola del carril (hasta max_batch), sin volver a dormir
+static size_t lane_take(worker_pool_t *pool, lane_t *lane, void **items) {
+    size_t count = 0;
+    while (count < pool->max_batch && ring_pop(&lane->queue, &items[count])) count++;
+    if (count > 0) atomic_fetch_add_explicit(&lane->busy, 1, memory_order_relaxed);
+    return count;
+}
+
+// Cuerpo de cada worker: dormir hasta que haya trabajo en algún carril y ejecutarlo
+static void *worker_main(void *arg) {
+    worker_pool_t *pool = (worker_pool_t*) arg;
+    void *items[POOL_MAX_BATCH];
+
+    for (;;) {
+        lane_t *lane = &pool->lanes[0];
+        size_t count = 0;
+        if (pool->lane_count == 1) {
+            // Un solo carril: no hay nada que planificar y su tope es el pool entero
+            count = lane_take(pool, lane, items);
+        } else {
+            pthread_mutex_lock(&pool->lock);
+            lane = pick_lane(pool);
+            if (lane) count = lane_take(pool, lane, items);
+            pthread_mutex_unlock(&pool->lock);
+        }
+        if (count == 0) {
+            if (!worker_wait(pool)) break;
+            continue;
+        }
+
+        // Si queda trabajo que este worker no toma, despertar a otro
+        if (pool_has_work(pool)) wake_one(pool);
+
+        if (pool->batch_handler) {
+            pool->batch_handler(items, count);
+        } else {
+            for (size_t i = 0; i < count; i++) pool->handler(items[i]);
+        }
+
+        atomic_fetch_add_explicit(&lane->processed, count, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&lane->busy, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+worker_pool_t *pool_create_lanes(size_t workers, const pool_lane_config_t *lanes, size_t lane_count,
+                                 size_t max_batch, pool_handler_t handler, pool_batch_handler_t batch_handler) {
+    if (workers == 0 || !lanes || lane_count == 0 || lane_count > POOL_MAX_LANES) return NULL;
+    if (max_batch == 0 || max_batch > POOL_MAX_BATCH) return NULL;
+    if (!handler == !batch_handler) return NULL;
+
+    worker_pool_t *pool = calloc(1, sizeof(worker_pool_t));
+    if (!pool) return NULL;
+
+    for (size_t i = 0; i < lane_count; i++) {
+        lane_t *lane = &pool->lanes[i];
+        if (lanes[i].queue_capacity == 0 || ring_init(&lane->queue, lanes[i].queue_capacity) != 0) {
+            for (size_t j = 0; j < i; j++) ring_destroy(&pool->lanes[j].queue);
+            free(pool);
+            return NULL;
+        }
+        lane->max_busy = (lanes[i].max_busy == 0 || lanes[i].max_busy > workers) ? workers : lanes[i].max_busy;
+        lane->weight = lanes[i].weight ? (int) lanes[i].weight : 1;
+        pool->lane_count++;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pool->handler = handler;
+    pool->batch_handler = batch_handler;
+    pool->max_batch = max_batch;
+
+    pool->threads = calloc(workers, sizeof(pthread_t));
+    if (pool->threads) {
+        for (size_t i = 0; i < workers; i++) {
+            if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) break;
+            pool->workers++;
+        }
+    }
+    if (pool->workers == 0) {
+        free(pool->threads);
+        for (size_t i = 0; i < pool->lane_count; i++) ring_destroy(&pool->lanes[i].queue);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+worker_pool_t *pool_create(size_t workers, size_t queue_capacity, pool_handler_t handler) {
+    if (!handler) return NULL;
+    pool_lane_config_t lane = { .queue_capacity = queue_capacity };
+    return pool_create_lanes(workers, &lane, 1, 1, handler, NULL);
+}
+
+worker_pool_t *pool_create_batch(size_t workers, size_t queue_capacity, size_t max_batch,
+                                 pool_batch_handler_t handler) {
+    if (!handler) return NULL;
+    pool_lane_config_t lane = { .queue_capacity = queue_capacity };
+    return pool_create_lanes(workers, &lane, 1, max_batch, NULL, handler);
+}
+
+int pool_submit_lane(worker_pool_t *pool, size_t lane_idx, void *item) {
+    if (lane_idx >= pool->lane_count) lane_idx = 0;
+    lane_t *lane = &pool->lanes[lane_idx];
+    if (!ring_push(&lane->queue, item)) {
+        atomic_fetch_add_explicit(&lane->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+    atomic_fetch_add_explicit(&lane->submitted, 1, memory_order_relaxed);
+    wake_one(pool);
+    return 0;
+}
+
+int pool_submit(worker_pool_t *pool, void *item) {
+    return pool_submit_lane(pool, 0, item);
+}
+
+void pool_count_drop(worker_pool_t *pool) {
+    atomic_fetch_add_explicit(&pool->dropped, 1, memory_order_relaxed);
+}
+
+// Estadísticas de un carril
+static void lane_stats(lane_t *lane, pool_stats_t *stats) {
+    stats->workers = lane->max_busy;
+    stats->busy = atomic_load_explicit(&lane->busy, memory_order_relaxed);
+    stats->queue_depth = ring_count(&lane->queue);
+    stats->queue_capacity = ring_capacity(&lane->queue);
+    stats->submitted = atomic_load_explicit(&lane->submitted, memory_order_relaxed);
+    stats->processed = atomic_load_explicit(&lane->processed, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&lane->dropped, memory_order_relaxed);
+}
+
+void pool_get_stats(worker_pool_t *pool, pool_stats_t *stats) {
+    pool_stats_t total = { .workers = pool->workers };
+    for (size_t i = 0; i < pool->lane_count; i++) {
+        pool_stats_t st;
+        lane_stats(&pool->lanes[i], &st);
+        total.busy += st.busy;
+        total.queue_depth += st.queue_depth;
+        total.queue_capacity += st.queue_capacity;
+        total.submitted += st.submitted;
+        total.processed += st.processed;
+        total.dropped += st.dropped;
+    }
+    total.dropped += atomic_load_explicit(&pool->dropped, memory_order_relaxed);
+    *stats = total;
+}
+
+void pool_get_lane_stats(worker_pool_t *pool, size_t lane, pool_stats_t *stats) {
+    if (lane >= pool->lane_count) lane = 0;
+    lane_stats(&pool->lanes[lane], stats);
+}
+
+size_t pool_lane_count(const worker_pool_t *pool) {
+    return pool->lane_count;
+}
+
+void pool_destroy(worker_pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->workers; i++) pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    for (size_t i = 0; i < pool->lane_count; i++) ring_destroy(&pool->lanes[i].queue);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,70 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Función que ejecuta cada worker por cada elemento de la cola
+typedef void (*pool_handler_t)(void *item);
+
+// Variante por lotes: el worker recibe hasta max_batch elementos de una vez
+typedef void (*pool_batch_handler_t)(void **items, size_t count);
+
+#define POOL_MAX_BATCH 64
+#define POOL_MAX_LANES 4
+
+// Carriles: cada uno tiene su propia cola acotada y un tope de workers que puede ocupar a
+// la vez, así un tipo de trabajo lento no acapara todo el pool. Cuando hay trabajo en varios
+// carriles, los workers libres los atienden por round-robin ponderado (weight)
+typedef struct {
+    size_t queue_capacity;
+    size_t max_busy;        // workers a la vez en este carril (0 = todos)
+    unsigned weight;        // parte de los turnos cuando compite con otros carriles (0 = 1)
+} pool_lane_config_t;
+
+// Estadísticas de un carril (o del pool entero: la suma de sus carriles)
+typedef struct {
+    size_t workers;         // en un carril, su tope de workers
+    size_t busy;            // workers procesando un elemento
+    size_t queue_depth;     // elementos esperando en la cola
+    size_t queue_capacity;
+    uint64_t submitted;
+    uint64_t processed;
+    uint64_t dropped;       // elementos descartados por cola llena
+} pool_stats_t;
+
+typedef struct worker_pool worker_pool_t;
+
+// Crear un pool fijo de workers alimentado por una cola MPMC sin locks
+worker_pool_t *pool_create(size_t workers, size_t queue_capacity, pool_handler_t handler);
+
+// Crear un pool cuyos workers toman lotes de hasta max_batch elementos
+worker_pool_t *pool_create_batch(size_t workers, size_t queue_capacity, size_t max_batch,
+                                 pool_batch_handler_t handler);
+
+// Crear un pool con lane_count carriles. Se usa handler o batch_handler (el otro en NULL);
+// los lotes se arman siempre con elementos de un mismo carril
+worker_pool_t *pool_create_lanes(size_t workers, const pool_lane_config_t *lanes, size_t lane_count,
+                                 size_t max_batch, pool_handler_t handler, pool_batch_handler_t batch_handler);
+
+// Encolar un elemento en el primer carril. Retorna -1 (y cuenta un descarte) si la cola está llena
+int pool_submit(worker_pool_t *pool, void *item);
+
+// Encolar un elemento en el carril lane. Retorna -1 (y cuenta un descarte) si su cola está llena
+int pool_submit_lane(worker_pool_t *pool, size_t lane, void *item);
+
+// Registrar un descarte ocurrido antes de llegar a la cola
+void pool_count_drop(worker_pool_t *pool);
+
+// Leer las estadísticas actuales del pool
+void pool_get_stats(worker_pool_t *pool, pool_stats_t *stats);
+
+// Leer las estadísticas de un carril
+void pool_get_lane_stats(worker_pool_t *pool, size_t lane, pool_stats_t *stats);
+
+size_t pool_lane_count(const worker_pool_t *pool);
+
+// Procesar lo que queda en la cola, detener los workers y liberar el pool
+void pool_destroy(worker_pool_t *pool);
+
+#endif
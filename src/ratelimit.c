@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "ratelimit.h"
+
+#define SHARD_CAPACITY (RATELIMIT_CAPACITY / RATELIMIT_SHARDS)
+
+typedef struct {
+    uint32_t addr;
+    uint16_t port;
+    bool used;
+    double tokens;
+    uint64_t last_ns;            // última recarga
+} bucket_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    bucket_t *buckets;
+    size_t count;
+    uint64_t allowed, limited, evicted;
+} shard_t;
+
+static shard_t shards[RATELIMIT_SHARDS];
+static double fill_rate = 0;     // fichas por segundo
+static double capacity = 0;
+static bool enabled = false;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t key_hash(uint32_t addr, uint16_t port) {
+    uint64_t k = ((uint64_t) addr << 16) | port;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (uint32_t) k;
+}
+
+int ratelimit_init(double rate, double burst) {
+    if (rate <= 0) return 0;
+    if (enabled) return 0;
+    fill_rate = rate;
+    capacity = burst >= 1 ? burst : 1;
+    for (size_t s = 0; s < RATELIMIT_SHARDS; s++) {
+        shard_t *sh = &shards[s];
+        sh->buckets = calloc(SHARD_CAPACITY, sizeof(bucket_t));
+        if (!sh->buckets) return -1;
+        pthread_mutex_init(&sh->lock, NULL);
+    }
+    enabled = true;
+    return 0;
+}
+
+bool ratelimit_enabled(void) {
+    return enabled;
+}
+
+// Balde de peer en el shard: el existente, uno libre o el más viejo de la ventana de búsqueda
+static bucket_t *lookup(shard_t *sh, uint32_t h, uint32_t addr, uint16_t port, uint64_t now) {
+    bucket_t *free_slot = NULL, *oldest = NULL;
+    for (size_t i = 0; i < RATELIMIT_PROBE; i++) {
+        bucket_t *b = &sh->buckets[(h + i) % SHARD_CAPACITY];
+        if (!b->used) {
+            if (!free_slot) free_slot = b;
+            continue;
+        }
+        if (b->addr == addr && b->port == port) return b;
+        if (!oldest || b->last_ns < oldest->last_ns) oldest = b;
+    }
+
+    bucket_t *b = free_slot;
+    if (b) {
+        sh->count++;
+    } else {
+        b = oldest;
+        sh->evicted++;
+    }
+    b->used = true;
+    b->addr = addr;
+    b->port = port;
+    b->tokens = capacity;
+    b->last_ns = now;
+    return b;
+}
+
+bool ratelimit_allow(const struct sockaddr_in *peer, uint32_t *retry_after) {
+    if (!enabled) return true;
+
+    uint32_t addr = peer->sin_addr.s_addr;
+    uint16_t port = peer->sin_port;
+    uint32_t h = key_hash(addr, port);
+    shard_t *sh = &shards[h % RATELIMIT_SHARDS];
+    uint64_t now = now_ns();
+
+    pthread_mutex_lock(&sh->lock);
+    bucket_t *b = lookup(sh, h / RATELIMIT_SHARDS, addr, port, now);
+    b->tokens += (double) (now - b->last_ns) * 1e-9 * fill_rate;
+    if (b->tokens > capacity) b->tokens = capacity;
+    b->last_ns = now;
+
+    bool ok = b->tokens >= 1.0;
+    if (ok) {
+        b->tokens -= 1.0;
+        sh->allowed++;
+    } else {
+        sh->limited++;
+        if (retry_after) {
+            double wait = ceil((1.0 - b->tokens) / fill_rate);
+            *retry_after = wait < 1 ? 1 : (uint32_t) wait;
+        }
+    }
+    pthread_mutex_unlock(&sh->lock);
+    return ok;
+}
+
+void ratelimit_get_stats(ratelimit_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    if (!enabled) return;
+    for (size_t s = 0; s < RATELIMIT_SHARDS; s++) {
+        shard_t *sh = &shards[s];
+        pthread_mutex_lock(&sh->lock);
+        st->allowed += sh->allowed;
+        st->limited += sh->limited;
+        st->evicted += sh->evicted;
+        st->endpoints += sh->count;
+        pthread_mutex_unlock(&sh->lock);
+    }
+}
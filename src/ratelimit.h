@@ -0,0 +1,37 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+// Límite de pedidos por endpoint (IP y puerto) con un token bucket cada uno: se recargan
+// rate fichas por segundo hasta burst y cada pedido gasta una. La tabla tiene tamaño fijo,
+// repartida en shards con su propio mutex; cada endpoint se busca en RATELIMIT_PROBE
+// posiciones seguidas y, si no hay lugar, reemplaza al que hace más tiempo que no envía
+// (que vuelve con el balde lleno).
+
+#define RATELIMIT_SHARDS 16
+#define RATELIMIT_CAPACITY 65536     // endpoints en total
+#define RATELIMIT_PROBE 8
+
+typedef struct {
+    uint64_t allowed;
+    uint64_t limited;                // pedidos rechazados por balde vacío
+    uint64_t evicted;                // endpoints reemplazados por falta de lugar
+    size_t endpoints;
+} ratelimit_stats_t;
+
+// Reservar la tabla con rate fichas por segundo y hasta burst acumuladas (rate 0 = sin límite)
+int ratelimit_init(double rate, double burst);
+
+bool ratelimit_enabled(void);
+
+// Gastar una ficha de peer. Retorna true si el pedido entra; si no, retry_after tiene
+// los segundos hasta la próxima ficha (al menos 1)
+bool ratelimit_allow(const struct sockaddr_in *peer, uint32_t *retry_after);
+
+void ratelimit_get_stats(ratelimit_stats_t *st);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "respcache.h"
+
+#define SHARD_CAPACITY (RESPCACHE_CAPACITY / RESPCACHE_SHARDS)
+#define SHARD_BUCKETS (SHARD_CAPACITY * 2)
+#define NIL (-1)
+
+typedef struct {
+    int id;                      // 0 = libre
+    bool ready;                  // false = reserva esperando respcache_put
+    uint64_t ticket;
+    int32_t next;                // cadena del bucket (o lista libre)
+    int32_t lru_prev, lru_next;  // más reciente al frente
+    uint8_t etag_len;
+    uint16_t len;
+    uint8_t etag[RESPCACHE_ETAG_MAX];
+    uint8_t tail[RESPCACHE_TAIL_MAX];
+} entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    entry_t entries[SHARD_CAPACITY];
+    int32_t buckets[SHARD_BUCKETS];
+    int32_t free_head;
+    int32_t lru_head, lru_tail;
+    uint64_t next_ticket;
+    uint64_t hits, misses, invalidations;
+    size_t count;
+} shard_t;
+
+static shard_t *shards = NULL;
+
+static shard_t *shard_of(int id) {
+    return &shards[((uint32_t) id * 2654435761u >> 16) % RESPCACHE_SHARDS];
+}
+
+static int32_t *bucket_of(shard_t *sh, int id) {
+    return &sh->buckets[((uint32_t) id * 2246822519u) % SHARD_BUCKETS];
+}
+
+int respcache_init(void) {
+    if (shards) return 0;
+    shards = calloc(RESPCACHE_SHARDS, sizeof(shard_t));
+    if (!shards) return -1;
+    for (size_t s = 0; s < RESPCACHE_SHARDS; s++) {
+        shard_t *sh = &shards[s];
+        pthread_mutex_init(&sh->lock, NULL);
+        for (size_t i = 0; i < SHARD_BUCKETS; i++) sh->buckets[i] = NIL;
+        for (size_t i = 0; i < SHARD_CAPACITY; i++) sh->entries[i].next = (i + 1 < SHARD_CAPACITY) ? (int32_t) (i + 1) : NIL;
+        sh->free_head = 0;
+        sh->lru_head = sh->lru_tail = NIL;
+    }
+    return 0;
+}
+
+static int32_t find(shard_t *sh, int id) {
+    for (int32_t i = *bucket_of(sh, id); i != NIL; i = sh->entries[i].next) {
+        if (sh->entries[i].id == id) return i;
+    }
+    return NIL;
+}
+
+static void lru_unlink(shard_t *sh, int32_t idx) {
+    entry_t *e = &sh->entries[idx];
+    if (e->lru_prev != NIL) sh->entries[e->lru_prev].lru_next = e->lru_next;
+    else sh->lru_head = e->lru_next;
+    if (e->lru_next != NIL) sh->entries[e->lru_next].lru_prev = e->lru_prev;
+    else sh->lru_tail = e->lru_prev;
+}
+
+static void lru_push_front(shard_t *sh, int32_t idx) {
+    entry_t *e = &sh->entries[idx];
+    e->lru_prev = NIL;
+    e->lru_next = sh->lru_head;
+    if (sh->lru_head != NIL) sh->entries[sh->lru_head].lru_prev = idx;
+    else sh->lru_tail = idx;
+    sh->lru_head = idx;
+}
+
+static void remove_entry(shard_t *sh, int32_t idx) {
+    entry_t *e = &sh->entries[idx];
+    int32_t *link = bucket_of(sh, e->id);
+    while (*link != NIL && *link != idx) link = &sh->entries[*link].next;
+    if (*link == idx) *link = e->next;
+    lru_unlink(sh, idx);
+    e->id = 0;
+    e->next = sh->free_head;
+    sh->free_head = idx;
+    sh->count--;
+}
+
+int respcache_get(int id, uint8_t *tail, size_t *tail_len, uint8_t *etag, size_t *etag_len, uint64_t *ticket) {
+    if (!shards || id <= 0) return -1;
+    shard_t *sh = shard_of(id);
+    pthread_mutex_lock(&sh->lock);
+
+    int32_t idx = find(sh, id);
+    if (idx != NIL && sh->entries[idx].ready) {
+        entry_t *e = &sh->entries[idx];
+        memcpy(tail, e->tail, e->len);
+        *tail_len = e->len;
+        memcpy(etag, e->etag, e->etag_len);
+        *etag_len = e->etag_len;
+        lru_unlink(sh, idx);
+        lru_push_front(sh, idx);
+        sh->hits++;
+        pthread_mutex_unlock(&sh->lock);
+        return 0;
+    }
+
+    sh->misses++;
+    if (idx == NIL) {
+        // Reservar el lugar; si no hay, se descarta la menos usada
+        if (sh->free_head == NIL) remove_entry(sh, sh->lru_tail);
+        idx = sh->free_head;
+        entry_t *e = &sh->entries[idx];
+        sh->free_head = e->next;
+        e->id = id;
+        e->ready = false;
+        e->ticket = ++sh->next_ticket;
+        int32_t *bucket = bucket_of(sh, id);
+        e->next = *bucket;
+        *bucket = idx;
+        lru_push_front(sh, idx);
+        sh->count++;
+    }
+    *ticket = sh->entries[idx].ticket;
+    pthread_mutex_unlock(&sh->lock);
+    return -1;
+}
+
+void respcache_put(int id, uint64_t ticket, const uint8_t *tail, size_t tail_len,
+                   const uint8_t *etag, size_t etag_len) {
+    if (!shards || tail_len > RESPCACHE_TAIL_MAX || etag_len > RESPCACHE_ETAG_MAX) return;
+    shard_t *sh = shard_of(id);
+    pthread_mutex_lock(&sh->lock);
+    int32_t idx = find(sh, id);
+    if (idx != NIL && !sh->entries[idx].ready && sh->entries[idx].ticket == ticket) {
+        entry_t *e = &sh->entries[idx];
+        memcpy(e->tail, tail, tail_len);
+        e->len = (uint16_t) tail_len;
+        memcpy(e->etag, etag, etag_len);
+        e->etag_len = (uint8_t) etag_len;
+        e->ready = true;
+    }
+    pthread_mutex_unlock(&sh->lock);
+}
+
+void respcache_invalidate(int id) {
+    if (!shards) return;
+    shard_t *sh = shard_of(id);
+    pthread_mutex_lock(&sh->lock);
+    int32_t idx = find(sh, id);
+    if (idx != NIL) {
+        remove_entry(sh, idx);
+        sh->invalidations++;
+    }
+    pthread_mutex_unlock(&sh->lock);
+}
+
+void respcache_get_stats(respcache_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    if (!shards) return;
+    for (size_t s = 0; s < RESPCACHE_SHARDS; s++) {
+        pthread_mutex_lock(&shards[s].lock);
+        st->hits += shards[s].hits;
+        st->misses += shards[s].misses;
+        st->invalidations += shards[s].invalidations;
+        st->entries += shards[s].count;
+        pthread_mutex_unlock(&shards[s].lock);
+    }
+}
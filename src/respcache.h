@@ -0,0 +1,41 @@
+#ifndef RESPCACHE_H
+#define RESPCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Caché LRU de respuestas GET data/<id> ya serializadas. Se guarda lo que va después
+// del token (opciones y payload), que no depende del pedido: un acierto sólo arma la
+// cabecera y copia, sin tocar el almacenamiento ni coap_build.
+// Cada mutación invalida su id. Para que una lectura vieja no pise una invalidación,
+// un fallo deja una reserva y sólo esa reserva se puede completar.
+
+#define RESPCACHE_SHARDS 16
+#define RESPCACHE_CAPACITY 4096      // respuestas en total
+#define RESPCACHE_TAIL_MAX 192       // opciones + payload; respuestas más grandes no se guardan
+#define RESPCACHE_ETAG_MAX 8
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+    size_t entries;
+} respcache_stats_t;
+
+// Reservar la caché
+int respcache_init(void);
+
+// Buscar la respuesta de id. Si está retorna 0 y la copia en tail/etag; si no, retorna -1
+// y ticket identifica la reserva que hay que pasarle a respcache_put
+int respcache_get(int id, uint8_t *tail, size_t *tail_len, uint8_t *etag, size_t *etag_len, uint64_t *ticket);
+
+// Completar la reserva de id (se ignora si una mutación la invalidó mientras tanto)
+void respcache_put(int id, uint64_t ticket, const uint8_t *tail, size_t tail_len,
+                   const uint8_t *etag, size_t etag_len);
+
+// Olvidar la respuesta de id (después de un POST, PUT o DELETE)
+void respcache_invalidate(int id);
+
+void respcache_get_stats(respcache_stats_t *st);
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "ring.h"
+
+// Redondear hacia arriba a la siguiente potencia de 2
+static size_t next_pow2(size_t v) {
+    size_t p = 2;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+int ring_init(ring_t *ring, size_t capacity) {
+    if (!ring || capacity == 0) return -1;
+
+    size_t cap = next_pow2(capacity);
+    ring->cells = malloc(cap * sizeof(ring_cell_t));
+    if (!ring->cells) return -1;
+
+    for (size_t i = 0; i < cap; i++) {
+        atomic_init(&ring->cells[i].seq, i);
+        ring->cells[i].data = NULL;
+    }
+    ring->mask = cap - 1;
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+    return 0;
+}
+
+void ring_destroy(ring_t *ring) {
+    if (!ring) return;
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+bool ring_push(ring_t *ring, void *item) {
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        ring_cell_t *cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+        if (dif == 0) {
+            // La celda está libre: intentar reservarla
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->data = item;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false; // lleno
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+bool ring_pop(ring_t *ring, void **item) {
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        ring_cell_t *cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (dif == 0) {
+            // Hay un elemento publicado: intentar tomarlo
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *item = cell->data;
+                atomic_store_explicit(&cell->seq, pos + ring->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false; // vacío
+        } else {
+            pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+size_t ring_count(ring_t *ring) {
+    size_t head = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    return (head > tail) ? head - tail : 0;
+}
+
+size_t ring_capacity(const ring_t *ring) {
+    return ring->mask + 1;
+}
@@ -0,0 +1,44 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define RING_CACHELINE 64
+
+// Celda del anillo: número de secuencia + puntero al elemento
+typedef struct {
+    atomic_size_t seq;
+    void *data;
+} ring_cell_t;
+
+// Cola acotada MPMC sin locks (esquema de Vyukov).
+// La capacidad siempre es potencia de 2.
+typedef struct {
+    ring_cell_t *cells;
+    size_t mask;
+    _Alignas(RING_CACHELINE) atomic_size_t enqueue_pos;
+    _Alignas(RING_CACHELINE) atomic_size_t dequeue_pos;
+    char pad[RING_CACHELINE - sizeof(atomic_size_t)];
+} ring_t;
+
+// Inicializar el anillo (capacity se redondea a potencia de 2)
+int ring_init(ring_t *ring, size_t capacity);
+
+// Liberar la memoria del anillo
+void ring_destroy(ring_t *ring);
+
+// Encolar un elemento. Retorna false si el anillo está lleno
+bool ring_push(ring_t *ring, void *item);
+
+// Desencolar un elemento. Retorna false si el anillo está vacío
+bool ring_pop(ring_t *ring, void **item);
+
+// Cantidad aproximada de elementos en el anillo
+size_t ring_count(ring_t *ring);
+
+// Capacidad del anillo
+size_t ring_capacity(const ring_t *ring);
+
+#endif
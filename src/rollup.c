@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "rollup.h"
+
+static rollup_bucket_t minutes[ROLLUP_MINUTES];
+static rollup_bucket_t hours[ROLLUP_HOURS];
+static pthread_mutex_t rollup_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Sumar una lectura al bucket que le corresponde dentro de un nivel
+static void bucket_add(rollup_bucket_t *level, size_t slots, time_t width, time_t ts, double value) {
+    time_t start = ts - ts % width;
+    rollup_bucket_t *b = &level[(size_t) (start / width) % slots];
+    // El slot ya tiene una ventana más nueva (el replay del arranque no viene en orden):
+    // la lectura quedó fuera de lo que guarda el nivel
+    if (b->count > 0 && start < b->start) return;
+    if (b->start != start || b->count == 0) {
+        // El slot tenía una ventana vieja (de una vuelta anterior): se reutiliza
+        b->start = start;
+        b->min = b->max = value;
+        b->sum = 0;
+        b->count = 0;
+    }
+    if (value < b->min) b->min = value;
+    if (value > b->max) b->max = value;
+    b->sum += value;
+    b->count++;
+}
+
+// Restar una lectura de su bucket, si el slot todavía tiene esa ventana. min y max no se
+// pueden recalcular sin las lecturas: quedan como cotas hasta que la ventana se vacía
+static void bucket_remove(rollup_bucket_t *level, size_t slots, time_t width, time_t ts, double value) {
+    time_t start = ts - ts % width;
+    rollup_bucket_t *b = &level[(size_t) (start / width) % slots];
+    if (b->count == 0 || b->start != start) return;
+    b->sum -= value;
+    if (--b->count == 0) b->sum = 0;
+}
+
+// Combinar un bucket en el resumen de una ventana
+static void bucket_merge(rollup_bucket_t *dst, const rollup_bucket_t *src) {
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (dst->count == 0 || src->max > dst->max) dst->max = src->max;
+    dst->sum += src->sum;
+    dst->count += src->count;
+}
+
+void rollup_add(time_t ts, double value) {
+    if (ts < 0) return;
+    pthread_mutex_lock(&rollup_mutex);
+    bucket_add(minutes, ROLLUP_MINUTES, 60, ts, value);
+    bucket_add(hours, ROLLUP_HOURS, 3600, ts, value);
+    pthread_mutex_unlock(&rollup_mutex);
+}
+
+void rollup_remove(time_t ts, double value) {
+    if (ts < 0) return;
+    pthread_mutex_lock(&rollup_mutex);
+    bucket_remove(minutes, ROLLUP_MINUTES, 60, ts, value);
+    bucket_remove(hours, ROLLUP_HOURS, 3600, ts, value);
+    pthread_mutex_unlock(&rollup_mutex);
+}
+
+int rollup_parse_agg(const char *name, rollup_agg_t *agg) {
+    static const char *names[] = { "avg", "min", "max", "sum", "count" };
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *agg = (rollup_agg_t) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+long rollup_query(time_t from, time_t to, unsigned step, rollup_bucket_t *out, size_t max) {
+    if (step == 0 || step % 60 != 0 || from < 0 || to <= from) return -1;
+
+    bool by_hour = step % 3600 == 0;
+    rollup_bucket_t *level = by_hour ? hours : minutes;
+    size_t slots = by_hour ? ROLLUP_HOURS : ROLLUP_MINUTES;
+    time_t width = by_hour ? 3600 : 60;
+
+    // Más atrás de una vuelta del nivel no puede quedar nada que valga la pena recorrer
+    time_t first = from - from % (time_t) step;
+    time_t oldest = to - (time_t) slots * width;
+    if (oldest > first) first = oldest - oldest % (time_t) step;
+
+    long n = 0;
+    pthread_mutex_lock(&rollup_mutex);
+    for (time_t w = first; w < to && (size_t) n < max; w += step) {
+        rollup_bucket_t acc = { .start = w };
+        for (time_t t = w; t < w + (time_t) step && t < to; t += width) {
+            const rollup_bucket_t *b = &level[(size_t) (t / width) % slots];
+            if (b->count > 0 && b->start == t) bucket_merge(&acc, b);
+        }
+        if (acc.count > 0) out[n++] = acc;
+    }
+    pthread_mutex_unlock(&rollup_mutex);
+    return n;
+}
+
+double rollup_value(const rollup_bucket_t *bucket, rollup_agg_t agg) {
+    switch (agg) {
+        case ROLLUP_MIN:   return bucket->min;
+        case ROLLUP_MAX:   return bucket->max;
+        case ROLLUP_SUM:   return bucket->sum;
+        case ROLLUP_COUNT: return (double) bucket->count;
+        case ROLLUP_AVG:
+        default:           return bucket->count ? bucket->sum / bucket->count : 0.0;
+    }
+}
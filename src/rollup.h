@@ -0,0 +1,51 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Agregados precalculados de las lecturas numéricas, por minuto y por hora.
+// Se actualizan en cada mutación, así una consulta de rango cuesta O(buckets)
+// y no O(lecturas). Cada nivel es un arreglo circular indexado por el tiempo
+
+#define ROLLUP_MINUTES (7 * 24 * 60)   // una semana de buckets por minuto
+#define ROLLUP_HOURS (366 * 24)        // un año de buckets por hora
+
+typedef enum {
+    ROLLUP_AVG,
+    ROLLUP_MIN,
+    ROLLUP_MAX,
+    ROLLUP_SUM,
+    ROLLUP_COUNT,
+} rollup_agg_t;
+
+// Resumen de una ventana de tiempo
+typedef struct {
+    time_t start;
+    double min;
+    double max;
+    double sum;
+    uint64_t count;
+} rollup_bucket_t;
+
+// Sumar una lectura a sus buckets de minuto y de hora. Se descarta si el slot ya tiene
+// una ventana posterior, así el orden en que se cargan las lecturas no importa
+void rollup_add(time_t ts, double value);
+
+// Restar una lectura que se actualizó o se borró (sum y count; min y max no bajan)
+void rollup_remove(time_t ts, double value);
+
+// Interpretar el nombre de un agregado (avg, min, max, sum, count)
+int rollup_parse_agg(const char *name, rollup_agg_t *agg);
+
+// Resumir [from, to) en ventanas de step segundos (múltiplo de 60) alineadas a step.
+// Usa buckets por hora si step es múltiplo de 3600. Sólo devuelve ventanas con datos, y a lo
+// sumo max: el resto se pide con from = inicio de la última + step. No recorre más de una
+// vuelta del nivel hacia atrás desde to. Retorna la cantidad de ventanas, o -1 si step no es válido
+long rollup_query(time_t from, time_t to, unsigned step, rollup_bucket_t *out, size_t max);
+
+// Valor del agregado pedido para una ventana
+double rollup_value(const rollup_bucket_t *bucket, rollup_agg_t agg);
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "separate.h"
+#include "coap_packet.h"
+#include "netio.h"
+#include "timer.h"
+#include "log.h"
+
+#define BUCKETS 8192
+#define NIL (-1)
+
+typedef struct {
+    struct sockaddr_in peer;
+    uint16_t mid;
+    uint16_t len;
+    uint8_t attempts;            // retransmisiones hechas
+    uint32_t timeout_ms;         // espera actual (se duplica en cada retransmisión)
+    uint64_t due_ms;
+    int32_t next;                // cadena del bucket (o lista libre)
+    int32_t wheel_prev, wheel_next;
+    size_t slot;
+    uint8_t msg[SEPARATE_MSG_MAX];
+} pending_t;
+
+static pthread_mutex_t separate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pending_t *entries = NULL;
+static int32_t buckets[BUCKETS];
+static int32_t free_head = NIL;
+static int32_t wheel[SEPARATE_WHEEL_SLOTS];
+static uint64_t wheel_tick = 0;  // último slot ya procesado
+static uint16_t next_mid;
+static uint64_t rng;
+static int out_sock = -1;
+static separate_stats_t stats;
+
+static size_t bucket_of(const struct sockaddr_in *peer, uint16_t mid) {
+    uint64_t k = ((uint64_t) peer->sin_addr.s_addr << 32) | ((uint64_t) peer->sin_port << 16) | mid;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t) (k % BUCKETS);
+}
+
+int separate_init(void) {
+    if (entries) return 0;
+    entries = calloc(SEPARATE_MAX_PENDING, sizeof(pending_t));
+    if (!entries) return -1;
+    for (int32_t i = 0; i < SEPARATE_MAX_PENDING; i++) entries[i].next = (i + 1 < SEPARATE_MAX_PENDING) ? i + 1 : NIL;
+    free_head = 0;
+    for (size_t i = 0; i < BUCKETS; i++) buckets[i] = NIL;
+    for (size_t i = 0; i < SEPARATE_WHEEL_SLOTS; i++) wheel[i] = NIL;
+    uint64_t now = timer_now_ms();
+    wheel_tick = now / SEPARATE_TICK_MS;
+    // Distinto del generador de Observe para no repetir MIDs hacia el mismo cliente
+    next_mid = (uint16_t) (now >> 3) ^ 0x8000;
+    rng = now | 1;
+    return 0;
+}
+
+void separate_set_socket(int sock) {
+    pthread_mutex_lock(&separate_mutex);
+    if (out_sock < 0) out_sock = sock;
+    pthread_mutex_unlock(&separate_mutex);
+}
+
+static int send_raw(const struct sockaddr_in *peer, const uint8_t *msg, size_t len) {
+    struct iovec iov = { .iov_base = (void*) msg, .iov_len = len };
+    return netio_sendv(out_sock, peer, &iov, 1) < 0 ? -1 : 0;
+}
+
+// Poner la entrada en el slot de la rueda de su vencimiento (con el lock tomado)
+static void wheel_insert(int32_t idx) {
+    pending_t *p = &entries[idx];
+    p->slot = (size_t) ((p->due_ms / SEPARATE_TICK_MS) % SEPARATE_WHEEL_SLOTS);
+    p->wheel_prev = NIL;
+    p->wheel_next = wheel[p->slot];
+    if (p->wheel_next != NIL) entries[p->wheel_next].wheel_prev = idx;
+    wheel[p->slot] = idx;
+}
+
+static void wheel_remove(int32_t idx) {
+    pending_t *p = &entries[idx];
+    if (p->wheel_prev != NIL) entries[p->wheel_prev].wheel_next = p->wheel_next;
+    else wheel[p->slot] = p->wheel_next;
+    if (p->wheel_next != NIL) entries[p->wheel_next].wheel_prev = p->wheel_prev;
+}
+
+// Sacar la entrada de la tabla y de la rueda y devolverla a la lista libre
+static void release(int32_t idx) {
+    pending_t *p = &entries[idx];
+    int32_t *link = &buckets[bucket_of(&p->peer, p->mid)];
+    while (*link != NIL && *link != idx) link = &entries[*link].next;
+    if (*link == idx) *link = p->next;
+    wheel_remove(idx);
+    p->next = free_head;
+    free_head = idx;
+    stats.pending--;
+}
+
+int separate_ack(const struct sockaddr_in *peer, uint16_t mid, uint8_t out[4]) {
+    out[0] = (uint8_t) ((1 << 6) | (COAP_TYPE_ACK << 4));
+    out[1] = COAP_CODE_EMPTY;
+    out[2] = (uint8_t) (mid >> 8);
+    out[3] = (uint8_t) (mid & 0xFF);
+    pthread_mutex_lock(&separate_mutex);
+    int sock = out_sock;
+    pthread_mutex_unlock(&separate_mutex);
+    if (sock < 0) return -1;
+    struct iovec iov = { .iov_base = out, .iov_len = 4 };
+    return netio_sendv(sock, peer, &iov, 1) < 0 ? -1 : 0;
+}
+
+// Enviar msg (CON, con el MID en los bytes 2 y 3) y anotarlo para retransmitirlo (con el lock tomado)
+static int track_and_send(const struct sockaddr_in *peer, const uint8_t *msg, size_t len) {
+    uint16_t mid = (uint16_t) ((msg[2] << 8) | msg[3]);
+    if (free_head == NIL) {
+        stats.untracked++;
+        return send_raw(peer, msg, len);
+    }
+
+    int32_t idx = free_head;
+    pending_t *p = &entries[idx];
+    free_head = p->next;
+    stats.pending++;
+    p->peer = *peer;
+    p->mid = mid;
+    p->len = (uint16_t) len;
+    memcpy(p->msg, msg, len);
+    p->attempts = 0;
+    // Espera inicial al azar entre ACK_TIMEOUT y ACK_TIMEOUT * ACK_RANDOM_FACTOR
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    p->timeout_ms = COAP_ACK_TIMEOUT_MS + (uint32_t) (rng % (uint64_t) (COAP_ACK_TIMEOUT_MS * (COAP_ACK_RANDOM_FACTOR - 1)));
+    p->due_ms = timer_now_ms() + p->timeout_ms;
+    size_t b = bucket_of(peer, mid);
+    p->next = buckets[b];
+    buckets[b] = idx;
+    wheel_insert(idx);
+    return send_raw(peer, p->msg, len);
+}
+
+int separate_send(const struct sockaddr_in *peer, const struct iovec *iov, size_t iovcnt) {
+    uint8_t msg[SEPARATE_MSG_MAX];
+    size_t len = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (len + iov[i].iov_len > sizeof(msg)) return -1;
+        memcpy(msg + len, iov[i].iov_base, iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+    if (len < 4) return -1;
+
+    pthread_mutex_lock(&separate_mutex);
+    if (out_sock < 0) {
+        pthread_mutex_unlock(&separate_mutex);
+        return -1;
+    }
+    // Misma respuesta, pero como CON con un MID propio
+    uint16_t mid = next_mid++;
+    msg[0] = (uint8_t) ((msg[0] & 0xCF) | (COAP_TYPE_CON << 4));
+    msg[2] = (uint8_t) (mid >> 8);
+    msg[3] = (uint8_t) (mid & 0xFF);
+    stats.deferred++;
+    int res = track_and_send(peer, msg, len);
+    pthread_mutex_unlock(&separate_mutex);
+    return res;
+}
+
+int separate_send_con(const struct sockaddr_in *peer, const uint8_t *msg, size_t len) {
+    if (!entries || len < 4 || len > SEPARATE_MSG_MAX) return -1;
+    pthread_mutex_lock(&separate_mutex);
+    int res = out_sock < 0 ? -1 : track_and_send(peer, msg, len);
+    pthread_mutex_unlock(&separate_mutex);
+    return res;
+}
+
+bool separate_reply(const struct sockaddr_in *peer, uint16_t mid, bool reset) {
+    if (!entries) return false;
+    pthread_mutex_lock(&separate_mutex);
+    for (int32_t i = buckets[bucket_of(peer, mid)]; i != NIL; i = entries[i].next) {
+        pending_t *p = &entries[i];
+        if (p->mid == mid && p->peer.sin_addr.s_addr == peer->sin_addr.s_addr && p->peer.sin_port == peer->sin_port) {
+            if (reset) stats.reset++;
+            else stats.acked++;
+            release(i);
+            pthread_mutex_unlock(&separate_mutex);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&separate_mutex);
+    return false;
+}
+
+void separate_tick(void *ctx) {
+    (void) ctx;
+    if (!entries) return;
+    uint64_t now = timer_now_ms();
+    // Sólo los slots ya terminados: todas sus entradas vencieron
+    uint64_t tick = now / SEPARATE_TICK_MS - 1;
+
+    pthread_mutex_lock(&separate_mutex);
+    if (tick <= wheel_tick) {
+        pthread_mutex_unlock(&separate_mutex);
+        return;
+    }
+    uint64_t steps = tick - wheel_tick;
+    if (steps > SEPARATE_WHEEL_SLOTS) steps = SEPARATE_WHEEL_SLOTS;
+    for (uint64_t s = 1; s <= steps; s++) {
+        size_t slot = (size_t) ((wheel_tick + s) % SEPARATE_WHEEL_SLOTS);
+        int32_t idx = wheel[slot];
+        while (idx != NIL) {
+            pending_t *p = &entries[idx];
+            int32_t next = p->wheel_next;
+            if (p->due_ms <= now) {
+                if (p->attempts >= COAP_MAX_RETRANSMIT) {
+                    stats.expired++;
+                    release(idx);
+                } else {
+                    p->attempts++;
+                    p->timeout_ms *= 2;
+                    p->due_ms = now + p->timeout_ms;
+                    wheel_remove(idx);
+                    wheel_insert(idx);
+                    stats.retransmissions++;
+                    if (send_raw(&p->peer, p->msg, p->len) != 0) {
+                        log_text("[WARNING] No se pudo retransmitir la respuesta separada MID=0x%04X", p->mid);
+                    }
+                }
+            }
+            idx = next;
+        }
+    }
+    wheel_tick = tick;
+    pthread_mutex_unlock(&separate_mutex);
+}
+
+void separate_get_stats(separate_stats_t *st) {
+    pthread_mutex_lock(&separate_mutex);
+    *st = stats;
+    pthread_mutex_unlock(&separate_mutex);
+}
@@ -0,0 +1,59 @@
+#ifndef SEPARATE_H
+#define SEPARATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+// Respuestas separadas (RFC 7252 §5.2.2): el pedido CON se confirma enseguida con un ACK
+// vacío y el resultado sale después como una CON propia con el token original. Esas CON
+// se retransmiten con espera exponencial (ACK_TIMEOUT, ACK_RANDOM_FACTOR, MAX_RETRANSMIT)
+// desde una rueda de tiempo de slots de SEPARATE_TICK_MS hasta que llega el ACK o un RST.
+// La misma rueda retransmite las notificaciones CON de Observe.
+
+#define SEPARATE_MAX_PENDING 4096    // respuestas esperando ACK; si no hay lugar salen sin retransmisión
+#define SEPARATE_MSG_MAX 640         // alcanza para una notificación de Observe entera
+#define SEPARATE_TICK_MS 100
+#define SEPARATE_WHEEL_SLOTS 512     // 51.2 s, más que la espera más larga (3 s * 2^4)
+#define COAP_ACK_TIMEOUT_MS 2000
+#define COAP_ACK_RANDOM_FACTOR 1.5
+#define COAP_MAX_RETRANSMIT 4
+
+typedef struct {
+    uint64_t deferred;               // respuestas enviadas como separadas
+    uint64_t retransmissions;
+    uint64_t acked;
+    uint64_t reset;
+    uint64_t expired;                // sin ACK después de MAX_RETRANSMIT
+    uint64_t untracked;              // sin lugar en la tabla: enviadas una sola vez
+    size_t pending;
+} separate_stats_t;
+
+// Reservar la tabla (una sola vez, antes de atender pedidos)
+int separate_init(void);
+
+// Socket desde el que salen los ACK vacíos y las respuestas (se usa el primero que se registra)
+void separate_set_socket(int sock);
+
+// Confirmar ya el pedido CON mid de peer con un ACK vacío. out recibe los 4 bytes enviados
+// (para la caché de intercambios). Retorna 0, o -1 si no hay socket o falló el envío
+int separate_ack(const struct sockaddr_in *peer, uint16_t mid, uint8_t out[4]);
+
+// Enviar la respuesta ya serializada como CON con un MID nuevo y retransmitirla hasta el ACK
+int separate_send(const struct sockaddr_in *peer, const struct iovec *iov, size_t iovcnt);
+
+// Retransmitir un mensaje CON ya armado, con su propio MID (notificaciones de Observe), igual
+// que una respuesta separada. Retorna 0, o -1 si no hay socket o falló el primer envío
+int separate_send_con(const struct sockaddr_in *peer, const uint8_t *msg, size_t len);
+
+// ACK o RST de un cliente. Retorna true si correspondía a una CON que se estaba retransmitiendo
+bool separate_reply(const struct sockaddr_in *peer, uint16_t mid, bool reset);
+
+// Retransmitir lo que venció (temporizador cada SEPARATE_TICK_MS)
+void separate_tick(void *ctx);
+
+void separate_get_stats(separate_stats_t *st);
+
+#endif
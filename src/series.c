@@ -0,0 +1,504 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "series.h"
+
+#define SERIES_MAGIC 0x53455247u   // "GRES"
+#define MAX_POINT_BITS 151          // peor caso de un punto codificado
+
+// Cabecera de cada segmento, tal cual se guarda en disco seguida de los datos.
+// checksum cubre la cabecera hasta bits y los datos (no los borrados, que se reescriben en su lugar)
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    int32_t first_id;
+    int32_t last_id;
+    int64_t first_ts;
+    int64_t last_ts;
+    double min;
+    double max;
+    uint32_t bits;
+    uint32_t checksum;
+    uint8_t deleted[SERIES_POINTS / 8];
+} segment_header_t;
+
+typedef struct {
+    segment_header_t h;
+    uint8_t *data;
+    off_t offset;           // posición en el archivo (-1 mientras es el segmento activo)
+    bool dirty;             // borrados todavía no escritos
+} segment_t;
+
+// Estado compartido por el codificador y el decodificador
+typedef struct {
+    int prev_id;
+    int64_t prev_ts;
+    int64_t prev_delta;
+    uint64_t prev_bits;
+    int prev_decimals;
+    int lead, trail;        // ventana del último XOR (lead = -1 si no hay)
+} codec_t;
+
+// Recorrido secuencial de un segmento
+typedef struct {
+    const segment_t *seg;
+    size_t pos;
+    uint32_t index;
+    codec_t c;
+} cursor_t;
+
+static int series_fd = -1;
+static off_t file_size = 0;
+static segment_t *segments = NULL;
+static size_t segment_count = 0, segment_cap = 0;
+static bool has_active = false;     // el último segmento sigue abierto
+static codec_t active_codec;
+static size_t point_count = 0;
+static size_t data_bytes = 0;
+
+static uint64_t double_bits(double v) {
+    uint64_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+static double bits_double(uint64_t b) {
+    double v;
+    memcpy(&v, &b, sizeof(v));
+    return v;
+}
+
+// Escribir los n bits bajos de v, del más significativo al menos significativo
+static void put_bits(segment_t *s, uint64_t v, int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if ((v >> i) & 1) s->data[s->h.bits >> 3] |= (uint8_t) (0x80 >> (s->h.bits & 7));
+        s->h.bits++;
+    }
+}
+
+static uint64_t get_bits(const uint8_t *data, size_t *pos, int n) {
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++) {
+        v = (v << 1) | ((data[*pos >> 3] >> (7 - (*pos & 7))) & 1);
+        (*pos)++;
+    }
+    return v;
+}
+
+static uint32_t segment_checksum(const segment_t *s) {
+    // FNV-1a sobre la cabecera (sin checksum ni borrados) y los datos
+    uint32_t hash = 2166136261u;
+    const uint8_t *p = (const uint8_t*) &s->h;
+    for (size_t i = 0; i < offsetof(segment_header_t, checksum); i++) hash = (hash ^ p[i]) * 16777619u;
+    for (size_t i = 0; i < (s->h.bits + 7) / 8; i++) hash = (hash ^ s->data[i]) * 16777619u;
+    return hash;
+}
+
+static bool is_deleted(const segment_t *s, uint32_t index) {
+    return (s->h.deleted[index >> 3] >> (index & 7)) & 1;
+}
+
+// Decodificar el siguiente punto del segmento
+static void cursor_next(cursor_t *cur, int *id, time_t *ts, double *value, int *decimals) {
+    const uint8_t *d = cur->seg->data;
+    codec_t *c = &cur->c;
+
+    if (cur->index == 0) {
+        c->prev_id = cur->seg->h.first_id;
+        c->prev_ts = cur->seg->h.first_ts;
+        c->prev_delta = 0;
+        c->prev_bits = get_bits(d, &cur->pos, 64);
+        c->prev_decimals = (int) get_bits(d, &cur->pos, 4);
+        c->lead = -1;
+    } else {
+        c->prev_id += get_bits(d, &cur->pos, 1) ? (int) get_bits(d, &cur->pos, 32) : 1;
+
+        int64_t dod;
+        if (get_bits(d, &cur->pos, 1) == 0) {
+            dod = 0;
+        } else if (get_bits(d, &cur->pos, 1) == 0) {
+            dod = (int64_t) get_bits(d, &cur->pos, 7) - 63;
+        } else if (get_bits(d, &cur->pos, 1) == 0) {
+            dod = (int64_t) get_bits(d, &cur->pos, 9) - 255;
+        } else if (get_bits(d, &cur->pos, 1) == 0) {
+            dod = (int64_t) get_bits(d, &cur->pos, 12) - 2047;
+        } else {
+            dod = (int32_t) (uint32_t) get_bits(d, &cur->pos, 32);
+        }
+        c->prev_delta += dod;
+        c->prev_ts += c->prev_delta;
+
+        if (get_bits(d, &cur->pos, 1)) {
+            if (get_bits(d, &cur->pos, 1)) {
+                c->lead = (int) get_bits(d, &cur->pos, 5);
+                int sig = (int) get_bits(d, &cur->pos, 6) + 1;
+                c->trail = 64 - c->lead - sig;
+            }
+            int sig = 64 - c->lead - c->trail;
+            c->prev_bits ^= get_bits(d, &cur->pos, sig) << c->trail;
+        }
+        if (get_bits(d, &cur->pos, 1)) c->prev_decimals = (int) get_bits(d, &cur->pos, 4);
+    }
+    cur->index++;
+    *id = c->prev_id;
+    *ts = (time_t) c->prev_ts;
+    *value = bits_double(c->prev_bits);
+    *decimals = c->prev_decimals;
+}
+
+// Segmento cuyo rango de ids contiene id (o NULL)
+static segment_t *find_segment(int id) {
+    size_t lo = 0, hi = segment_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (segments[mid].h.last_id < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == segment_count || segments[lo].h.first_id > id) return NULL;
+    return &segments[lo];
+}
+
+// Ubicar un id dentro de su segmento. Retorna el índice del punto o -1
+static long find_point(int id, segment_t **seg, time_t *ts, double *value, int *decimals) {
+    segment_t *s = find_segment(id);
+    if (!s) return -1;
+
+    cursor_t cur = { .seg = s };
+    while (cur.index < s->h.count) {
+        int pid;
+        time_t pts;
+        double pv;
+        int pd;
+        cursor_next(&cur, &pid, &pts, &pv, &pd);
+        if (pid == id) {
+            *seg = s;
+            if (ts) *ts = pts;
+            if (value) *value = pv;
+            if (decimals) *decimals = pd;
+            return (long) cur.index - 1;
+        }
+        if (pid > id) break;
+    }
+    return -1;
+}
+
+// Escribir el segmento activo al final del archivo y liberar su espacio sobrante
+static int seal_active(void) {
+    if (!has_active) return 0;
+    segment_t *s = &segments[segment_count - 1];
+    has_active = false;
+    if (s->h.count == 0) {
+        free(s->data);
+        segment_count--;
+        return 0;
+    }
+
+    size_t len = (s->h.bits + 7) / 8;
+    uint8_t *shrunk = realloc(s->data, len);
+    if (shrunk) s->data = shrunk;
+    s->h.checksum = segment_checksum(s);
+
+    if (pwrite(series_fd, &s->h, sizeof(s->h), file_size) != (ssize_t) sizeof(s->h)) return -1;
+    if (pwrite(series_fd, s->data, len, file_size + (off_t) sizeof(s->h)) != (ssize_t) len) return -1;
+    s->offset = file_size;
+    s->dirty = false;
+    file_size += (off_t) (sizeof(s->h) + len);
+    return 0;
+}
+
+static segment_t *new_segment(void) {
+    if (segment_count == segment_cap) {
+        size_t cap = segment_cap ? segment_cap * 2 : 64;
+        segment_t *grown = realloc(segments, cap * sizeof(segment_t));
+        if (!grown) return NULL;
+        segments = grown;
+        segment_cap = cap;
+    }
+    segment_t *s = &segments[segment_count];
+    memset(s, 0, sizeof(*s));
+    s->data = calloc(1, SERIES_SEGMENT_BYTES);
+    if (!s->data) return NULL;
+    s->h.magic = SERIES_MAGIC;
+    s->offset = -1;
+    segment_count++;
+    has_active = true;
+    return s;
+}
+
+int series_open(const char *path) {
+    series_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (series_fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(series_fd, &st) != 0) return -1;
+
+    off_t off = 0;
+    while (off + (off_t) sizeof(segment_header_t) <= st.st_size) {
+        segment_header_t h;
+        if (pread(series_fd, &h, sizeof(h), off) != (ssize_t) sizeof(h)) break;
+        size_t len = (h.bits + 7) / 8;
+        if (h.magic != SERIES_MAGIC || h.count == 0 || h.count > SERIES_POINTS || len > SERIES_SEGMENT_BYTES) break;
+        if (off + (off_t) (sizeof(h) + len) > st.st_size) break;
+
+        segment_t *s = new_segment();
+        if (!s) return -1;
+        has_active = false;
+        s->h = h;
+        if (pread(series_fd, s->data, len, off + (off_t) sizeof(h)) != (ssize_t) len ||
+            segment_checksum(s) != h.checksum) {
+            // Segmento cortado por una caída: sus puntos siguen en el WAL
+            free(s->data);
+            segment_count--;
+            break;
+        }
+        s->offset = off;
+        point_count += h.count;
+        data_bytes += len;
+        off += (off_t) (sizeof(h) + len);
+    }
+
+    // Descartar la cola dañada para que los próximos segmentos queden legibles
+    if (off < st.st_size && ftruncate(series_fd, off) != 0) return -1;
+    file_size = off;
+    return 0;
+}
+
+bool series_parse_value(const char *text, double *value, int *decimals) {
+    if (!text || !*text || strlen(text) >= 32) return false;
+    char *end;
+    double v = strtod(text, &end);
+    if (*end != '\0' || !isfinite(v)) return false;
+
+    // Sólo si se puede reconstruir el mismo texto (así GET devuelve lo que se guardó):
+    // primero con decimales fijos ("20.0", "23.45") y si no con la forma más corta
+    char canon[64];
+    const char *dot = strchr(text, '.');
+    int fixed = dot ? (int) strlen(dot + 1) : 0;
+    if (fixed < SERIES_SHORTEST && strspn(text, "-0123456789.") == strlen(text)) {
+        series_format_value(v, fixed, canon, sizeof(canon));
+        if (strcmp(canon, text) == 0) {
+            *value = v;
+            *decimals = fixed;
+            return true;
+        }
+    }
+    series_format_value(v, SERIES_SHORTEST, canon, sizeof(canon));
+    if (strcmp(canon, text) != 0) return false;
+    *value = v;
+    *decimals = SERIES_SHORTEST;
+    return true;
+}
+
+void series_format_value(double value, int decimals, char *out, size_t max) {
+    if (decimals < SERIES_SHORTEST) {
+        snprintf(out, max, "%.*f", decimals, value);
+        return;
+    }
+    for (int precision = 1; precision <= 17; precision++) {
+        snprintf(out, max, "%.*g", precision, value);
+        if (strtod(out, NULL) == value) return;
+    }
+}
+
+// Codificar un punto en el segmento activo. Retorna -1 si no entra (hay que sellar)
+static int encode_point(segment_t *s, int id, int64_t ts, uint64_t bits, int decimals) {
+    codec_t *c = &active_codec;
+    if (s->h.count == 0) {
+        s->h.first_id = id;
+        s->h.first_ts = ts;
+        put_bits(s, bits, 64);
+        put_bits(s, (uint64_t) decimals, 4);
+        c->prev_id = id;
+        c->prev_ts = ts;
+        c->prev_delta = 0;
+        c->prev_bits = bits;
+        c->prev_decimals = decimals;
+        c->lead = -1;
+        return 0;
+    }
+
+    int64_t delta = ts - c->prev_ts;
+    int64_t dod = delta - c->prev_delta;
+    if (s->h.count >= SERIES_POINTS || s->h.bits + MAX_POINT_BITS > SERIES_SEGMENT_BYTES * 8 ||
+        dod < INT32_MIN || dod > INT32_MAX) return -1;
+
+    int id_delta = id - c->prev_id;
+    if (id_delta == 1) {
+        put_bits(s, 0, 1);
+    } else {
+        put_bits(s, 1, 1);
+        put_bits(s, (uint32_t) id_delta, 32);
+    }
+
+    if (dod == 0) {
+        put_bits(s, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        put_bits(s, 2, 2);
+        put_bits(s, (uint64_t) (dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        put_bits(s, 6, 3);
+        put_bits(s, (uint64_t) (dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        put_bits(s, 14, 4);
+        put_bits(s, (uint64_t) (dod + 2047), 12);
+    } else {
+        put_bits(s, 15, 4);
+        put_bits(s, (uint32_t) (int32_t) dod, 32);
+    }
+
+    uint64_t x = bits ^ c->prev_bits;
+    if (x == 0) {
+        put_bits(s, 0, 1);
+    } else {
+        int lead = __builtin_clzll(x), trail = __builtin_ctzll(x);
+        if (lead > 31) lead = 31;
+        if (c->lead >= 0 && lead >= c->lead && trail >= c->trail) {
+            // Los bits significativos caben en la ventana anterior
+            put_bits(s, 2, 2);
+            put_bits(s, x >> c->trail, 64 - c->lead - c->trail);
+        } else {
+            int sig = 64 - lead - trail;
+            put_bits(s, 3, 2);
+            put_bits(s, (uint64_t) lead, 5);
+            put_bits(s, (uint64_t) (sig - 1), 6);
+            put_bits(s, x >> trail, sig);
+            c->lead = lead;
+            c->trail = trail;
+        }
+    }
+
+    if (decimals == c->prev_decimals) {
+        put_bits(s, 0, 1);
+    } else {
+        put_bits(s, 1, 1);
+        put_bits(s, (uint64_t) decimals, 4);
+    }
+
+    c->prev_id = id;
+    c->prev_delta = delta;
+    c->prev_ts = ts;
+    c->prev_bits = bits;
+    c->prev_decimals = decimals;
+    return 0;
+}
+
+int series_append(int id, time_t ts, double value, int decimals) {
+    if (series_fd < 0 || id <= series_last_id() || decimals < 0 || decimals > SERIES_SHORTEST) return -1;
+
+    segment_t *s = has_active ? &segments[segment_count - 1] : new_segment();
+    if (!s) return -1;
+    uint32_t bits_before = s->h.bits;
+    uint64_t bits = double_bits(value);
+
+    if (encode_point(s, id, (int64_t) ts, bits, decimals) != 0) {
+        if (seal_active() != 0) return -1;
+        s = new_segment();
+        if (!s) return -1;
+        bits_before = 0;
+        encode_point(s, id, (int64_t) ts, bits, decimals);
+    }
+
+    if (s->h.count == 0 || value < s->h.min) s->h.min = value;
+    if (s->h.count == 0 || value > s->h.max) s->h.max = value;
+    s->h.count++;
+    s->h.last_id = id;
+    s->h.last_ts = (int64_t) ts;
+    point_count++;
+    data_bytes += (s->h.bits + 7) / 8 - (bits_before + 7) / 8;
+    return 0;
+}
+
+int series_get(int id, time_t *ts, double *value, int *decimals) {
+    segment_t *s;
+    long index = find_point(id, &s, ts, value, decimals);
+    if (index < 0 || is_deleted(s, (uint32_t) index)) return -2;
+    return 0;
+}
+
+bool series_contains(int id) {
+    segment_t *s;
+    return find_point(id, &s, NULL, NULL, NULL) >= 0;
+}
+
+int series_delete(int id) {
+    segment_t *s;
+    long index = find_point(id, &s, NULL, NULL, NULL);
+    if (index < 0 || is_deleted(s, (uint32_t) index)) return -2;
+    s->h.deleted[index >> 3] |= (uint8_t) (1 << (index & 7));
+    if (s->offset >= 0) s->dirty = true;
+    return 0;
+}
+
+void series_foreach(series_point_cb cb, void *ctx) {
+    for (size_t i = 0; i < segment_count; i++) {
+        cursor_t cur = { .seg = &segments[i] };
+        while (cur.index < segments[i].h.count) {
+            int id, decimals;
+            time_t ts;
+            double value;
+            cursor_next(&cur, &id, &ts, &value, &decimals);
+            if (!is_deleted(&segments[i], cur.index - 1)) cb(id, ts, value, decimals, ctx);
+        }
+    }
+}
+
+size_t series_scan(int after_id, size_t max, series_point_cb cb, void *ctx) {
+    // Primer segmento que puede tener ids mayores a after_id
+    size_t lo = 0, hi = segment_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (segments[mid].h.last_id <= after_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t visited = 0;
+    for (size_t i = lo; i < segment_count && visited < max; i++) {
+        cursor_t cur = { .seg = &segments[i] };
+        while (cur.index < segments[i].h.count && visited < max) {
+            int id, decimals;
+            time_t ts;
+            double value;
+            cursor_next(&cur, &id, &ts, &value, &decimals);
+            if (id <= after_id || is_deleted(&segments[i], cur.index - 1)) continue;
+            cb(id, ts, value, decimals, ctx);
+            visited++;
+        }
+    }
+    return visited;
+}
+
+int series_last_id(void) {
+    return segment_count ? segments[segment_count - 1].h.last_id : 0;
+}
+
+int series_flush(void) {
+    if (series_fd < 0) return 0;
+    if (seal_active() != 0) return -1;
+
+    for (size_t i = 0; i < segment_count; i++) {
+        segment_t *s = &segments[i];
+        if (!s->dirty) continue;
+        off_t pos = s->offset + (off_t) offsetof(segment_header_t, deleted);
+        if (pwrite(series_fd, s->h.deleted, sizeof(s->h.deleted), pos) != (ssize_t) sizeof(s->h.deleted)) return -1;
+        s->dirty = false;
+    }
+    return fdatasync(series_fd);
+}
+
+void series_get_stats(series_stats_t *stats) {
+    stats->segments = segment_count;
+    stats->points = point_count;
+    stats->bytes = segment_count * sizeof(segment_header_t) + data_bytes;
+}
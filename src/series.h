@@ -0,0 +1,64 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Almacenamiento columnar de lecturas numéricas (estilo Gorilla).
+// Los puntos se agrupan en segmentos de tamaño fijo (hasta SERIES_POINTS puntos o
+// SERIES_SEGMENT_BYTES comprimidos) con una cabecera de min/max/cantidad:
+// ids como delta, timestamps como delta-de-delta y valores como XOR con el anterior.
+// No tiene lock propio: el llamador sincroniza (el lock del almacenamiento)
+
+#define SERIES_POINTS 1024
+#define SERIES_SEGMENT_BYTES 4096
+#define SERIES_SHORTEST 15          // decimales: representación más corta con %g
+
+// Abrir (o crear) el archivo de segmentos y cargar los ya sellados
+int series_open(const char *path);
+
+// true si el texto es un número que se puede guardar comprimido y volver a
+// formatear exactamente igual (si no, va por el camino de strings).
+// decimals guarda cómo se escribió: 0..14 decimales fijos o SERIES_SHORTEST
+bool series_parse_value(const char *text, double *value, int *decimals);
+
+// Formatear un valor tal como se recibió
+void series_format_value(double value, int decimals, char *out, size_t max);
+
+// Agregar una lectura. Los ids deben ser crecientes
+int series_append(int id, time_t ts, double value, int decimals);
+
+// Buscar una lectura viva. Retorna -2 si no existe o fue borrada
+int series_get(int id, time_t *ts, double *value, int *decimals);
+
+// true si el id está en algún segmento, aunque esté borrado
+bool series_contains(int id);
+
+// Marcar una lectura como borrada. Retorna -2 si no existe
+int series_delete(int id);
+
+// Recorrer las lecturas vivas en orden de id
+typedef void (*series_point_cb)(int id, time_t ts, double value, int decimals, void *ctx);
+void series_foreach(series_point_cb cb, void *ctx);
+
+// Recorrer hasta max lecturas vivas con id > after_id, en orden. Retorna cuántas visitó
+size_t series_scan(int after_id, size_t max, series_point_cb cb, void *ctx);
+
+// Mayor id guardado (0 si no hay)
+int series_last_id(void);
+
+// Sellar el segmento activo y escribir los borrados pendientes, con fdatasync.
+// Después de esto los puntos no dependen del WAL
+int series_flush(void);
+
+typedef struct {
+    size_t segments;
+    size_t points;
+    size_t bytes;            // cabeceras + datos comprimidos en memoria
+} series_stats_t;
+
+void series_get_stats(series_stats_t *stats);
+
+#endif
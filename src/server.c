@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,91 +9,476 @@
 #include <time.h>
 #include <errno.h>
 #include <signal.h>
+#include <stdatomic.h>
 
 #include "storage.h"
 #include "coap_packet.h"
 #include "log.h"
+#include "ring.h"
+#include "pool.h"
+#include "netio.h"
+#include "shard.h"
+#include "server.h"
+#include "evloop.h"
+#include "timer.h"
+#include "wal.h"
+#include "rollup.h"
+#include "blockwise.h"
+#include "exchange.h"
+#include "observe.h"
+#include "respcache.h"
+#include "metrics.h"
+#include "ratelimit.h"
+#include "separate.h"
+#include "arena.h"
+#include "slab.h"
+#include "partition.h"
 
 #define SERVER_PORT 5683   // Puerto por defecto de CoAP
-#define MAX_BUF 1500
-#define MAX_THREADS 100    // Límite de threads concurrentes
-#define THREAD_TIMEOUT 30  // Timeout en segundos para threads
+#define DEFAULT_WORKERS 8     // Workers fijos del pool
+#define DEFAULT_QUEUE 1024    // Capacidad de la cola de recepción
+#define STATS_INTERVAL 30     // Segundos entre reportes de estadísticas
+#define QUERY_CHUNK 64        // Ventanas que se piden a los rollups por vez al armar una consulta
+#define QUERY_DEFAULT_STEP 60
+#define GET_MAX_AGE 60        // Segundos que un cliente puede reutilizar un GET sin revalidarlo
+#define OVERLOAD_MAX_AGE 1    // Segundos que se sugiere esperar cuando la cola está llena (5.03)
+#define DEFAULT_SEPARATE_MS 1000 // Espera o costo a partir del cual una mutación CON se responde por separado
+#define DEFAULT_INGEST_WEIGHT 3   // turnos de la ingesta por cada turno de las consultas cuando compiten
+#define DEFAULT_QUERY_WEIGHT 1
 
-static int active_threads = 0;
-static pthread_mutex_t thread_count_mutex = PTHREAD_MUTEX_INITIALIZER;
-FILE *logfile = NULL;
+// Carriles del pool: las mutaciones de los sensores y las lecturas no comparten cola ni
+// pueden ocupar todos los workers con un solo tipo de pedido
+enum { LANE_INGEST = 0, LANE_QUERY = 1, LANES };
+static const char *lane_names[LANES] = { "ingesta", "consultas" };
 
-// Estructura para pasar datos al thread
+static atomic_int active_threads = 0;
+static atomic_uint_fast64_t overload_rejected = 0;   // 5.03 por cola llena
+static uint64_t separate_threshold_ns = 0;            // 0 = sin respuestas separadas
+static atomic_uint_fast64_t mutation_cost_ns = 0;     // promedio móvil del handler de POST/PUT/DELETE
+
+// Slot de recepción preasignado: lo llena el loop de recepción y lo procesa un worker
 typedef struct {
     int sock;
     struct sockaddr_in client_addr;
     socklen_t client_len;
     uint8_t buffer[MAX_BUF];
     size_t buffer_len;
-} thread_args_t;
-
-// Hacer log de los mensajes del servidor
-void message_log(const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    time_t now = time(NULL);
-    char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-
-    log_text("[%s]", timestamp);
-    vprintf(fmt, args);
-    log_text("\n");
-
-    if (logfile) {
-        fprintf(logfile, "[%s]", timestamp);
-        vfprintf(logfile, fmt, args);
-        fprintf(logfile, "\n");
-        fflush(logfile);
-    } else {
-        log_text("[ERROR] No se pudo escribir en el archivo de log.");
+    uint64_t received_ns;  // para medir la espera en la cola
+    int lane;
+} recv_slot_t;
+
+// Configuración tomada de la línea de comandos
+typedef struct {
+    int port;
+    const char *logpath;
+    size_t workers;
+    size_t queue_size;
+    size_t batch;          // datagramas por recvmmsg/sendmmsg (0 = E/S clásica)
+    bool gso;
+    size_t shards;         // listeners SO_REUSEPORT, uno por core (0 = socket único)
+    evloop_backend_t loop; // loop de eventos (epoll / io_uring) en vez de hilos bloqueantes
+    log_level_t log_level;
+    const char *metrics_path;   // volcado periódico de las métricas (NULL = sólo el recurso CoAP)
+    unsigned metrics_interval;
+    double rate_limit;     // pedidos/s por endpoint (0 = sin límite)
+    double burst;          // pedidos acumulables por endpoint (0 = un segundo de rate_limit)
+    unsigned separate_ms;  // umbral de las respuestas separadas (0 = siempre piggybacked)
+    size_t query_workers;  // tope de workers para las consultas (0 = un cuarto, al menos 1; sin carriles si hay un solo worker)
+    size_t query_queue;    // cola del carril de consultas (0 = un cuarto de la de ingesta)
+    unsigned lane_weights[LANES];
+    bool no_lanes;         // una sola cola para todo, como antes de los carriles
+    storage_options_t storage;
+} server_config_t;
+
+static worker_pool_t *pool = NULL;
+static recv_slot_t *slots = NULL;
+static ring_t free_slots;          // slots libres (MPMC sin locks)
+static size_t slot_count = 0;
+static atomic_size_t slots_in_use = 0;
+static atomic_size_t slots_high_water = 0;
+
+// Leer un instante de la consulta: segundos epoch o "YYYY-MM-DDTHH:MM:SS" (hora local, como data.json)
+static int parse_query_time(const char *text, time_t *out) {
+    char *end;
+    long long secs = strtoll(text, &end, 10);
+    if (*text && *end == '\0') {
+        *out = (time_t) secs;
+        return 0;
     }
-    va_end(args);
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    end = strptime(text, "%Y-%m-%dT%H:%M:%S", &tm_info);
+    if (!end || *end != '\0') return -1;
+    tm_info.tm_isdst = -1;
+    *out = mktime(&tm_info);
+    return 0;
+}
+
+// Cabecera de la respuesta a un pedido: ACK (o NON si vino NON) con su MID y token
+static void reply_header(const coap_packet_t *request, coap_packet_t *response) {
+    response->ver = 1;
+    response->type = (request->type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
+    response->message_id = request->message_id;
+    response->token_len = request->token_len;
+    memcpy(response->token, request->token, request->token_len);
 }
 
-// Conseguir ID de option - Con validación de memoria
-int coap_get_uri_id(const coap_packet_t *pkt) {
-    if (!pkt) return -1;
+// Porción [off, off + size) de un texto que se genera de a pedazos: sólo se copia lo que cae
+// dentro del bloque pedido y pos cuenta el largo total generado hasta ahora
+typedef struct {
+    uint8_t *out;
+    size_t off, size;
+    size_t pos;
+} query_slice_t;
+
+static void slice_put(query_slice_t *s, const char *text, size_t len) {
+    size_t lo = s->pos > s->off ? s->pos : s->off;
+    size_t hi = s->pos + len < s->off + s->size ? s->pos + len : s->off + s->size;
+    if (lo < hi) memcpy(s->out + (lo - s->off), text + (lo - s->pos), hi - lo);
+    s->pos += len;
+}
 
-    if (pkt->options_count <= 0 || pkt->options_count > 16) {
-        return -1;
+// GET data?from=...&to=...&agg=avg&step=60: agregados por ventana desde los rollups.
+// Responde [[inicio,valor],...] sólo con las ventanas que tienen lecturas. Si no entra en un
+// bloque se pagina con Block2: cada bloque vuelve a recorrer los rollups y copia su porción
+static void handle_query(coap_packet_t *request, coap_packet_t *response, uint8_t *payload, uint8_t *block_opt) {
+    char from_s[32], to_s[32], agg_s[16], step_s[16];
+    time_t from, to = time(NULL);
+    unsigned step = QUERY_DEFAULT_STEP;
+    rollup_agg_t agg = ROLLUP_AVG;
+    coap_block_t block = { .num = 0, .szx = BLOCK_DEFAULT_SZX };
+
+    response->code = COAP_CODE_BAD_REQ;
+    if (coap_get_query(request, "from", from_s, sizeof(from_s)) < 0 || parse_query_time(from_s, &from) != 0 ||
+        (coap_get_query(request, "to", to_s, sizeof(to_s)) >= 0 && parse_query_time(to_s, &to) != 0) ||
+        (coap_get_query(request, "agg", agg_s, sizeof(agg_s)) >= 0 && rollup_parse_agg(agg_s, &agg) != 0)) {
+        log_text("[ERROR] GET: Consulta inválida");
+        return;
+    }
+    if (coap_get_query(request, "step", step_s, sizeof(step_s)) >= 0) step = strtoul(step_s, NULL, 10);
+    int has_block = coap_get_block(request, COAP_OPTION_BLOCK2, &block);
+    if (has_block == -2) {
+        log_text("[ERROR] GET: Opción Block2 inválida");
+        return;
     }
+    if (block.szx > BLOCK_DEFAULT_SZX) block.szx = BLOCK_DEFAULT_SZX;
 
-    for (int i = 0; i < pkt->options_count; i++) {
-        if (pkt->options[i].number == 11) { // Uri-Path
-            if (pkt->options[i].length > 0 && pkt->options[i].length < 32) {
-                char buf[32];
-                memcpy(buf, pkt->options[i].value, pkt->options[i].length);
-                buf[pkt->options[i].length] = '\0';
-                int id = atoi(buf);
-                if (id > 0) return id;
-            }
+    size_t size = (size_t) 1 << (block.szx + 4);
+    query_slice_t slice = { .out = payload, .off = (size_t) block.num * size, .size = size };
+    rollup_bucket_t windows[QUERY_CHUNK];
+    char entry[64];
+    long total = 0;
+    slice_put(&slice, "[", 1);
+    // Con el bloque lleno alcanza con saber que hay algo más después
+    while (slice.pos <= slice.off + slice.size) {
+        long n = rollup_query(from, to, step, windows, QUERY_CHUNK);
+        if (n < 0) {
+            log_text("[WARNING] GET: Consulta con step inválido");
+            return;
         }
+        for (long i = 0; i < n && slice.pos <= slice.off + slice.size; i++) {
+            int w = snprintf(entry, sizeof(entry), "%s[%lld,%.10g]", total++ ? "," : "",
+                             (long long) windows[i].start, rollup_value(&windows[i], agg));
+            slice_put(&slice, entry, (size_t) w);
+        }
+        if (n < QUERY_CHUNK) break;
+        from = windows[n - 1].start + (time_t) step;
+    }
+    slice_put(&slice, "]", 1);
+
+    if (block.num > 0 && slice.pos <= slice.off) {
+        log_text("[WARNING] GET: Bloque %u fuera de la consulta", block.num);
+        return;
+    }
+    block.more = slice.pos > slice.off + slice.size;
+    response->code = COAP_CODE_CONTENT;
+    response->payload = payload;
+    response->payload_len = block.more ? size : slice.pos - slice.off;
+    if (has_block == 0 || block.more) {
+        coap_add_option(response, COAP_OPTION_BLOCK2, block_opt, coap_encode_block(&block, block_opt));
+    }
+    log_text("[INFO] GET: Consulta con ventanas de %u s, bloque %u (%zu bytes)%s", step, block.num,
+             response->payload_len, block.more ? "" : ", último");
+}
+
+// true si el Uri-Path es exactamente "data" (la colección, sin id)
+static bool uri_is_collection(const coap_packet_t *pkt) {
+    const coap_option_t *segments[1];
+    return coap_get_path(pkt, segments, 1) == 1 && coap_option_is(segments[0], "data");
+}
+
+#define URI_LATEST -3
+
+// Recurso particionado del Uri-Path: data/<sensor> (retorna 0), data/<sensor>/<id> (retorna el id,
+// o -2 si no es un id válido) o data/<sensor>/latest (retorna URI_LATEST). Retorna -1 si no es
+// de una partición (data/<id>, data, etc.)
+static int uri_partition(const coap_packet_t *pkt, char sensor[PARTITION_NAME_MAX + 1]) {
+    const coap_option_t *segments[3];
+    int n = coap_get_path(pkt, segments, 3);
+    if (n < 2 || !coap_option_is(segments[0], "data") || segments[1]->length > PARTITION_NAME_MAX) return -1;
+    memcpy(sensor, segments[1]->value, segments[1]->length);
+    sensor[segments[1]->length] = '\0';
+    if (strlen(sensor) != segments[1]->length || !partition_valid_name(sensor)) return -1;
+    if (n == 2) return 0;
+    if (coap_option_is(segments[2], "latest")) return URI_LATEST;
+    uint32_t id;
+    if (coap_option_decimal(segments[2], &id) != 0 || id == 0) return -2;
+    return (int) id;
+}
+
+// true si el Uri-Path es .well-known/metrics
+static bool uri_is_metrics(const coap_packet_t *pkt) {
+    const coap_option_t *segments[2];
+    return coap_get_path(pkt, segments, 2) == 2 && coap_option_is(segments[0], ".well-known") &&
+           coap_option_is(segments[1], "metrics");
+}
+
+// Valores instantáneos del servidor para las métricas (hilos ocupados, la cola del pool y las marcas de memoria)
+static void collect_gauges(metrics_gauges_t *g) {
+    memset(g, 0, sizeof(*g));
+    g->active_threads = (size_t) atomic_load(&active_threads);
+    if (pool) {
+        pool_stats_t ps;
+        pool_get_stats(pool, &ps);
+        g->workers_busy = ps.busy;
+        g->queue_depth = ps.queue_depth;
+        g->queue_capacity = ps.queue_capacity;
+    }
+    g->slots_high_water = atomic_load_explicit(&slots_high_water, memory_order_relaxed);
+    arena_stats_t as;
+    arena_get_stats(&as);
+    g->arena_high_water = as.high_water;
+    g->arena_fallbacks = as.fallbacks;
+    slab_stats_t sl;
+    slab_get_stats(&sl);
+    g->slab_fallbacks = sl.fallbacks;
+}
+
+// Volcado periódico de las métricas completas (ctx es la ruta del archivo)
+static void dump_metrics(void *ctx) {
+    metrics_gauges_t g;
+    collect_gauges(&g);
+    if (metrics_dump((const char*) ctx, &g) != 0) {
+        log_text("[WARNING] No se pudieron escribir las métricas en %s", (const char*) ctx);
+    }
+}
+
+// GET data (o data/<sensor>): exportación completa por bloques (Block2), un bloque por pedido
+static void handle_export(const struct sockaddr_in *peer, const char *sensor, coap_packet_t *request,
+                          coap_packet_t *response, uint8_t *payload, uint8_t *block_opt) {
+    coap_block_t req, resp;
+    int has_block = coap_get_block(request, COAP_OPTION_BLOCK2, &req);
+    size_t len = 0;
+
+    response->code = COAP_CODE_BAD_REQ;
+    if (has_block == -2) {
+        log_text("[ERROR] GET: Opción Block2 inválida");
+        return;
+    }
+    if (block_export(peer, sensor, has_block == 0 ? &req : NULL, &resp, payload, &len) != 0) {
+        log_text("[WARNING] GET: Bloque %u fuera de la exportación", has_block == 0 ? req.num : 0);
+        return;
+    }
+    response->code = COAP_CODE_CONTENT;
+    response->payload = payload;
+    response->payload_len = len;
+    coap_add_option(response, COAP_OPTION_BLOCK2, block_opt, coap_encode_block(&resp, block_opt));
+    log_text("[INFO] GET: Exportación%s%s, bloque %u (%zu bytes)%s", sensor ? " de " : "", sensor ? sensor : "",
+             resp.num, len, resp.more ? "" : ", último");
+}
+
+// ETag de un valor: FNV-1a de 64 bits, así el mismo contenido conserva la misma ETag
+static size_t compute_etag(const char *value, uint8_t etag[8]) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *value; value++) h = (h ^ (uint8_t) *value) * 1099511628211ULL;
+    for (int i = 0; i < 8; i++) etag[i] = (uint8_t) (h >> (56 - 8 * i));
+    return 8;
+}
+
+// true si alguna de las opciones ETag del pedido es la versión actual
+static bool etag_matches(const coap_packet_t *req, const uint8_t *etag, size_t len) {
+    for (const coap_option_t *opt = coap_find_option(req, COAP_OPTION_ETAG); opt; opt = coap_next_option(req, opt)) {
+        if (opt->length == len && memcmp(opt->value, etag, len) == 0) return true;
+    }
+    return false;
+}
+
+// Agregar ETag y Max-Age a una respuesta (los buffers deben vivir hasta coap_build)
+static void add_validators(coap_packet_t *resp, const uint8_t *etag, size_t etag_len, uint8_t *max_age_opt) {
+    coap_add_option(resp, COAP_OPTION_ETAG, etag, (uint16_t) etag_len);
+    coap_add_option(resp, COAP_OPTION_MAX_AGE, max_age_opt, coap_encode_uint(GET_MAX_AGE, max_age_opt));
+}
+
+// GET con Observe: 0 suscribe al cliente (la respuesta lleva el número de secuencia), 1 cancela
+static void handle_observe(const struct sockaddr_in *peer, coap_packet_t *request, coap_packet_t *response,
+                           int id, uint32_t observe, uint8_t *observe_opt) {
+    char path[32];
+    snprintf(path, sizeof(path), "data/%d", id);
+    if (observe == 1) {
+        observe_cancel(peer, request->token, request->token_len);
+        log_text("[INFO] GET: Observe cancelado para %s", path);
+        return;
+    }
+    uint32_t seq;
+    if (observe != 0 || observe_register(peer, request->token, request->token_len, path, &seq) != 0) {
+        // Sin lugar (o valor desconocido): se responde como un GET normal
+        log_text("[WARNING] GET: No se pudo registrar el observador de %s", path);
+        return;
+    }
+    coap_add_option(response, COAP_OPTION_OBSERVE, observe_opt, coap_encode_uint(seq, observe_opt));
+    log_text("[INFO] GET: Observador registrado para %s", path);
+}
+
+// Representación de un recurso observado para las notificaciones
+static uint8_t render_resource(const char *path, char *out, size_t max_len, size_t *len) {
+    int id;
+    if (sscanf(path, "data/%d", &id) != 1 || storage_get(id, out, max_len) != 0) return COAP_CODE_NOT_FOUND;
+    *len = strlen(out);
+    return COAP_CODE_CONTENT;
+}
+
+// Cada mutación confirmada invalida la respuesta en caché y notifica a los observadores del registro
+static void on_storage_change(int id) {
+    respcache_invalidate(id);
+    char path[32];
+    snprintf(path, sizeof(path), "data/%d", id);
+    observe_changed(path);
+}
+
+// GET data/<sensor>/latest: la última lectura del sensor, leída sin locks. Max-Age 0 porque
+// cambia con cada POST; la ETag permite revalidarla con 2.03
+static void handle_latest(coap_packet_t *request, coap_packet_t *response, const char *sensor, char *value,
+                          uint8_t *etag, uint8_t *max_age_opt) {
+    int id;
+    time_t ts;
+    if (partition_latest(sensor, &id, &ts, value, MAX_BUF) != 0) {
+        log_text("[WARNING] GET: %s no tiene lecturas", sensor);
+        response->code = COAP_CODE_BAD_REQ;
+        return;
+    }
+    size_t etag_len = compute_etag(value, etag);
+    coap_add_option(response, COAP_OPTION_ETAG, etag, (uint16_t) etag_len);
+    coap_add_option(response, COAP_OPTION_MAX_AGE, max_age_opt, coap_encode_uint(0, max_age_opt));
+    if (etag_matches(request, etag, etag_len)) {
+        response->code = COAP_CODE_VALID;
+        log_text("[INFO] GET: Última lectura de %s sin cambios (2.03)", sensor);
+    } else {
+        response->code = COAP_CODE_CONTENT;
+        response->payload = (uint8_t*) value;
+        response->payload_len = strlen(value);
+        log_text("[INFO] GET: Última lectura de %s (ID %d)", sensor, id);
+    }
+}
+
+// GET data/<sensor>: exportación de la partición por bloques; GET data/<sensor>/<id>: un registro.
+// No pasan por la caché de respuestas ni por Observe, que siguen los ids globales
+static void handle_partition_get(const struct sockaddr_in *peer, coap_packet_t *request, coap_packet_t *response,
+                                 const char *sensor, int id, char *value, uint8_t *block_opt, uint8_t *etag,
+                                 uint8_t *max_age_opt) {
+    if (id == 0) {
+        handle_export(peer, sensor, request, response, (uint8_t*) value, block_opt);
+        return;
+    }
+    if (id == URI_LATEST) {
+        handle_latest(request, response, sensor, value, etag, max_age_opt);
+        return;
+    }
+    if (id < 0) {
+        log_text("[ERROR] GET: ID inválido en %s", sensor);
+        response->code = COAP_CODE_BAD_REQ;
+        return;
+    }
+    if (partition_get(sensor, id, value, MAX_BUF) != 0) {
+        log_text("[WARNING] GET: ID %d no encontrado en %s", id, sensor);
+        response->code = COAP_CODE_BAD_REQ;
+        return;
+    }
+    size_t etag_len = compute_etag(value, etag);
+    add_validators(response, etag, etag_len, max_age_opt);
+    if (etag_matches(request, etag, etag_len)) {
+        response->code = COAP_CODE_VALID;
+        log_text("[INFO] GET: ID %d de %s sin cambios (2.03)", id, sensor);
+    } else {
+        response->code = COAP_CODE_CONTENT;
+        response->payload = (uint8_t*) value;
+        response->payload_len = strlen(value);
+        log_text("[INFO] GET: Datos recuperados para ID %d de %s", id, sensor);
     }
-    return -1;
 }
 
-void handle_get(coap_packet_t *request, coap_packet_t *response) {
+void handle_get(const struct sockaddr_in *peer, coap_packet_t *request, coap_packet_t *response) {
     if (!request || !response) return;
+    reply_header(request, response);
+
+    // La respuesta se serializa después de volver: el payload y las opciones salen de la arena
+    // del pedido, que sigue válida hasta que este hilo procese el siguiente
+    char *value = arena_alloc(MAX_BUF);
+    uint8_t *block_opt = arena_alloc(3);
+    uint8_t *observe_opt = arena_alloc(4);
+    uint8_t *etag = arena_alloc(8);
+    uint8_t *max_age_opt = arena_alloc(4);
+    if (!value || !block_opt || !observe_opt || !etag || !max_age_opt) {
+        log_text("[ERROR] GET: Sin memoria para la respuesta");
+        response->code = COAP_CODE_BAD_REQ;
+        return;
+    }
+
+    if (uri_is_metrics(request)) {
+        metrics_gauges_t g;
+        collect_gauges(&g);
+        int len = metrics_render(value, MAX_BUF - 64, &g);
+        if (len < 0) {
+            log_text("[ERROR] GET: Las métricas no entran en una respuesta");
+            response->code = COAP_CODE_BAD_REQ;
+        } else {
+            response->code = COAP_CODE_CONTENT;
+            response->payload = (uint8_t*) value;
+            response->payload_len = (size_t) len;
+        }
+        return;
+    }
+
+    char sensor[PARTITION_NAME_MAX + 1];
+    int part_id = uri_partition(request, sensor);
+    if (part_id != -1) {
+        handle_partition_get(peer, request, response, sensor, part_id, value, block_opt, etag, max_age_opt);
+        return;
+    }
+
+    if (coap_find_option(request, COAP_OPTION_URI_QUERY)) {
+        handle_query(request, response, (uint8_t*) value, block_opt);
+        return;
+    }
 
     int id = coap_get_uri_id(request);
+    if (id < 0 && uri_is_collection(request)) {
+        handle_export(peer, NULL, request, response, (uint8_t*) value, block_opt);
+        return;
+    }
     if (id < 0) {
         log_text("[ERROR] GET: ID inválido");
         response->code = COAP_CODE_BAD_REQ;
         return;
     }
 
-    char value[128];
-    int result = storage_get(id, value, sizeof(value));
+    int result = storage_get(id, value, MAX_BUF);
     if (result == 0) {
-        response->code = COAP_CODE_CONTENT;
-        response->payload = (uint8_t*) value;
-        response->payload_len = strlen(value);
-        log_text("[INFO] GET: Datos recuperados para ID %d", id);
+        size_t etag_len = compute_etag(value, etag);
+        add_validators(response, etag, etag_len, max_age_opt);
+        if (etag_matches(request, etag, etag_len)) {
+            // El cliente ya tiene esta versión: 2.03 sin payload
+            response->code = COAP_CODE_VALID;
+            log_text("[INFO] GET: ID %d sin cambios (2.03)", id);
+        } else {
+            response->code = COAP_CODE_CONTENT;
+            response->payload = (uint8_t*) value;
+            response->payload_len = strlen(value);
+            log_text("[INFO] GET: Datos recuperados para ID %d", id);
+        }
+        uint32_t observe;
+        if (coap_get_uint(request, COAP_OPTION_OBSERVE, &observe) == 0) {
+            handle_observe(peer, request, response, id, observe, observe_opt);
+        }
     } else if (result == -2) {
         log_text("[WARNING] GET: ID %d no encontrado", id);
         response->code = COAP_CODE_BAD_REQ;
@@ -100,18 +486,100 @@ void handle_get(coap_packet_t *request, coap_packet_t *response) {
         log_text("[ERROR] GET: Error interno al recuperar ID %d", id);
         response->code = COAP_CODE_BAD_REQ;
     }
+}
 
-    response->ver = 1;
-    response->type = (request->type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
-    response->message_id = request->message_id;
-    response->token_len = request->token_len;
-    memcpy(response->token, request->token, request->token_len);
+// POST con Block1: carga masiva, un valor por línea. Responde 2.31 hasta el último bloque
+static void handle_upload(const struct sockaddr_in *peer, coap_packet_t *request, coap_packet_t *response,
+                          const coap_block_t *block, uint8_t *block_opt, char *payload) {
+    size_t added = 0;
+    int res = block_upload(peer, block, request->payload, request->payload_len, &added);
+    if (res == 1) {
+        response->code = COAP_CODE_CONTINUE;
+    } else if (res == 0) {
+        response->code = COAP_CODE_CREATED;
+        response->payload_len = (size_t) snprintf(payload, 32, "%zu", added);
+        response->payload = (uint8_t*) payload;
+        log_text("[INFO] POST: Carga por bloques completa, %zu valores agregados", added);
+    } else if (res == -2) {
+        log_text("[WARNING] POST: Bloque %u fuera de orden", block->num);
+        response->code = COAP_CODE_INCOMPLETE;
+    } else {
+        log_text("[ERROR] POST: Error al agregar datos de la carga por bloques");
+        response->code = COAP_CODE_BAD_REQ;
+    }
+    if (res >= 0) {
+        // Confirmar el bloque recibido (M indica que el servidor espera más)
+        coap_block_t ack = { .num = block->num, .more = block->more, .szx = block->szx };
+        coap_add_option(response, COAP_OPTION_BLOCK1, block_opt, coap_encode_block(&ack, block_opt));
+    }
 }
 
-void handle_post(coap_packet_t *request, coap_packet_t *response) {
+// POST data/<sensor>: agregar un valor a la partición (se crea con el primero). La respuesta
+// lleva la ubicación del registro nuevo en Location-Path (data/<sensor>/<id>)
+static void handle_partition_post(coap_packet_t *request, coap_packet_t *response, const char *sensor, int id) {
+    response->code = COAP_CODE_BAD_REQ;
+    if (id != 0) {
+        log_text("[ERROR] POST: Los datos se agregan a data/%s, sin ID", sensor);
+        return;
+    }
+    if (coap_find_option(request, COAP_OPTION_BLOCK1)) {
+        log_text("[ERROR] POST: Las cargas por bloques van a data, no a data/%s", sensor);
+        return;
+    }
+    if (!request->payload || request->payload_len == 0 || request->payload_len > 100) {
+        log_text("[ERROR] POST: Payload vacío o demasiado grande (%zu bytes)", request->payload_len);
+        return;
+    }
+
+    // Las opciones se serializan después de volver: el texto sale de la arena del pedido
+    char *location = arena_alloc(PARTITION_NAME_MAX + 16);
+    if (!location) {
+        log_text("[ERROR] POST: Sin memoria para la respuesta");
+        return;
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%.*s", (int) request->payload_len, request->payload);
+
+    int new_id = partition_add(sensor, buf);
+    if (new_id > 0) {
+        size_t name_len = strlen(sensor);
+        memcpy(location, sensor, name_len);
+        int id_len = snprintf(location + name_len, 16, "%d", new_id);
+        coap_add_option(response, COAP_OPTION_LOCATION_PATH, (const uint8_t*) "data", 4);
+        coap_add_option(response, COAP_OPTION_LOCATION_PATH, (const uint8_t*) location, (uint16_t) name_len);
+        coap_add_option(response, COAP_OPTION_LOCATION_PATH, (const uint8_t*) location + name_len, (uint16_t) id_len);
+        response->code = COAP_CODE_CREATED;
+        log_text("[INFO] POST: Datos agregados a %s con ID %d", sensor, new_id);
+    } else if (new_id == -3) {
+        log_text("[ERROR] POST: No hay lugar para otra partición (%s)", sensor);
+    } else {
+        log_text("[ERROR] POST: Error al agregar datos a %s", sensor);
+    }
+}
+
+void handle_post(const struct sockaddr_in *peer, coap_packet_t *request, coap_packet_t *response) {
     if (!request || !response) return;
 
-    if (request->payload && request->payload_len > 0) {
+    char *count = arena_alloc(32);
+    uint8_t *block_opt = arena_alloc(3);
+    if (!count || !block_opt) {
+        log_text("[ERROR] POST: Sin memoria para la respuesta");
+        response->code = COAP_CODE_BAD_REQ;
+        return;
+    }
+    coap_block_t block;
+    int has_block = coap_get_block(request, COAP_OPTION_BLOCK1, &block);
+    char sensor[PARTITION_NAME_MAX + 1];
+    int part_id = uri_partition(request, sensor);
+
+    if (part_id != -1) {
+        handle_partition_post(request, response, sensor, part_id);
+    } else if (has_block == 0) {
+        handle_upload(peer, request, response, &block, block_opt, count);
+    } else if (has_block == -2) {
+        log_text("[ERROR] POST: Opción Block1 inválida");
+        response->code = COAP_CODE_BAD_REQ;
+    } else if (request->payload && request->payload_len > 0) {
         if (request->payload_len > 100) {
             log_text("[ERROR] POST: Payload demasiado grande (%zu bytes)", request->payload_len);
             response->code = COAP_CODE_BAD_REQ;
@@ -139,34 +607,214 @@ void handle_post(coap_packet_t *request, coap_packet_t *response) {
         response->code = COAP_CODE_BAD_REQ;
     }
 
-    response->ver = 1;
-    response->type = (request->type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
-    response->message_id = request->message_id;
-    response->token_len = request->token_len;
-    memcpy(response->token, request->token, request->token_len);
-    response->payload = NULL;
-    response->payload_len = 0;
+    reply_header(request, response);
+    if (has_block != 0) {
+        response->payload = NULL;
+        response->payload_len = 0;
+    }
 }
 
-// Usa hilos para manejar multiples clientes
-void *handle_client(void *arg) {
-    thread_args_t *args = (thread_args_t*) arg;
-    if (!args) {
-        log_text("[ERROR] Argumentos de thread nulos");
-        return NULL;
+// GET de un registro sin opciones que cambien la respuesta (Observe, Block2, consultas): cacheable
+static int cacheable_get_id(const coap_packet_t *req) {
+    if (req->code != COAP_CODE_GET) return -1;
+    for (size_t i = 0; i < req->options_count; i++) {
+        uint16_t number = req->options[i].number;
+        if (number != COAP_OPTION_URI_PATH && number != COAP_OPTION_ETAG) return -1;
+    }
+    // La caché está indexada por id global: los registros de una partición no pasan por ella
+    char sensor[PARTITION_NAME_MAX + 1];
+    if (uri_partition(req, sensor) != -1) return -1;
+    return coap_get_uri_id(req);
+}
+
+// Responder un GET desde la caché sin tocar el almacenamiento. Retorna 0 si se sirvió,
+// o -1 si no estaba (ticket recibe la reserva para guardar la respuesta que se arme)
+static int serve_cached(const coap_packet_t *req, int id, uint8_t *out, size_t *out_len, size_t max_len,
+                        uint64_t *ticket) {
+    uint8_t tail[RESPCACHE_TAIL_MAX], etag[RESPCACHE_ETAG_MAX];
+    size_t tail_len, etag_len;
+    if (respcache_get(id, tail, &tail_len, etag, &etag_len, ticket) != 0) return -1;
+
+    uint8_t type = (req->type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
+    if (etag_matches(req, etag, etag_len)) {
+        coap_packet_t valid;
+        memset(&valid, 0, sizeof(valid));
+        valid.ver = 1;
+        valid.type = type;
+        valid.code = COAP_CODE_VALID;
+        valid.message_id = req->message_id;
+        valid.token_len = req->token_len;
+        memcpy(valid.token, req->token, req->token_len);
+        uint8_t max_age_opt[4];
+        add_validators(&valid, etag, etag_len, max_age_opt);
+        log_text("[INFO] GET: ID %d sin cambios (2.03, caché)", id);
+        return coap_build(&valid, out, out_len, max_len);
+    }
+
+    if (4 + req->token_len + tail_len > max_len) return -1;
+    out[0] = (uint8_t) ((1 << 6) | (type << 4) | req->token_len);
+    out[1] = COAP_CODE_CONTENT;
+    out[2] = (uint8_t) (req->message_id >> 8);
+    out[3] = (uint8_t) (req->message_id & 0xFF);
+    memcpy(out + 4, req->token, req->token_len);
+    memcpy(out + 4 + req->token_len, tail, tail_len);
+    *out_len = 4 + req->token_len + tail_len;
+    log_text("[INFO] GET: Datos en caché para ID %d", id);
+    return 0;
+}
+
+// Guardar en la caché lo que sigue al token de una respuesta 2.05 recién serializada
+static void cache_response(int id, uint64_t ticket, const coap_packet_t *resp, const struct iovec *iov, size_t iovcnt) {
+    uint8_t tail[RESPCACHE_TAIL_MAX];
+    size_t skip = 4 + resp->token_len;
+    size_t len = iov[0].iov_len - skip;
+    if (len + (iovcnt == 2 ? iov[1].iov_len : 0) > sizeof(tail)) return;
+    memcpy(tail, (const uint8_t*) iov[0].iov_base + skip, len);
+    if (iovcnt == 2) {
+        memcpy(tail + len, iov[1].iov_base, iov[1].iov_len);
+        len += iov[1].iov_len;
+    }
+
+    const coap_option_t *etag = coap_find_option(resp, COAP_OPTION_ETAG);
+    if (etag) respcache_put(id, ticket, tail, len, etag->value, etag->length);
+}
+
+// Respuesta de un solo tramo (ya serializada completa en buf)
+static int single_iov(uint8_t *buf, size_t len, struct iovec iov[2], size_t *iovcnt) {
+    iov[0].iov_base = buf;
+    iov[0].iov_len = len;
+    *iovcnt = 1;
+    return 0;
+}
+
+// 5.03 Service Unavailable con Max-Age = segundos sugeridos para reintentar, armado sólo
+// con la cabecera y el token del pedido (sin parsearlo entero). Retorna -1 si no es un pedido CON/NON
+static int build_unavailable(const uint8_t *in, size_t in_len, uint32_t max_age,
+                             uint8_t *out, size_t *out_len, size_t max_len) {
+    if (in_len < 4 || COAP_VER(in) != 1) return -1;
+    uint8_t type = COAP_TYPE(in), code = COAP_CODE(in), tkl = COAP_TKL(in);
+    if ((type != COAP_TYPE_CON && type != COAP_TYPE_NON) || code == COAP_CODE_EMPTY || code >= 32) return -1;
+    if (tkl > 8 || 4u + tkl > in_len) return -1;
+
+    coap_packet_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.ver = 1;
+    resp.type = (type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
+    resp.code = COAP_CODE_UNAVAILABLE;
+    resp.message_id = COAP_MID(in);
+    resp.token_len = tkl;
+    memcpy(resp.token, in + 4, tkl);
+    uint8_t max_age_opt[4];
+    coap_add_option(&resp, COAP_OPTION_MAX_AGE, max_age_opt, coap_encode_uint(max_age, max_age_opt));
+    return coap_build(&resp, out, out_len, max_len);
+}
+
+// Contestar 5.03 desde el loop de recepción, sin ocupar un worker
+static void reject_unavailable(int sock, const struct sockaddr_in *peer, const uint8_t *in, size_t in_len,
+                               uint32_t max_age) {
+    uint8_t out[64];
+    size_t out_len;
+    if (build_unavailable(in, in_len, max_age, out, &out_len, sizeof(out)) != 0) return;
+    struct iovec iov = { .iov_base = out, .iov_len = out_len };
+    if (netio_sendv(sock, peer, &iov, 1) < 0) {
+        log_text("[ERROR] Error enviando 5.03: %s", strerror(errno));
+        return;
     }
+    metrics_count_response(COAP_TYPE(out), COAP_CODE_UNAVAILABLE);
+}
 
-    pthread_mutex_lock(&thread_count_mutex);
-    active_threads++;
-    pthread_mutex_unlock(&thread_count_mutex);
+// Los ACK y RST confirman mensajes del servidor (notificaciones, respuestas separadas) y no
+// gastan fichas: a un 5.03 no hay quien le conteste y perderlos da de baja al observador
+static bool rate_exempt(const uint8_t *in, size_t in_len) {
+    return in_len >= 4 && COAP_TYPE(in) >= COAP_TYPE_ACK;
+}
+
+// Pedido de un endpoint sin fichas: 5.03 con el tiempo hasta la próxima
+static bool rate_limited(int sock, const struct sockaddr_in *peer, const uint8_t *in, size_t in_len) {
+    uint32_t retry_after;
+    if (rate_exempt(in, in_len) || ratelimit_allow(peer, &retry_after)) return false;
+    reject_unavailable(sock, peer, in, in_len, retry_after);
+    return true;
+}
+
+// Carril de un datagrama según su método, leído de la cabecera sin parsearlo: las lecturas
+// (registros, consultas por rango, exportaciones, métricas) van a consultas y todo lo demás
+// (POST/PUT/DELETE, cargas por bloques, ACK y RST) a ingesta
+static int request_lane(const uint8_t *in, size_t in_len) {
+    if (pool_lane_count(pool) < LANES || in_len < 4) return LANE_INGEST;
+    return COAP_CODE(in) == COAP_CODE_GET ? LANE_QUERY : LANE_INGEST;
+}
+
+// Latencia total del pedido en el servidor (desde que se recibió) en la métrica de su carril
+static void record_lane_latency(const recv_slot_t *slot, uint64_t now) {
+    if (slot->received_ns > 0) {
+        metrics_record(slot->lane == LANE_QUERY ? METRIC_QUERY : METRIC_INGEST, now - slot->received_ns, 1);
+    }
+}
+
+// Tomar un slot libre (NULL si están todos en uso), llevando la marca de máximo en uso
+static recv_slot_t *slot_take(void) {
+    recv_slot_t *slot;
+    if (!ring_pop(&free_slots, (void**) &slot)) return NULL;
+    size_t in_use = atomic_fetch_add_explicit(&slots_in_use, 1, memory_order_relaxed) + 1;
+    size_t hw = atomic_load_explicit(&slots_high_water, memory_order_relaxed);
+    while (in_use > hw && !atomic_compare_exchange_weak_explicit(&slots_high_water, &hw, in_use,
+                                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    return slot;
+}
 
+// Devolver un slot a la lista de libres
+static void slot_release(recv_slot_t *slot) {
+    atomic_fetch_sub_explicit(&slots_in_use, 1, memory_order_relaxed);
+    ring_push(&free_slots, slot);
+}
+
+// Responder por separado una mutación CON si ya esperó en la cola más que el umbral o si las
+// últimas mutaciones tardaron eso (por ejemplo, reescribiendo un data.json grande): así el
+// cliente recibe el ACK antes de ACK_TIMEOUT y no retransmite
+static bool should_defer(const coap_packet_t *req, uint64_t received_ns, uint64_t now) {
+    if (separate_threshold_ns == 0 || req->type != COAP_TYPE_CON) return false;
+    if (req->code != COAP_CODE_POST && req->code != COAP_CODE_PUT && req->code != COAP_CODE_DELETE) return false;
+    // Las transferencias por bloques siguen el ritmo de sus propias respuestas
+    if (coap_find_option(req, COAP_OPTION_BLOCK1) || coap_find_option(req, COAP_OPTION_BLOCK2)) return false;
+    if (received_ns > 0 && now - received_ns >= separate_threshold_ns) return true;
+    return atomic_load_explicit(&mutation_cost_ns, memory_order_relaxed) >= separate_threshold_ns;
+}
+
+// Promedio móvil (1/8 de peso a la última) del costo de las mutaciones
+static void record_mutation_cost(uint64_t ns) {
+    uint64_t avg = atomic_load_explicit(&mutation_cost_ns, memory_order_relaxed);
+    atomic_store_explicit(&mutation_cost_ns, avg - avg / 8 + ns / 8, memory_order_relaxed);
+}
+
+// Procesar un datagrama y serializar la respuesta (cabecera en head, payload en iov[1]).
+// received_ns es cuándo se recibió (0 si se procesa apenas llega, sin cola de por medio)
+static int dispatch_request(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len, uint64_t received_ns,
+                            uint8_t *head, size_t head_cap, struct iovec iov[2], size_t *iovcnt) {
     coap_packet_t req, resp;
+    size_t head_len;
     memset(&req, 0, sizeof(coap_packet_t));
     memset(&resp, 0, sizeof(coap_packet_t));
 
-    int res = coap_parse(args->buffer, args->buffer_len, &req);
+    // La respuesta anterior de este hilo ya salió: su memoria temporal se libera de una vez
+    arena_reset();
+
+    // Sin pool (shards, loops de eventos) el límite por endpoint se aplica acá; con pool,
+    // en el loop de recepción antes de encolar
+    uint32_t retry_after;
+    if (!pool && !rate_exempt(in, in_len) && !ratelimit_allow(peer, &retry_after)) {
+        if (build_unavailable(in, in_len, retry_after, head, &head_len, head_cap) != 0) return -1;
+        return single_iov(head, head_len, iov, iovcnt);
+    }
+
+    uint64_t t0 = metrics_now_ns();
+    int res = coap_parse(in, in_len, &req);
+    uint64_t t1 = metrics_now_ns();
+    metrics_record(METRIC_PARSE, t1 - t0, 1);
     if (res != 0 || !coap_validate(&req)) {
         log_text("[ERROR] Paquete inválido, respondiendo con RST");
+        metrics_count_parse_failure();
 
         coap_packet_t rst;
         memset(&rst, 0, sizeof(coap_packet_t));
@@ -175,30 +823,77 @@ void *handle_client(void *arg) {
         rst.code = COAP_CODE_EMPTY;
         rst.message_id = req.message_id; // eco del MID recibido
 
-        uint8_t out[MAX_BUF];
-        size_t out_len;
-        if (coap_build(&rst, out, &out_len, sizeof(out)) == 0) {
-            sendto(args->sock, out, out_len, 0,
-                (struct sockaddr*) &args->client_addr, args->client_len);
-        }
-        goto cleanup;
+        if (coap_build(&rst, head, &head_len, head_cap) != 0) return -1;
+        return single_iov(head, head_len, iov, iovcnt);
     }
 
 
     log_text("[INFO] Mensaje recibido: Ver=%d Type=%d Code=%d MID=0x%04X",
              req.ver, req.type, req.code, req.message_id);
 
-    int uriId = 0;
+    // ACK o RST de un cliente: responde a una respuesta separada o a una notificación de
+    // Observe. Las notificaciones CON también están en separate (las retransmite), así que
+    // Observe se entera siempre
+    if (req.type == COAP_TYPE_ACK || req.type == COAP_TYPE_RST) {
+        if (req.type == COAP_TYPE_RST) metrics_count_rst_received();
+        separate_reply(peer, req.message_id, req.type == COAP_TYPE_RST);
+        observe_reply(peer, req.message_id, req.type == COAP_TYPE_RST);
+        return -1;
+    }
+    metrics_count_request(req.code);
+
+    // Retransmisión de un pedido ya atendido: se reenvía la misma respuesta sin ejecutarlo otra vez
+    bool confirmable = req.type == COAP_TYPE_CON;
+    bool tracked = req.code != COAP_CODE_EMPTY && (confirmable || req.type == COAP_TYPE_NON);
+    if (tracked) {
+        int ex = exchange_begin(peer, req.message_id, confirmable, head, &head_len, head_cap);
+        if (ex == EXCHANGE_REPLAY) {
+            log_text("[INFO] Retransmisión MID=0x%04X, reenviando la respuesta guardada", req.message_id);
+            return single_iov(head, head_len, iov, iovcnt);
+        }
+        if (ex == EXCHANGE_IN_PROGRESS) return -1;   // la respuesta sale cuando termine el original
+        tracked = ex == EXCHANGE_NEW;
+    }
+
+    // GET de un registro: primero la caché de respuestas serializadas
+    uint64_t cache_ticket = 0;
+    int cache_id = cacheable_get_id(&req);
+    if (cache_id > 0 && serve_cached(&req, cache_id, head, &head_len, head_cap, &cache_ticket) == 0) {
+        single_iov(head, head_len, iov, iovcnt);
+        if (tracked) exchange_finish(peer, req.message_id, iov, *iovcnt);
+        return 0;
+    }
+
+    int uriId = 0, part_id;
+    char sensor[PARTITION_NAME_MAX + 1];
+    uint64_t t2 = metrics_now_ns();
+
+    // Respuesta separada: ACK vacío ya (también para las retransmisiones del pedido) y el resultado después
+    bool deferred = should_defer(&req, received_ns, t2);
+    if (deferred) {
+        uint8_t ack[4];
+        deferred = separate_ack(peer, req.message_id, ack) == 0;
+        if (deferred) {
+            metrics_count_response(COAP_TYPE_ACK, COAP_CODE_EMPTY);
+            if (tracked) {
+                struct iovec ack_iov = { .iov_base = ack, .iov_len = sizeof(ack) };
+                exchange_finish(peer, req.message_id, &ack_iov, 1);
+                tracked = false;
+            }
+        }
+    }
 
     switch (req.code) {
         case COAP_CODE_GET:
-            handle_get(&req, &resp);
+            handle_get(peer, &req, &resp);
             break;
         case COAP_CODE_POST:
-            handle_post(&req, &resp);
+            handle_post(peer, &req, &resp);
             break;
         case COAP_CODE_PUT:
-            uriId = coap_get_uri_id(&req);
+            // data/<sensor>/<id> va a la partición; el resto, a los ids globales
+            part_id = uri_partition(&req, sensor);
+            uriId = (part_id == -1) ? coap_get_uri_id(&req) : (part_id > 0 ? part_id : -1);
             if (uriId < 0) {
                 resp.code = COAP_CODE_BAD_REQ;
                 break;
@@ -206,7 +901,7 @@ void *handle_client(void *arg) {
             if (req.payload && req.payload_len > 0) {
                 char buf[128];
                 snprintf(buf, sizeof(buf), "%.*s", (int)req.payload_len, req.payload);
-                if (storage_update(uriId, buf) == 0) {
+                if ((part_id > 0 ? partition_update(sensor, uriId, buf) : storage_update(uriId, buf)) == 0) {
                     resp.code = COAP_CODE_CHANGED;
                     log_text("[INFO] PUT recibido");
                 } else {
@@ -215,82 +910,566 @@ void *handle_client(void *arg) {
             } else {
                 resp.code = COAP_CODE_BAD_REQ;
             }
-            resp.ver = 1;
-            resp.type = (req.type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
-            resp.message_id = req.message_id;
-            resp.token_len = req.token_len;
-            memcpy(resp.token, req.token, req.token_len);
+            reply_header(&req, &resp);
             resp.payload = NULL;
             resp.payload_len = 0;
             break;
         case COAP_CODE_DELETE:
-            uriId = coap_get_uri_id(&req);
+            part_id = uri_partition(&req, sensor);
+            uriId = (part_id == -1) ? coap_get_uri_id(&req) : (part_id > 0 ? part_id : -1);
             if (uriId < 0) {
                 resp.code = COAP_CODE_BAD_REQ;
                 break;
             }
-            if (storage_delete(uriId) == 0) {
+            if ((part_id > 0 ? partition_delete(sensor, uriId) : storage_delete(uriId)) == 0) {
                 resp.code = COAP_CODE_DELETED;
             } else {
                 resp.code = COAP_CODE_BAD_REQ;
             }
-            resp.ver = 1;
-            resp.type = (req.type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
-            resp.message_id = req.message_id;
-            resp.token_len = req.token_len;
-            memcpy(resp.token, req.token, req.token_len);
+            reply_header(&req, &resp);
             resp.payload = NULL;
             resp.payload_len = 0;
             break;
         default:
-            resp.ver = 1;
-            resp.type = (req.type == COAP_TYPE_NON) ? COAP_TYPE_NON : COAP_TYPE_ACK;
+            reply_header(&req, &resp);
             resp.code = COAP_CODE_BAD_REQ;
-            resp.message_id = req.message_id;
-            resp.token_len = req.token_len;
-            memcpy(resp.token, req.token, req.token_len);
             resp.payload = NULL;
             resp.payload_len = 0;
             break;
     }
 
-    uint8_t out[MAX_BUF];
-    size_t out_len;
-    if (coap_build(&resp, out, &out_len, sizeof(out)) == 0) {
-        ssize_t sent = sendto(args->sock, out, out_len, 0,
-                             (struct sockaddr*) &args->client_addr, args->client_len);
-        if (sent < 0) {
+    uint64_t t3 = metrics_now_ns();
+    metrics_record(METRIC_STORAGE, t3 - t2, 1);
+    if (req.code == COAP_CODE_POST || req.code == COAP_CODE_PUT || req.code == COAP_CODE_DELETE) record_mutation_cost(t3 - t2);
+    res = coap_build_iov(&resp, head, head_cap, MAX_BUF, iov, iovcnt);
+    metrics_record(METRIC_BUILD, metrics_now_ns() - t3, 1);
+    if (res != 0) {
+        log_text("[ERROR] Error serializando respuesta CoAP");
+        if (tracked) exchange_abort(peer, req.message_id);
+        return -1;
+    }
+    if (cache_id > 0 && resp.code == COAP_CODE_CONTENT) cache_response(cache_id, cache_ticket, &resp, iov, *iovcnt);
+    if (deferred) {
+        if (separate_send(peer, iov, *iovcnt) == 0) {
+            metrics_count_response(COAP_TYPE_CON, resp.code);
+        } else {
+            log_text("[ERROR] No se pudo enviar la respuesta separada: %s", strerror(errno));
+        }
+        return -1;
+    }
+    if (tracked) exchange_finish(peer, req.message_id, iov, *iovcnt);
+    return 0;
+}
+
+// dispatch_request más el conteo de la respuesta
+static int respond_iov(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len, uint64_t received_ns,
+                       uint8_t *head, size_t head_cap, struct iovec iov[2], size_t *iovcnt) {
+    int res = dispatch_request(peer, in, in_len, received_ns, head, head_cap, iov, iovcnt);
+    // Todas las respuestas (RST, retransmisiones, caché) tienen la cabecera en iov[0]
+    if (res == 0) {
+        const uint8_t *out = iov[0].iov_base;
+        metrics_count_response(COAP_TYPE(out), COAP_CODE(out));
+    }
+    return res;
+}
+
+// respond_iov con la respuesta juntada en out (los envíos por lotes necesitan un solo buffer)
+static int respond_flat(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len, uint64_t received_ns,
+                        uint8_t *out, size_t *out_len, size_t max_len) {
+    struct iovec iov[2];
+    size_t iovcnt;
+    if (respond_iov(peer, in, in_len, received_ns, out, max_len, iov, &iovcnt) != 0) return -1;
+
+    size_t len = iov[0].iov_len;
+    if (iovcnt == 2) {
+        if (len + iov[1].iov_len > max_len) return -1;
+        memcpy(out + len, iov[1].iov_base, iov[1].iov_len);
+        len += iov[1].iov_len;
+    }
+    *out_len = len;
+    return 0;
+}
+
+int process_request_iov(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len,
+                        uint8_t *head, size_t head_cap, struct iovec iov[2], size_t *iovcnt) {
+    return respond_iov(peer, in, in_len, 0, head, head_cap, iov, iovcnt);
+}
+
+int process_request(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len,
+                    uint8_t *out, size_t *out_len, size_t max_len) {
+    return respond_flat(peer, in, in_len, 0, out, out_len, max_len);
+}
+
+// Cuerpo de los workers del pool: procesa un datagrama ya recibido
+void handle_client(void *arg) {
+    recv_slot_t *args = (recv_slot_t*) arg;
+    if (!args) {
+        log_text("[ERROR] Slot de recepción nulo");
+        return;
+    }
+
+    atomic_fetch_add(&active_threads, 1);
+
+    // La cabecera se arma en el stack y el payload sale desde donde lo dejó el handler
+    uint8_t head[MAX_BUF];
+    struct iovec iov[2];
+    size_t iovcnt;
+    if (respond_iov(&args->client_addr, args->buffer, args->buffer_len, args->received_ns,
+                    head, sizeof(head), iov, &iovcnt) == 0) {
+        uint64_t start = metrics_now_ns();
+        if (netio_sendv(args->sock, &args->client_addr, iov, iovcnt) < 0) {
             log_text("[ERROR] Error enviando respuesta: %s", strerror(errno));
         }
-    } else {
-        log_text("[ERROR] Error serializando respuesta CoAP");
+        metrics_record(METRIC_SEND, metrics_now_ns() - start, 1);
+    }
+    record_lane_latency(args, metrics_now_ns());
+
+    atomic_fetch_sub(&active_threads, 1);
+    slot_release(args);
+}
+
+// Variante por lotes: procesa varios datagramas y envía las respuestas con un solo sendmmsg
+void handle_client_batch(void **items, size_t count) {
+    uint8_t out[POOL_MAX_BATCH][MAX_BUF];
+    netio_msg_t msgs[POOL_MAX_BATCH];
+    size_t n = 0;
+    int sock = -1;
+
+    atomic_fetch_add(&active_threads, 1);
+
+    for (size_t i = 0; i < count; i++) {
+        recv_slot_t *slot = (recv_slot_t*) items[i];
+        sock = slot->sock;
+        if (respond_flat(&slot->client_addr, slot->buffer, slot->buffer_len, slot->received_ns,
+                         out[n], &msgs[n].len, MAX_BUF) == 0) {
+            msgs[n].buf = out[n];
+            msgs[n].addr = slot->client_addr;
+            n++;
+        }
+    }
+
+    if (n > 0) {
+        uint64_t start = metrics_now_ns();
+        if (netio_send_batch(sock, msgs, n) < (int) n) {
+            log_text("[ERROR] Error enviando respuestas: %s", strerror(errno));
+        }
+        metrics_record(METRIC_SEND, (metrics_now_ns() - start) / n, n);
+    }
+
+    uint64_t now = metrics_now_ns();
+    for (size_t i = 0; i < count; i++) {
+        record_lane_latency((recv_slot_t*) items[i], now);
+        slot_release((recv_slot_t*) items[i]);
+    }
+    atomic_fetch_sub(&active_threads, 1);
+}
+
+// Reservar los slots de recepción: uno por cada posición de la cola más uno por worker
+static int slots_init(size_t count) {
+    slots = calloc(count, sizeof(recv_slot_t));
+    if (!slots) return -1;
+    if (ring_init(&free_slots, count) != 0) {
+        free(slots);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) ring_push(&free_slots, &slots[i]);
+    slot_count = count;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [puerto] [log] [--workers N] [--queue N] [--batch N] [--gso] [--shards N] [--loop epoll|uring]\n"
+                    "          [--wal] [--commit-ms N] [--commit-bytes N] [--snapshot-interval S] [--timeseries]\n"
+                    "          [--log-level debug|info|warning|error|off] [--metrics-file ruta] [--metrics-interval S]\n"
+                    "          [--rate-limit R] [--burst B] [--separate-ms N]\n"
+                    "          [--query-workers N] [--query-queue N] [--lane-weights I:Q] [--no-lanes]\n", prog);
+}
+
+// Leer puerto y log (posicionales) y las opciones del servidor
+static int parse_args(int argc, char *argv[], server_config_t *cfg) {
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            cfg->workers = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            cfg->queue_size = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            cfg->batch = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            cfg->shards = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--loop") == 0 && i + 1 < argc) {
+            if (evloop_parse_backend(argv[++i], &cfg->loop) != 0) return -1;
+        } else if (strcmp(argv[i], "--wal") == 0) {
+            cfg->storage.wal = true;
+        } else if (strcmp(argv[i], "--commit-ms") == 0 && i + 1 < argc) {
+            cfg->storage.commit_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--commit-bytes") == 0 && i + 1 < argc) {
+            cfg->storage.commit_bytes = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--snapshot-interval") == 0 && i + 1 < argc) {
+            // Los snapshots compactan el WAL, así que lo activan
+            cfg->storage.snapshot_interval = strtoul(argv[++i], NULL, 10);
+            if (cfg->storage.snapshot_interval > 0) cfg->storage.wal = true;
+        } else if (strcmp(argv[i], "--timeseries") == 0) {
+            cfg->storage.timeseries = true;
+            cfg->storage.wal = true;
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            if (log_parse_level(argv[++i], &cfg->log_level) != 0) return -1;
+        } else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+            cfg->metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            cfg->metrics_interval = strtoul(argv[++i], NULL, 10);
+            if (cfg->metrics_interval == 0) return -1;
+        } else if (strcmp(argv[i], "--rate-limit") == 0 && i + 1 < argc) {
+            cfg->rate_limit = strtod(argv[++i], NULL);
+            if (cfg->rate_limit < 0) return -1;
+        } else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            cfg->burst = strtod(argv[++i], NULL);
+            if (cfg->burst < 0) return -1;
+        } else if (strcmp(argv[i], "--separate-ms") == 0 && i + 1 < argc) {
+            cfg->separate_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--query-workers") == 0 && i + 1 < argc) {
+            cfg->query_workers = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--query-queue") == 0 && i + 1 < argc) {
+            cfg->query_queue = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--lane-weights") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u:%u", &cfg->lane_weights[LANE_INGEST], &cfg->lane_weights[LANE_QUERY]) != 2 ||
+                cfg->lane_weights[LANE_INGEST] == 0 || cfg->lane_weights[LANE_QUERY] == 0) return -1;
+        } else if (strcmp(argv[i], "--no-lanes") == 0) {
+            cfg->no_lanes = true;
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            cfg->gso = true;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            return -1;
+        } else if (positional == 0) {
+            cfg->port = atoi(argv[i]);
+            positional++;
+        } else if (positional == 1) {
+            cfg->logpath = argv[i];
+            positional++;
+        } else {
+            return -1;
+        }
+    }
+    if (cfg->workers == 0 || cfg->queue_size == 0) return -1;
+    if (cfg->batch > NETIO_MAX_BATCH) cfg->batch = NETIO_MAX_BATCH;
+    if (cfg->batch == 1) cfg->batch = 0;
+    if (cfg->shards > MAX_SHARDS) return -1;
+    return 0;
+}
+
+// Reporte periódico: pool, E/S por lotes, shards y loops de eventos según el modo
+static void report_stats(void *ctx) {
+    (void) ctx;
+    if (pool) {
+        pool_stats_t st;
+        pool_get_stats(pool, &st);
+        log_text("[INFO] Pool: workers=%zu ocupados=%zu cola=%zu/%zu procesados=%llu descartados=%llu",
+                 st.workers, st.busy, st.queue_depth, st.queue_capacity,
+                 (unsigned long long) st.processed, (unsigned long long) st.dropped);
+        for (size_t lane = 0; pool_lane_count(pool) > 1 && lane < LANES; lane++) {
+            pool_stats_t ls;
+            metrics_stage_stats_t lat;
+            pool_get_lane_stats(pool, lane, &ls);
+            metrics_get_stage(lane == LANE_QUERY ? METRIC_QUERY : METRIC_INGEST, &lat);
+            log_text("[INFO] Carril %s: workers<=%zu ocupados=%zu cola=%zu/%zu procesados=%llu descartados=%llu "
+                     "p50=%.1fms p99=%.1fms",
+                     lane_names[lane], ls.workers, ls.busy, ls.queue_depth, ls.queue_capacity,
+                     (unsigned long long) ls.processed, (unsigned long long) ls.dropped,
+                     lat.p50 / 1e6, lat.p99 / 1e6);
+        }
+    }
+
+    netio_stats_t io;
+    netio_get_stats(&io);
+    if (io.recv_calls > 0 || io.send_calls > 0) {
+        log_text("[INFO] E/S por lotes: recv promedio=%.1f send promedio=%.1f envíos GSO=%llu",
+                 io.recv_calls ? (double) io.recv_dgrams / io.recv_calls : 0.0,
+                 io.send_calls ? (double) io.send_dgrams / io.send_calls : 0.0,
+                 (unsigned long long) io.gso_sends);
+    }
+
+    wal_stats_t ws;
+    wal_get_stats(&ws);
+    if (ws.records > 0) {
+        log_text("[INFO] WAL: registros=%llu fdatasync=%llu (%.1f registros por commit) bytes=%llu",
+                 (unsigned long long) ws.records, (unsigned long long) ws.syncs,
+                 ws.syncs ? (double) ws.records / ws.syncs : 0.0, (unsigned long long) ws.bytes);
+    }
+
+    series_stats_t ss;
+    storage_get_series_stats(&ss);
+    if (ss.points > 0) {
+        log_text("[INFO] Series: segmentos=%zu lecturas=%zu bytes=%zu (%.1f bytes por lectura)",
+                 ss.segments, ss.points, ss.bytes, (double) ss.bytes / ss.points);
+    }
+
+    partition_stats_t pt;
+    partition_get_stats(&pt);
+    if (pt.partitions > 0) {
+        log_text("[INFO] Particiones: sensores=%zu registros=%zu celdas=%zu reescrituras=%llu",
+                 pt.partitions, pt.records, pt.window_cells, (unsigned long long) pt.compactions);
+    }
+
+    observe_stats_t os;
+    observe_get_stats(&os);
+    if (os.rounds > 0 || os.observers > 0) {
+        log_text("[INFO] Observe: observadores=%zu recursos notificados=%llu notificaciones=%llu (CON=%llu) bajas=%llu",
+                 os.observers, (unsigned long long) os.rounds, (unsigned long long) os.notifications,
+                 (unsigned long long) os.confirmable, (unsigned long long) os.removed);
+    }
+
+    respcache_stats_t rs;
+    respcache_get_stats(&rs);
+    if (rs.hits > 0 || rs.misses > 0) {
+        log_text("[INFO] Caché GET: aciertos=%llu fallos=%llu invalidaciones=%llu entradas=%zu",
+                 (unsigned long long) rs.hits, (unsigned long long) rs.misses,
+                 (unsigned long long) rs.invalidations, rs.entries);
     }
 
-cleanup:
-    pthread_mutex_lock(&thread_count_mutex);
-    active_threads--;
-    pthread_mutex_unlock(&thread_count_mutex);
-    free(args);
-    return NULL;
+    exchange_stats_t es;
+    exchange_get_stats(&es);
+    if (es.replays > 0 || es.in_progress > 0) {
+        log_text("[INFO] Intercambios: en caché=%zu retransmisiones respondidas=%llu en curso=%llu descartados=%llu",
+                 es.entries, (unsigned long long) es.replays, (unsigned long long) es.in_progress,
+                 (unsigned long long) es.evicted);
+    }
+
+    separate_stats_t sp;
+    separate_get_stats(&sp);
+    if (sp.deferred > 0) {
+        log_text("[INFO] Respuestas separadas: enviadas=%llu retransmisiones=%llu ACK=%llu RST=%llu vencidas=%llu pendientes=%zu",
+                 (unsigned long long) sp.deferred, (unsigned long long) sp.retransmissions,
+                 (unsigned long long) sp.acked, (unsigned long long) sp.reset,
+                 (unsigned long long) sp.expired, sp.pending);
+    }
+
+    ratelimit_stats_t rl;
+    ratelimit_get_stats(&rl);
+    uint64_t overloaded = atomic_load_explicit(&overload_rejected, memory_order_relaxed);
+    if (rl.limited > 0 || overloaded > 0) {
+        log_text("[WARNING] Admisión: 5.03 por límite=%llu por cola llena=%llu endpoints=%zu reemplazados=%llu",
+                 (unsigned long long) rl.limited, (unsigned long long) overloaded, rl.endpoints,
+                 (unsigned long long) rl.evicted);
+    }
+
+    arena_stats_t as;
+    arena_get_stats(&as);
+    slab_stats_t sl;
+    slab_get_stats(&sl);
+    log_text("[INFO] Memoria: slots en uso=%zu máximo=%zu/%zu arena máximo=%zu/%d bytes fallbacks=%llu (%llu bytes) "
+             "slab bloques=%zu máximo=%zu chunks=%zu (%zu KB) fallbacks=%llu",
+             atomic_load_explicit(&slots_in_use, memory_order_relaxed),
+             atomic_load_explicit(&slots_high_water, memory_order_relaxed), slot_count,
+             as.high_water, ARENA_SIZE, (unsigned long long) as.fallbacks, (unsigned long long) as.fallback_bytes,
+             sl.in_use, sl.high_water, sl.chunks, sl.chunks * SLAB_CHUNK_SIZE / 1024, (unsigned long long) sl.fallbacks);
+
+    log_stats_t ls;
+    log_get_stats(&ls);
+    if (ls.dropped > 0) {
+        log_text("[WARNING] Log: líneas escritas=%llu descartadas=%llu (anillos llenos) lotes=%llu hilos=%zu",
+                 (unsigned long long) ls.written, (unsigned long long) ls.dropped,
+                 (unsigned long long) ls.batches, ls.threads);
+    }
+
+    shards_report();
+    evloop_report();
+}
+
+// SIGUSR1 baja el nivel mínimo del log (más detalle) y SIGUSR2 lo sube, sin reiniciar
+static void on_log_signal(int sig) {
+    log_level_t level = log_get_level();
+    if (sig == SIGUSR1 && level > LOG_DEBUG) log_set_level(level - 1);
+    if (sig == SIGUSR2 && level < LOG_OFF) log_set_level(level + 1);
+}
+
+// Cola llena: contestar 5.03 en vez de descartar en silencio
+static void reject_overloaded(int sock, const struct sockaddr_in *peer, const uint8_t *in, size_t in_len) {
+    atomic_fetch_add_explicit(&overload_rejected, 1, memory_order_relaxed);
+    reject_unavailable(sock, peer, in, in_len, OVERLOAD_MAX_AGE);
+}
+
+// Loop de recepción clásico: un recvfrom por datagrama
+static void receive_loop(int sock) {
+    uint8_t discard[MAX_BUF];
+
+    while (1) {
+        recv_slot_t *args = slot_take();
+        if (!args) {
+            // Todos los slots están en uso: leer sin bloquear a los demás y rechazar
+            struct sockaddr_in peer;
+            socklen_t peer_len = sizeof(peer);
+            ssize_t n = recvfrom(sock, discard, sizeof(discard), 0, (struct sockaddr*) &peer, &peer_len);
+            pool_count_drop(pool);
+            if (n > 0) reject_overloaded(sock, &peer, discard, (size_t) n);
+            continue;
+        }
+
+        args->sock = sock;
+        args->client_len = sizeof(args->client_addr);
+
+        ssize_t n = recvfrom(sock, args->buffer, MAX_BUF, 0,
+                             (struct sockaddr*) &args->client_addr, &args->client_len);
+
+        if (n > 0) {
+            args->buffer_len = (size_t) n;
+            args->received_ns = metrics_now_ns();
+            args->lane = request_lane(args->buffer, args->buffer_len);
+            if (rate_limited(sock, &args->client_addr, args->buffer, args->buffer_len)) {
+                slot_release(args);
+            } else if (pool_submit_lane(pool, args->lane, args) != 0) {
+                reject_overloaded(sock, &args->client_addr, args->buffer, args->buffer_len);
+                slot_release(args);
+            }
+        } else {
+            if (n < 0) log_text("[ERROR] Error recibiendo datos: %s", strerror(errno));
+            slot_release(args);
+        }
+    }
+}
+
+// Loop de recepción por lotes: un recvmmsg llena hasta batch slots
+static void receive_loop_batch(int sock, size_t batch) {
+    uint8_t discard[MAX_BUF];
+    recv_slot_t *taken[NETIO_MAX_BATCH];
+    netio_msg_t msgs[NETIO_MAX_BATCH];
+
+    while (1) {
+        size_t k = 0;
+        while (k < batch && (taken[k] = slot_take()) != NULL) {
+            msgs[k].buf = taken[k]->buffer;
+            msgs[k].cap = MAX_BUF;
+            k++;
+        }
+        if (k == 0) {
+            struct sockaddr_in peer;
+            socklen_t peer_len = sizeof(peer);
+            ssize_t n = recvfrom(sock, discard, sizeof(discard), 0, (struct sockaddr*) &peer, &peer_len);
+            pool_count_drop(pool);
+            if (n > 0) reject_overloaded(sock, &peer, discard, (size_t) n);
+            continue;
+        }
+
+        int n = netio_recv_batch(sock, msgs, k);
+        if (n < 0) {
+            log_text("[ERROR] Error recibiendo datos: %s", strerror(errno));
+            n = 0;
+        }
+
+        uint64_t received_ns = metrics_now_ns();
+        for (size_t i = 0; i < k; i++) {
+            recv_slot_t *slot = taken[i];
+            if ((int) i < n && msgs[i].len > 0) {
+                slot->sock = sock;
+                slot->client_addr = msgs[i].addr;
+                slot->client_len = sizeof(slot->client_addr);
+                slot->buffer_len = msgs[i].len;
+                slot->received_ns = received_ns;
+                slot->lane = request_lane(slot->buffer, slot->buffer_len);
+                if (rate_limited(sock, &slot->client_addr, slot->buffer, slot->buffer_len)) {
+                    slot_release(slot);
+                    continue;
+                }
+                if (pool_submit_lane(pool, slot->lane, slot) == 0) continue;
+                reject_overloaded(sock, &slot->client_addr, slot->buffer, slot->buffer_len);
+            }
+            slot_release(slot);
+        }
+    }
 }
 
 int main(int argc, char *argv[]) {
-    int port = SERVER_PORT;
-    const char *logpath = "server.log";
+    server_config_t cfg = {
+        .port = SERVER_PORT,
+        .logpath = "server.log",
+        .workers = DEFAULT_WORKERS,
+        .queue_size = DEFAULT_QUEUE,
+        .log_level = LOG_INFO,
+        .metrics_interval = 10,
+        .separate_ms = DEFAULT_SEPARATE_MS,
+        .lane_weights = { DEFAULT_INGEST_WEIGHT, DEFAULT_QUERY_WEIGHT },
+        .storage = { .wal = false, .commit_ms = 0, .commit_bytes = 64 * 1024 },
+    };
 
-    if (argc > 1) port = atoi(argv[1]);
-    if (argc > 2) logpath = argv[2];
+    if (parse_args(argc, argv, &cfg) != 0) {
+        usage(argv[0]);
+        exit(1);
+    }
+    int port = cfg.port;
+    const char *logpath = cfg.logpath;
 
     if (log_init(logpath) != 0) {
         perror("log_init");
         exit(1);
     }
 
-    logfile = fopen(logpath, "a");
-    if (!logfile) {
-        perror("fopen log");
+    log_set_level(cfg.log_level);
+    signal(SIGUSR1, on_log_signal);
+    signal(SIGUSR2, on_log_signal);
+
+    storage_set_options(&cfg.storage);
+    if (storage_init("data.json") != 0) {
+        perror("storage_init");
         exit(1);
     }
+    // Un segmento por sensor en data/ (data/<sensor>/<id>); con WAL cada escritura espera su fdatasync
+    if (partition_init("data", cfg.storage.wal || cfg.storage.timeseries) != 0) {
+        perror("partition_init");
+        exit(1);
+    }
+    if (exchange_init() != 0) {
+        perror("exchange_init");
+        exit(1);
+    }
+    if (respcache_init() != 0) {
+        perror("respcache_init");
+        exit(1);
+    }
+    if (ratelimit_init(cfg.rate_limit, cfg.burst > 0 ? cfg.burst : cfg.rate_limit) != 0) {
+        perror("ratelimit_init");
+        exit(1);
+    }
+    if (separate_init() != 0) {
+        perror("separate_init");
+        exit(1);
+    }
+    separate_threshold_ns = (uint64_t) cfg.separate_ms * 1000000ull;
+    if (observe_start(render_resource) != 0) {
+        perror("observe_start");
+        exit(1);
+    }
+    storage_set_listener(on_storage_change);
+    netio_set_gso(cfg.gso);
+    timer_register(STATS_INTERVAL * 1000, report_stats, NULL);
+    timer_register(1000, exchange_expire, NULL);
+    timer_register(SEPARATE_TICK_MS, separate_tick, NULL);
+    if (cfg.metrics_path) timer_register(cfg.metrics_interval * 1000, dump_metrics, (void*) cfg.metrics_path);
+
+    if (cfg.loop != EVLOOP_NONE) {
+        // Loop de eventos: un loop por core (o por shard pedido), sin hilos bloqueantes
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t loops = cfg.shards > 0 ? cfg.shards : (size_t) (cpus > 0 ? cpus : 1);
+        log_text("Servidor CoAP escuchando en el puerto %d, creando log en %s (loop=%s, loops=%zu, lote=%zu)",
+                 port, logpath, cfg.loop == EVLOOP_URING ? "io_uring" : "epoll", loops, cfg.batch);
+        evloop_run(port, loops, cfg.loop, cfg.batch);
+        perror("evloop_run");
+        exit(1);
+    }
+
+    if (timer_thread_start() != 0) {
+        perror("timer_thread_start");
+        exit(1);
+    }
+
+    if (cfg.shards > 0) {
+        // Modo multi-listener: cada shard recibe, procesa y responde en su propio core
+        if (shards_start(port, cfg.shards, cfg.batch) != 0) {
+            perror("shards_start");
+            exit(1);
+        }
+        log_text("Servidor CoAP escuchando en el puerto %d, creando log en %s (shards=%zu, lote=%zu)",
+                 port, logpath, cfg.shards, cfg.batch);
+        while (1) pause();
+    }
 
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) {
@@ -309,57 +1488,53 @@ int main(int argc, char *argv[]) {
         close(sock);
         exit(1);
     }
+    observe_set_socket(sock);
+    separate_set_socket(sock);
 
-    storage_init("data.json");
-
-    log_text("Servidor CoAP escuchando en el puerto %d, creando log en %s", port, logpath);
-
-    while (1) {
-        pthread_mutex_lock(&thread_count_mutex);
-        if (active_threads >= MAX_THREADS) {
-            pthread_mutex_unlock(&thread_count_mutex);
-            log_text("[WARNING] Límite de threads alcanzado (%d), esperando...", MAX_THREADS);
-            sleep(1);
-            continue;
-        }
-        pthread_mutex_unlock(&thread_count_mutex);
-
-        thread_args_t *args = malloc(sizeof(thread_args_t));
-        if (!args) {
-            log_text("[ERROR] Error asignando memoria para thread");
-            continue;
-        }
+    // Ingesta puede ocupar todos los workers; consultas sólo hasta su tope, con una cola propia
+    // más corta, así una exportación pesada no demora a los sensores
+    size_t lane_count = (cfg.no_lanes || cfg.workers < 2) ? 1 : LANES;
+    pool_lane_config_t lanes[LANES] = {
+        [LANE_INGEST] = { .queue_capacity = cfg.queue_size, .weight = cfg.lane_weights[LANE_INGEST] },
+        [LANE_QUERY] = {
+            .queue_capacity = cfg.query_queue ? cfg.query_queue : (cfg.queue_size >= 4 ? cfg.queue_size / 4 : 1),
+            .max_busy = cfg.query_workers ? cfg.query_workers : (cfg.workers >= 8 ? cfg.workers / 4 : 1),
+            .weight = cfg.lane_weights[LANE_QUERY],
+        },
+    };
+    size_t queued = 0;
+    for (size_t i = 0; i < lane_count; i++) queued += lanes[i].queue_capacity;
 
-        memset(args, 0, sizeof(thread_args_t));
-        args->sock = sock;
-        args->client_len = sizeof(args->client_addr);
+    if (slots_init(queued + cfg.workers) != 0) {
+        perror("slots_init");
+        exit(1);
+    }
 
-        args->buffer_len = recvfrom(sock, args->buffer, MAX_BUF, 0,
-                                   (struct sockaddr*) &args->client_addr, &args->client_len);
+    if (cfg.batch > 0) {
+        pool = pool_create_lanes(cfg.workers, lanes, lane_count, cfg.batch, NULL, handle_client_batch);
+    } else {
+        pool = pool_create_lanes(cfg.workers, lanes, lane_count, 1, handle_client, NULL);
+    }
+    if (!pool) {
+        perror("pool_create");
+        exit(1);
+    }
 
-        if (args->buffer_len > 0) {
-            if (args->buffer_len > MAX_BUF) {
-                log_text("[ERROR] Buffer demasiado grande: %zu bytes", args->buffer_len);
-                free(args);
-                continue;
-            }
+    log_text("Servidor CoAP escuchando en el puerto %d, creando log en %s (workers=%zu, cola=%zu, lote=%zu%s)",
+             port, logpath, cfg.workers, cfg.queue_size, cfg.batch, cfg.gso ? ", GSO" : "");
+    if (lane_count > 1) {
+        log_text("Carriles: consultas hasta %zu workers y cola de %zu, turnos ingesta:consultas %u:%u",
+                 lanes[LANE_QUERY].max_busy,
+                 lanes[LANE_QUERY].queue_capacity, cfg.lane_weights[LANE_INGEST], cfg.lane_weights[LANE_QUERY]);
+    }
 
-            pthread_t tid;
-            int result = pthread_create(&tid, NULL, handle_client, args);
-            if (result != 0) {
-                log_text("[ERROR] Error creando thread: %s", strerror(result));
-                free(args);
-            } else {
-                pthread_detach(tid);
-            }
-        } else if (args->buffer_len < 0) {
-            log_text("[ERROR] Error recibiendo datos: %s", strerror(errno));
-            free(args);
-        } else {
-            free(args);
-        }
+    if (cfg.batch > 0) {
+        receive_loop_batch(sock, cfg.batch);
+    } else {
+        receive_loop(sock);
     }
 
+    pool_destroy(pool);
     close(sock);
     return 0;
 }
@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+#define MAX_BUF 1500
+
+// Procesar un datagrama CoAP de peer y serializar la respuesta en out.
+// Retorna 0 si hay una respuesta que enviar, -1 si no.
+int process_request(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len,
+                    uint8_t *out, size_t *out_len, size_t max_len);
+
+// Igual que process_request, pero sin copiar el payload: la respuesta queda en iov
+// (cabecera y opciones en head, el payload donde lo dejó el handler) para enviarla con
+// sendmsg en el mismo hilo, antes de procesar otro pedido
+int process_request_iov(const struct sockaddr_in *peer, const uint8_t *in, size_t in_len,
+                        uint8_t *head, size_t head_cap, struct iovec iov[2], size_t *iovcnt);
+
+#endif
@@ -0,0 +1,202 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "shard.h"
+#include "server.h"
+#include "netio.h"
+#include "ring.h"
+#include "observe.h"
+#include "separate.h"
+#include "metrics.h"
+#include "log.h"
+
+// Estado de cada listener. Alineado a línea de caché para que los contadores
+// de un shard no invaliden los de sus vecinos
+typedef struct {
+    _Alignas(RING_CACHELINE) atomic_uint_fast64_t rx;
+    atomic_uint_fast64_t tx;
+    int sock;
+    int cpu;
+    size_t batch;
+    pthread_t tid;
+} shard_t;
+
+static shard_t shards[MAX_SHARDS];
+static size_t shard_count = 0;
+
+int shard_open_socket(int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+
+    int one = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct sockaddr_in servaddr;
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    servaddr.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr*) &servaddr, sizeof(servaddr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void shard_pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (res != 0) {
+        log_text("[WARNING] No se pudo fijar el hilo al core %d: %s", cpu, strerror(res));
+    }
+}
+
+// Un datagrama a la vez: recvfrom, procesar y sendto en el mismo hilo
+static void shard_loop_single(shard_t *sh) {
+    uint8_t in[MAX_BUF], head[MAX_BUF];
+    struct iovec iov[2];
+    size_t iovcnt;
+    struct sockaddr_in client;
+
+    while (1) {
+        socklen_t client_len = sizeof(client);
+        ssize_t n = recvfrom(sh->sock, in, sizeof(in), 0, (struct sockaddr*) &client, &client_len);
+        if (n <= 0) {
+            if (n < 0 && errno != EINTR) log_text("[ERROR] Shard %d: error recibiendo: %s", sh->cpu, strerror(errno));
+            continue;
+        }
+        atomic_fetch_add_explicit(&sh->rx, 1, memory_order_relaxed);
+
+        if (process_request_iov(&client, in, (size_t) n, head, sizeof(head), iov, &iovcnt) == 0) {
+            uint64_t start = metrics_now_ns();
+            if (netio_sendv(sh->sock, &client, iov, iovcnt) >= 0) {
+                atomic_fetch_add_explicit(&sh->tx, 1, memory_order_relaxed);
+            }
+            metrics_record(METRIC_SEND, metrics_now_ns() - start, 1);
+        }
+    }
+}
+
+// Por lotes: recvmmsg, procesar todo el lote y un solo sendmmsg
+static void shard_loop_batch(shard_t *sh) {
+    uint8_t (*in)[MAX_BUF] = malloc(NETIO_MAX_BATCH * MAX_BUF);
+    uint8_t (*out)[MAX_BUF] = malloc(NETIO_MAX_BATCH * MAX_BUF);
+    netio_msg_t rx[NETIO_MAX_BATCH], tx[NETIO_MAX_BATCH];
+
+    if (!in || !out) {
+        log_text("[ERROR] Shard %d: sin memoria para los buffers del lote", sh->cpu);
+        free(in);
+        free(out);
+        return;
+    }
+
+    while (1) {
+        for (size_t i = 0; i < sh->batch; i++) {
+            rx[i].buf = in[i];
+            rx[i].cap = MAX_BUF;
+        }
+        int n = netio_recv_batch(sh->sock, rx, sh->batch);
+        if (n <= 0) {
+            if (n < 0) log_text("[ERROR] Shard %d: error recibiendo: %s", sh->cpu, strerror(errno));
+            continue;
+        }
+        atomic_fetch_add_explicit(&sh->rx, n, memory_order_relaxed);
+
+        size_t k = 0;
+        for (int i = 0; i < n; i++) {
+            if (process_request(&rx[i].addr, rx[i].buf, rx[i].len, out[k], &tx[k].len, MAX_BUF) == 0) {
+                tx[k].buf = out[k];
+                tx[k].addr = rx[i].addr;
+                k++;
+            }
+        }
+        uint64_t start = metrics_now_ns();
+        int sent = netio_send_batch(sh->sock, tx, k);
+        if (sent > 0) atomic_fetch_add_explicit(&sh->tx, sent, memory_order_relaxed);
+        if (k > 0) metrics_record(METRIC_SEND, (metrics_now_ns() - start) / k, k);
+    }
+}
+
+static void *shard_main(void *arg) {
+    shard_t *sh = (shard_t*) arg;
+    shard_pin_cpu(sh->cpu);
+    if (sh->batch > 1) {
+        shard_loop_batch(sh);
+    } else {
+        shard_loop_single(sh);
+    }
+    return NULL;
+}
+
+int shards_start(int port, size_t count, size_t batch) {
+    if (count == 0 || count > MAX_SHARDS) return -1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        shard_t *sh = &shards[i];
+        sh->sock = shard_open_socket(port);
+        if (sh->sock < 0) {
+            log_text("[ERROR] Shard %zu: no se pudo abrir el socket: %s", i, strerror(errno));
+            return -1;
+        }
+        if (i == 0) {   // las notificaciones y las respuestas separadas salen por el primer shard
+            observe_set_socket(sh->sock);
+            separate_set_socket(sh->sock);
+        }
+        sh->cpu = (int) (i % (size_t) cpus);
+        sh->batch = batch;
+        atomic_init(&sh->rx, 0);
+        atomic_init(&sh->tx, 0);
+
+        int res = pthread_create(&sh->tid, NULL, shard_main, sh);
+        if (res != 0) {
+            log_text("[ERROR] Shard %zu: error creando thread: %s", i, strerror(res));
+            close(sh->sock);
+            return -1;
+        }
+        pthread_detach(sh->tid);
+        shard_count++;
+    }
+    return 0;
+}
+
+void shards_report(void) {
+    uint64_t total = 0, min = UINT64_MAX, max = 0;
+    uint64_t rx[MAX_SHARDS];
+
+    for (size_t i = 0; i < shard_count; i++) {
+        rx[i] = atomic_load_explicit(&shards[i].rx, memory_order_relaxed);
+        total += rx[i];
+        if (rx[i] < min) min = rx[i];
+        if (rx[i] > max) max = rx[i];
+    }
+    if (shard_count == 0 || total == 0) return;
+
+    for (size_t i = 0; i < shard_count; i++) {
+        log_text("[INFO] Shard %zu (core %d): recibidos=%llu enviados=%llu (%.1f%%)", i, shards[i].cpu,
+                 (unsigned long long) rx[i],
+                 (unsigned long long) atomic_load_explicit(&shards[i].tx, memory_order_relaxed),
+                 100.0 * rx[i] / total);
+    }
+    // max/promedio: 1.0 es un reparto perfecto
+    double mean = (double) total / shard_count;
+    log_text("[INFO] Shards: total=%llu min=%llu max=%llu desbalance=%.2f",
+             (unsigned long long) total, (unsigned long long) min, (unsigned long long) max, max / mean);
+}
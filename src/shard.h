@@ -0,0 +1,22 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_SHARDS 64
+
+// Abrir un socket UDP con SO_REUSEPORT ligado al puerto dado
+int shard_open_socket(int port);
+
+// Fijar el hilo actual a un core
+void shard_pin_cpu(int cpu);
+
+// Arrancar count listeners SO_REUSEPORT, cada uno con su hilo fijado a un core.
+// batch > 1 usa recvmmsg/sendmmsg dentro de cada shard.
+int shards_start(int port, size_t count, size_t batch);
+
+// Registrar en el log los contadores por shard y qué tan pareja es la distribución
+void shards_report(void);
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "slab.h"
+
+#define HEADER 8                     // clase del bloque (SLAB_CLASSES = malloc directo)
+
+typedef struct block {
+    struct block *next;
+} block_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    block_t *free_list;
+    uint8_t *carve;                  // resto sin cortar del último chunk
+    size_t carve_left;
+    size_t in_use, high_water, chunks;
+} slab_class_t;
+
+static slab_class_t classes[SLAB_CLASSES] = {
+    [0 ... SLAB_CLASSES - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+static pthread_mutex_t fallback_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t fallbacks = 0;
+
+// Clase más chica en la que entra size más la cabecera (o SLAB_CLASSES si ninguna)
+static size_t class_of(size_t size) {
+    size_t block_size = SLAB_MIN;
+    size_t c = 0;
+    while (c < SLAB_CLASSES && block_size < size + HEADER) {
+        block_size <<= 1;
+        c++;
+    }
+    return c;
+}
+
+void *slab_alloc(size_t size) {
+    size_t c = size <= SLAB_MAX ? class_of(size) : SLAB_CLASSES;
+    uint8_t *block;
+
+    if (c == SLAB_CLASSES) {
+        block = malloc(size + HEADER);
+        if (!block) return NULL;
+        pthread_mutex_lock(&fallback_lock);
+        fallbacks++;
+        pthread_mutex_unlock(&fallback_lock);
+    } else {
+        slab_class_t *sc = &classes[c];
+        size_t block_size = (size_t) SLAB_MIN << c;
+        pthread_mutex_lock(&sc->lock);
+        if (sc->free_list) {
+            block = (uint8_t*) sc->free_list;
+            sc->free_list = sc->free_list->next;
+        } else {
+            if (sc->carve_left < block_size) {
+                uint8_t *chunk = malloc(SLAB_CHUNK_SIZE);
+                if (!chunk) {
+                    pthread_mutex_unlock(&sc->lock);
+                    return NULL;
+                }
+                sc->carve = chunk;
+                sc->carve_left = SLAB_CHUNK_SIZE;
+                sc->chunks++;
+            }
+            block = sc->carve;
+            sc->carve += block_size;
+            sc->carve_left -= block_size;
+        }
+        if (++sc->in_use > sc->high_water) sc->high_water = sc->in_use;
+        pthread_mutex_unlock(&sc->lock);
+    }
+
+    *(uint64_t*) block = c;
+    return block + HEADER;
+}
+
+void slab_free(void *ptr) {
+    if (!ptr) return;
+    uint8_t *block = (uint8_t*) ptr - HEADER;
+    size_t c = (size_t) *(uint64_t*) block;
+    if (c >= SLAB_CLASSES) {
+        free(block);
+        return;
+    }
+
+    slab_class_t *sc = &classes[c];
+    block_t *b = (block_t*) block;
+    pthread_mutex_lock(&sc->lock);
+    b->next = sc->free_list;
+    sc->free_list = b;
+    sc->in_use--;
+    pthread_mutex_unlock(&sc->lock);
+}
+
+char *slab_strndup(const char *s, size_t n) {
+    const char *end = memchr(s, '\0', n);
+    if (end) n = (size_t) (end - s);
+    char *copy = slab_alloc(n + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+void slab_get_stats(slab_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+    for (size_t c = 0; c < SLAB_CLASSES; c++) {
+        slab_class_t *sc = &classes[c];
+        pthread_mutex_lock(&sc->lock);
+        st->in_use += sc->in_use;
+        st->high_water += sc->high_water;
+        st->chunks += sc->chunks;
+        pthread_mutex_unlock(&sc->lock);
+    }
+    pthread_mutex_lock(&fallback_lock);
+    st->fallbacks = fallbacks;
+    pthread_mutex_unlock(&fallback_lock);
+}
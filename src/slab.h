@@ -0,0 +1,36 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bloques de tamaño fijo por clase (potencias de dos de SLAB_MIN a SLAB_MAX bytes, cabecera
+// incluida) para la memoria que vive más que un pedido: los valores de los registros y las
+// respuestas guardadas de los intercambios. Cada clase corta chunks de SLAB_CHUNK_SIZE en
+// bloques y los liberados vuelven a la lista de su clase, así que en régimen estable no se
+// vuelve al heap. Los chunks no se devuelven nunca; lo que supera SLAB_MAX va a malloc.
+
+#define SLAB_MIN 16
+#define SLAB_MAX 2048
+#define SLAB_CLASSES 8               // 16, 32, ..., 2048
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+    size_t in_use;                   // bloques entregados
+    size_t high_water;               // máximo de bloques entregados (suma de las clases)
+    size_t chunks;
+    uint64_t fallbacks;              // pedidos más grandes que SLAB_MAX
+} slab_stats_t;
+
+// Reservar size bytes (alineados a 8). Retorna NULL si no hay memoria
+void *slab_alloc(size_t size);
+
+// Devolver un bloque de slab_alloc (NULL no hace nada)
+void slab_free(void *ptr);
+
+// Copia de los primeros n bytes de s terminada en '\0', en un bloque del slab
+char *slab_strndup(const char *s, size_t n);
+
+void slab_get_stats(slab_stats_t *st);
+
+#endif
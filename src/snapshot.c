@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC 0x504E5343u   // "CSNP"
+#define SNAPSHOT_VERSION 1
+#define WRITE_BUFFER (1 << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    int32_t next_id;
+    uint32_t reserved;
+} snapshot_header_t;
+
+#define RECORD_HEADER 14
+
+struct snapshot_writer {
+    FILE *file;
+    char path[280];
+    char tmp[288];
+    uint64_t count;
+};
+
+snapshot_writer_t *snapshot_begin(const char *path) {
+    snapshot_writer_t *w = calloc(1, sizeof(snapshot_writer_t));
+    if (!w) return NULL;
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", path);
+
+    w->file = fopen(w->tmp, "w");
+    if (!w->file) {
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->file, NULL, _IOFBF, WRITE_BUFFER);
+
+    // La cabecera definitiva se escribe en snapshot_commit
+    snapshot_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (fwrite(&hdr, sizeof(hdr), 1, w->file) != 1) {
+        snapshot_abort(w);
+        return NULL;
+    }
+    return w;
+}
+
+int snapshot_put(snapshot_writer_t *w, int id, time_t ts, const char *value) {
+    size_t len = strlen(value);
+    if (len > 0xFFFF) return -1;
+
+    uint8_t hdr[RECORD_HEADER];
+    int32_t id32 = id;
+    int64_t ts64 = (int64_t) ts;
+    uint16_t vlen = (uint16_t) len;
+    memcpy(hdr, &id32, 4);
+    memcpy(hdr + 4, &ts64, 8);
+    memcpy(hdr + 12, &vlen, 2);
+
+    if (fwrite(hdr, RECORD_HEADER, 1, w->file) != 1) return -1;
+    if (fwrite(value, 1, len + 1, w->file) != len + 1) return -1;
+    w->count++;
+    return 0;
+}
+
+int snapshot_commit(snapshot_writer_t *w, int next_id) {
+    snapshot_header_t hdr = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .count = w->count,
+        .next_id = next_id,
+    };
+    int res = 0;
+    if (fseek(w->file, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, w->file) != 1) res = -1;
+    if (res == 0 && (fflush(w->file) != 0 || fsync(fileno(w->file)) != 0)) res = -1;
+    if (fclose(w->file) != 0) res = -1;
+    if (res == 0) res = rename(w->tmp, w->path);
+    if (res != 0) remove(w->tmp);
+    free(w);
+    return res;
+}
+
+void snapshot_abort(snapshot_writer_t *w) {
+    if (!w) return;
+    fclose(w->file);
+    remove(w->tmp);
+    free(w);
+}
+
+int snapshot_open(const char *path, snapshot_t *snap) {
+    memset(snap, 0, sizeof(*snap));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return (errno == ENOENT) ? -2 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    snapshot_header_t hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if (hdr.magic != SNAPSHOT_MAGIC || hdr.version != SNAPSHOT_VERSION) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    snap->base = base;
+    snap->size = (size_t) st.st_size;
+    snap->count = hdr.count;
+    snap->next_id = hdr.next_id;
+    return 0;
+}
+
+int snapshot_foreach(const snapshot_t *snap, snapshot_record_cb cb, void *ctx) {
+    size_t off = sizeof(snapshot_header_t);
+    for (uint64_t i = 0; i < snap->count; i++) {
+        if (off + RECORD_HEADER > snap->size) return -1;
+        int32_t id;
+        int64_t ts;
+        uint16_t vlen;
+        memcpy(&id, snap->base + off, 4);
+        memcpy(&ts, snap->base + off + 4, 8);
+        memcpy(&vlen, snap->base + off + 12, 2);
+        off += RECORD_HEADER;
+        if (off + vlen + 1 > snap->size || snap->base[off + vlen] != '\0') return -1;
+
+        if (cb(id, (time_t) ts, (const char*) snap->base + off, ctx) != 0) return -1;
+        off += vlen + 1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Snapshot binario compacto de los registros vivos.
+// Formato: cabecera (magic, versión, cantidad, next_id) y luego por registro
+// id (4) | ts (8) | value_len (2) | value + '\0'
+
+typedef struct snapshot_writer snapshot_writer_t;
+
+// Empezar un snapshot nuevo (se escribe en path.tmp)
+snapshot_writer_t *snapshot_begin(const char *path);
+
+// Agregar un registro al snapshot
+int snapshot_put(snapshot_writer_t *w, int id, time_t ts, const char *value);
+
+// Completar la cabecera, sincronizar a disco y reemplazar el snapshot anterior de forma atómica
+int snapshot_commit(snapshot_writer_t *w, int next_id);
+
+// Descartar un snapshot a medio escribir
+void snapshot_abort(snapshot_writer_t *w);
+
+// Snapshot abierto con mmap. La memoria queda mapeada mientras viva el proceso,
+// así los valores se pueden usar directamente sin copiarlos
+typedef struct {
+    const uint8_t *base;
+    size_t size;
+    uint64_t count;
+    int next_id;
+} snapshot_t;
+
+// Callback por registro; value apunta dentro del mapeo y termina en '\0'
+typedef int (*snapshot_record_cb)(int id, time_t ts, const char *value, void *ctx);
+
+// Mapear un snapshot y validar su cabecera. Retorna -2 si no existe
+int snapshot_open(const char *path, snapshot_t *snap);
+
+// Recorrer los registros del snapshot
+int snapshot_foreach(const snapshot_t *snap, snapshot_record_cb cb, void *ctx);
+
+#endif
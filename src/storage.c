@@ -1,40 +1,187 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdarg.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
 #include "storage.h"
-
-// Mutex para proteger operaciones de archivo
-static pthread_mutex_t storage_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static int entry_count = 0;
+#include "wal.h"
+#include "snapshot.h"
+#include "series.h"
+#include "rollup.h"
+#include "slab.h"
+
+#define INITIAL_CAPACITY 1024
+#define SLOT_EMPTY 0
+
+// Un registro en memoria. id = 0 marca una celda vacía.
+// owned = false cuando value apunta dentro del snapshot mapeado (no se libera)
+typedef struct {
+    int id;
+    bool owned;
+    time_t ts;
+    char *value;
+} record_t;
+
+// Tabla hash de direccionamiento abierto (sondeo lineal) indexada por id. Los borrados
+// corren hacia atrás las celdas siguientes del grupo en vez de dejar tombstones, así que
+// borrar y agregar en régimen estable nunca obliga a rehacer la tabla
+static record_t *table = NULL;
+static size_t capacity = 0;
+static size_t entry_count = 0;      // registros vivos
 static int next_id = 1;
-static char filename[256];
+
+// Lectores (GET) en paralelo, escritores exclusivos. Con preferencia de escritura: un
+// escritor que espera frena a los lectores nuevos, así una racha de consultas (exportaciones)
+// no deja sin turno a la ingesta. Ningún camino toma el lock de lectura dos veces
+static pthread_rwlock_t storage_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
 
 // Nombre del archivo global
 static char storage_file[256];
+static char wal_file[272];
+static char wal_old_file[280];
+static char snapshot_file[272];
+static char series_file[272];
+
+static storage_options_t options = { .wal = false, .commit_ms = 0, .commit_bytes = 64 * 1024 };
+static storage_listener_t listener = NULL;
+
+// Mientras el compactor recorre su copia de la tabla, los valores reemplazados o
+// borrados no se liberan todavía: se acumulan aquí hasta que termine
+static bool compacting = false;
+static char **deferred = NULL;
+static size_t deferred_len = 0, deferred_cap = 0;
+
+static void release_value(record_t *rec) {
+    if (rec->owned && rec->value) {
+        if (compacting) {
+            if (deferred_len == deferred_cap) {
+                size_t cap = deferred_cap ? deferred_cap * 2 : 64;
+                char **grown = realloc(deferred, cap * sizeof(char*));
+                if (grown) {
+                    deferred = grown;
+                    deferred_cap = cap;
+                }
+            }
+            // Sin memoria para diferir: se pierde el valor (fuga) antes que arriesgar un uso después de liberar
+            if (deferred_len < deferred_cap) deferred[deferred_len++] = rec->value;
+        } else {
+            slab_free(rec->value);
+        }
+    }
+    rec->value = NULL;
+    rec->owned = false;
+}
 
-// Inicialización
-int storage_init(const char *filename) {
-    strncpy(storage_file, filename, sizeof(storage_file)-1);
-    // Si el archivo no existe, crear con un array vacío
-    FILE *archivo = fopen(storage_file, "r");
-    if (!archivo) {
-        archivo = fopen(storage_file, "w");
-        if (!archivo) return -1;
-        fprintf(archivo, "[]");
+static size_t hash_id(int id) {
+    return ((uint32_t) id * 2654435761u) & (capacity - 1);
+}
+
+// Buscar la celda de un id (o NULL si no existe)
+static record_t *table_find(int id) {
+    if (!table) return NULL;
+    size_t i = hash_id(id);
+    while (table[i].id != SLOT_EMPTY) {
+        if (table[i].id == id) return &table[i];
+        i = (i + 1) & (capacity - 1);
     }
-    fclose(archivo);
+    return NULL;
+}
+
+static int table_resize(size_t new_capacity) {
+    record_t *old = table;
+    size_t old_capacity = capacity;
+
+    table = calloc(new_capacity, sizeof(record_t));
+    if (!table) {
+        table = old;
+        return -1;
+    }
+    capacity = new_capacity;
+
+    for (size_t j = 0; j < old_capacity; j++) {
+        if (old[j].id > 0) {
+            size_t i = hash_id(old[j].id);
+            while (table[i].id != SLOT_EMPTY) i = (i + 1) & (capacity - 1);
+            table[i] = old[j];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+// Asegurar capacidad para n registros sin superar 70% de ocupación
+static int table_reserve(size_t n) {
+    size_t new_capacity = capacity ? capacity : INITIAL_CAPACITY;
+    while (n * 10 >= new_capacity * 7) new_capacity <<= 1;
+    if (new_capacity == capacity) return 0;
+    return table_resize(new_capacity);
+}
+
+// Insertar un registro nuevo (el id no debe existir). Toma posesión de value si owned
+static int table_insert(int id, time_t ts, char *value, bool owned) {
+    // Crecer al superar 70% de ocupación
+    if (table_reserve(entry_count + 1) != 0) return -1;
+
+    size_t i = hash_id(id);
+    while (table[i].id != SLOT_EMPTY) i = (i + 1) & (capacity - 1);
+    table[i].id = id;
+    table[i].ts = ts;
+    table[i].value = value;
+    table[i].owned = owned;
+    entry_count++;
+    if (id >= next_id) next_id = id + 1;
     return 0;
 }
 
-// Función auxiliar: leer todo el archivo en memoria (thread-safe)
+// Borrar la celda y correr hacia ella las siguientes del grupo que quedarían fuera de su
+// secuencia de sondeo (borrado hacia atrás de Knuth, sin tombstones)
+static void table_remove(record_t *rec) {
+    release_value(rec);
+    size_t i = (size_t) (rec - table);
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & (capacity - 1);
+        if (table[j].id == SLOT_EMPTY) break;
+        size_t home = hash_id(table[j].id);
+        // La celda j puede quedarse si su posición ideal está entre el hueco y ella
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    memset(&table[i], 0, sizeof(record_t));
+    entry_count--;
+}
+
+// Timestamp ISO simple
+static void format_timestamp(time_t t, char *buf, size_t max) {
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(buf, max, "%Y-%m-%dT%H:%M:%S", &tm_info);
+}
+
+static time_t parse_timestamp(const char *s) {
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    if (!strptime(s, "%Y-%m-%dT%H:%M:%S", &tm_info)) return 0;
+    tm_info.tm_isdst = -1;
+    return mktime(&tm_info);
+}
+
+// Función auxiliar: leer todo el archivo en memoria
 static char *read_file() {
     FILE *archivo = fopen(storage_file, "r");
     if (!archivo) return NULL;
-    
+
     fseek(archivo, 0, SEEK_END);
     long len = ftell(archivo);
     rewind(archivo);
@@ -44,268 +191,559 @@ static char *read_file() {
         fclose(archivo);
         return NULL;
     }
-    
+
     size_t bytes_read = fread(buf, 1, len, archivo);
     buf[bytes_read] = '\0';
     fclose(archivo);
     return buf;
 }
 
-// Función auxiliar: sobrescribir archivo (thread-safe)
-static int write_file(const char *content) {
-    FILE *archivo = fopen(storage_file, "w");
-    if (!archivo) return -1;
-    
-    size_t len = strlen(content);
-    size_t written = fwrite(content, 1, len, archivo);
-    fclose(archivo);
-    
-    return (written == len) ? 0 : -1;
+// Cargar los registros del JSON existente en la tabla (una sola vez, en storage_init)
+static int load_file(void) {
+    char *data = read_file();
+    if (!data) return -1;
+
+    char *p = data;
+    while ((p = strstr(p, "\"id\":"))) {
+        int id = atoi(p + 5);
+        char *obj_end = strchr(p, '}');
+        if (!obj_end) break;
+
+        time_t ts = 0;
+        char *ts_start = strstr(p, "\"ts\":\"");
+        if (ts_start && ts_start < obj_end) ts = parse_timestamp(ts_start + 6);
+
+        char *val = strstr(p, "\"value\":\"");
+        if (id > 0 && val && val < obj_end) {
+            val += 9;
+            char *end = strchr(val, '"');
+            if (end) {
+                char *value = slab_strndup(val, end - val);
+                if (!value || table_insert(id, ts, value, true) != 0) {
+                    slab_free(value);
+                    free(data);
+                    return -1;
+                }
+            }
+        }
+        p = obj_end;
+    }
+    free(data);
+    return 0;
 }
 
-// Generar timestamp ISO simple
-static void get_timestamp(char *buf, size_t max) {
-    time_t t = time(NULL);
-    struct tm *tm_info = localtime(&t);
-    strftime(buf, max, "%Y-%m-%dT%H:%M:%S", tm_info);
+// Buffer de salida de write_file: se llama con el lock de escritura tomado (o al arrancar),
+// así que alcanza con uno solo y la reescritura no pide memoria en cada mutación
+static char out_buf[64 * 1024];
+static size_t out_len = 0;
+
+static int out_flush(int fd) {
+    size_t off = 0;
+    while (off < out_len) {
+        ssize_t n = write(fd, out_buf + off, out_len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            out_len = 0;
+            return -1;
+        }
+        off += (size_t) n;
+    }
+    out_len = 0;
+    return 0;
 }
 
-// Agregar un dato (POST) - Thread-safe
-int storage_add(const char *value) {
-    if (!value) return -1;
-    
-    pthread_mutex_lock(&storage_mutex);
-    
-    char *data = read_file();
-    if (!data) {
-        pthread_mutex_unlock(&storage_mutex);
-        return -1;
+static int out_append(int fd, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out_buf + out_len, sizeof(out_buf) - out_len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return -1;
+    if ((size_t) n >= sizeof(out_buf) - out_len) {
+        // No entró: vaciar y volver a formatear desde el principio del buffer
+        if (out_flush(fd) != 0) return -1;
+        va_start(ap, fmt);
+        n = vsnprintf(out_buf, sizeof(out_buf), fmt, ap);
+        va_end(ap);
+        if (n < 0 || (size_t) n >= sizeof(out_buf)) return -1;
     }
+    out_len += (size_t) n;
+    return 0;
+}
 
-    // Buscar último id
-    int last_id = 0;
-    char *p = data;
-    while ((p = strstr(p, "\"id\":"))) {
-        int id = atoi(p+5);
-        if (id > last_id) last_id = id;
-        p++;
-    }
-
-    int new_id = last_id + 1;
-    char ts[64];
-    get_timestamp(ts, sizeof(ts));
-
-    // Crear nuevo objeto JSON con validación de tamaño
-    char entry[512];
-    int entry_len = snprintf(entry, sizeof(entry),
-        "{\"id\":%d,\"ts\":\"%s\",\"value\":\"%s\"}",
-        new_id, ts, value);
-    
-    if (entry_len >= sizeof(entry)) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -1; // Buffer overflow
-    }
-
-    // Construir nuevo JSON de forma segura
-    size_t data_len = strlen(data);
-    size_t new_len = data_len + entry_len + 10; // espacio extra para comas y brackets
-    
-    char *new_data = malloc(new_len);
-    if (!new_data) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
+// Sobrescribir el archivo con el contenido de la tabla, en orden de id.
+// Se escribe a un temporal y se renombra para no dejar el JSON a medias.
+// Con sync el contenido queda en disco antes del rename (checkpoint del WAL)
+static int write_file(bool sync) {
+    char tmp[sizeof(storage_file) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", storage_file);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    out_len = 0;
+    int res = out_append(fd, "[");
+    bool first = true;
+    char ts[32];
+    for (int id = 1; res == 0 && id < next_id; id++) {
+        record_t *rec = table_find(id);
+        if (!rec) continue;
+        format_timestamp(rec->ts, ts, sizeof(ts));
+        res = out_append(fd, "%s{\"id\":%d,\"ts\":\"%s\",\"value\":\"%s\"}",
+                         first ? "" : ",", rec->id, ts, rec->value);
+        first = false;
+    }
+    if (res == 0) res = out_append(fd, "]");
+    if (res == 0) res = out_flush(fd);
+    if (res == 0 && sync && fsync(fd) != 0) res = -1;
+    if (close(fd) != 0) res = -1;
+    if (res != 0) {
+        remove(tmp);
         return -1;
     }
+    return rename(tmp, storage_file);
+}
 
-    if (data_len <= 2) {
-        // archivo vacío: []
-        snprintf(new_data, new_len, "[%s]", entry);
-    } else {
-        data[data_len-1] = '\0'; // quitar ']'
-        snprintf(new_data, new_len, "%s,%s]", data, entry);
+// Reaplicar un registro del WAL sobre la tabla. Es idempotente: un ADD de un id
+// existente lo reemplaza y un DELETE de un id inexistente se ignora
+static int apply_wal_record(const wal_record_t *rec, void *ctx) {
+    (void) ctx;
+    record_t *found = table_find(rec->id);
+
+    if (rec->op == WAL_OP_DELETE) {
+        if (found) {
+            table_remove(found);
+        } else if (options.timeseries) {
+            series_delete(rec->id);
+        }
+        return 0;
     }
 
-    int response = write_file(new_data);
-    free(data);
-    free(new_data);
-    
-    pthread_mutex_unlock(&storage_mutex);
-    return response;
-}
+    // Lecturas numéricas: ya selladas en un segmento o se vuelven a agregar a la serie
+    if (options.timeseries && rec->op == WAL_OP_ADD && !found) {
+        if (series_contains(rec->id)) return 0;
+        char text[32];
+        double number;
+        if (rec->value_len < sizeof(text)) {
+            memcpy(text, rec->value, rec->value_len);
+            text[rec->value_len] = '\0';
+            int decimals;
+            if (series_parse_value(text, &number, &decimals) && series_append(rec->id, rec->ts, number, decimals) == 0) {
+                if (rec->id >= next_id) next_id = rec->id + 1;
+                return 0;
+            }
+        }
+    }
 
-// Obtener un valor por id - Thread-safe
-int storage_get(int id, char *out, size_t max_len) {
-    if (!out || max_len == 0) return -1;
-    
-    pthread_mutex_lock(&storage_mutex);
-    
-    char *data = read_file();
-    if (!data) {
-        pthread_mutex_unlock(&storage_mutex);
+    char *value = slab_strndup(rec->value, rec->value_len);
+    if (!value) return -1;
+
+    if (found) {
+        release_value(found);
+        found->value = value;
+        found->owned = true;
+        if (rec->op == WAL_OP_ADD) found->ts = rec->ts;
+        return 0;
+    }
+    time_t ts = rec->ts;
+    if (rec->op == WAL_OP_UPDATE) {
+        // Un PUT sobre una lectura comprimida la pasa a la tabla de strings
+        if (!options.timeseries || series_get(rec->id, &ts, NULL, NULL) != 0) {
+            slab_free(value);
+            return 0;
+        }
+        series_delete(rec->id);
+    }
+    if (table_insert(rec->id, ts, value, true) != 0) {
+        slab_free(value);
         return -1;
     }
+    return 0;
+}
+
+// Cargar un registro del snapshot: el valor queda apuntando al mapeo, sin copiarlo
+static int load_snapshot_record(int id, time_t ts, const char *value, void *ctx) {
+    (void) ctx;
+    return table_insert(id, ts, (char*) value, false);
+}
 
-    char key[16];
-    snprintf(key, sizeof(key), "\"id\":%d", id);
+// Cargar el snapshot si existe. Retorna 1 si se usó, 0 si no hay snapshot, -1 si falla
+static int load_snapshot(void) {
+    snapshot_t snap;
+    int res = snapshot_open(snapshot_file, &snap);
+    if (res == -2) return 0;
+    if (res != 0) return -1;
+
+    if (table_reserve(snap.count) != 0) return -1;
+    if (snapshot_foreach(&snap, load_snapshot_record, NULL) != 0) return -1;
+    if (snap.next_id > next_id) next_id = snap.next_id;
+    return 1;
+}
 
-    char *p = strstr(data, key);
-    if (!p) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -2; // no encontrado
+// true si el texto es un número (para los agregados por minuto/hora)
+static bool parse_number(const char *text, double *value) {
+    char *end;
+    if (!text || !*text) return false;
+    *value = strtod(text, &end);
+    return *end == '\0' && isfinite(*value);
+}
+
+static void rollup_series_point(int id, time_t ts, double value, int decimals, void *ctx) {
+    (void) id;
+    (void) decimals;
+    (void) ctx;
+    rollup_add(ts, value);
+}
+
+// Reconstruir los agregados con las lecturas vivas cargadas al arrancar
+static void rebuild_rollups(void) {
+    double number;
+    for (size_t i = 0; i < capacity; i++) {
+        if (table[i].id > 0 && parse_number(table[i].value, &number)) rollup_add(table[i].ts, number);
     }
+    if (options.timeseries) series_foreach(rollup_series_point, NULL);
+}
+
+// Persistir una mutación ya aplicada en memoria (se llama con el lock de escritura tomado).
+// En modo WAL retorna el LSN a esperar; en modo JSON reescribe el archivo y retorna 0
+static long long persist(wal_op_t op, const record_t *rec, int id) {
+    if (!options.wal) return write_file(false);
+
+    wal_record_t wrec = {
+        .op = op,
+        .id = id,
+        .ts = rec ? rec->ts : 0,
+        .value = rec ? rec->value : NULL,
+        .value_len = rec ? strlen(rec->value) : 0,
+    };
+    uint64_t lsn = wal_append(&wrec);
+    return lsn ? (long long) lsn : -1;
+}
+
+// Esperar el group commit fuera del lock, para que otros escritores entren al mismo fdatasync
+static int persist_wait(long long res) {
+    if (res < 0) return -1;
+    if (!options.wal) return (int) res;
+    return wal_wait((uint64_t) res);
+}
+
+// Esperar la persistencia y, si quedó durable, avisar del cambio
+static int commit_change(long long res, int id) {
+    int r = persist_wait(res);
+    if (r == 0 && listener) listener(id);
+    return r;
+}
+
+void storage_set_listener(storage_listener_t cb) {
+    listener = cb;
+}
+
+void storage_set_options(const storage_options_t *opts) {
+    if (opts) options = *opts;
+    // Los puntos del segmento abierto sólo son durables a través del WAL
+    if (options.timeseries) options.wal = true;
+}
+
+void storage_get_series_stats(series_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!options.timeseries) return;
+    pthread_rwlock_rdlock(&storage_lock);
+    series_get_stats(stats);
+    pthread_rwlock_unlock(&storage_lock);
+}
 
-    // Buscar "value"
-    char *val = strstr(p, "\"value\":\"");
-    if (!val) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -3;
+int storage_compact(void) {
+    if (!options.wal) return -1;
+
+    // Copia puntual de los registros vivos y rotación del log, con los escritores detenidos un instante
+    pthread_rwlock_wrlock(&storage_lock);
+    record_t *copy = malloc((entry_count ? entry_count : 1) * sizeof(record_t));
+    size_t copy_len = 0;
+    int snap_next_id = next_id;
+    if (!copy) {
+        pthread_rwlock_unlock(&storage_lock);
+        return -1;
     }
-    val += 9;
-    char *end = strchr(val, '"');
-    if (!end) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -4;
+    for (size_t i = 0; i < capacity; i++) {
+        if (table[i].id > 0) copy[copy_len++] = table[i];
     }
+    // Las lecturas comprimidas quedan en su propio archivo antes de soltar el log
+    if ((options.timeseries && series_flush() != 0) || wal_rotate(wal_old_file) != 0) {
+        pthread_rwlock_unlock(&storage_lock);
+        free(copy);
+        return -1;
+    }
+    compacting = true;
+    pthread_rwlock_unlock(&storage_lock);
+
+    // Escribir el snapshot sin bloquear a nadie
+    int res = 0;
+    snapshot_writer_t *w = snapshot_begin(snapshot_file);
+    if (!w) res = -1;
+    for (size_t i = 0; res == 0 && i < copy_len; i++) {
+        if (snapshot_put(w, copy[i].id, copy[i].ts, copy[i].value) != 0) res = -1;
+    }
+    if (w) {
+        if (res == 0) {
+            res = snapshot_commit(w, snap_next_id);
+        } else {
+            snapshot_abort(w);
+        }
+    }
+    free(copy);
 
-    size_t len = end - val;
-    if (len >= max_len) len = max_len - 1;
-    strncpy(out, val, len);
-    out[len] = '\0';
+    // El snapshot ya cubre el segmento rotado del log
+    if (res == 0) unlink(wal_old_file);
 
-    free(data);
-    pthread_mutex_unlock(&storage_mutex);
-    return 0;
+    pthread_rwlock_wrlock(&storage_lock);
+    compacting = false;
+    for (size_t i = 0; i < deferred_len; i++) slab_free(deferred[i]);
+    deferred_len = 0;
+    pthread_rwlock_unlock(&storage_lock);
+    return res;
 }
 
-int storage_update(int id, const char *new_value) {
-    if (!new_value) return -1;
-    
-    pthread_mutex_lock(&storage_mutex);
-    
-    char *data = read_file();
-    if (!data) {
-        pthread_mutex_unlock(&storage_mutex);
-        return -1;
+// Hilo compactor: escribe un snapshot cada snapshot_interval segundos
+static void *compactor_main(void *arg) {
+    (void) arg;
+    while (1) {
+        sleep(options.snapshot_interval);
+        storage_compact();
     }
+    return NULL;
+}
 
-    char key[32];
-    snprintf(key, sizeof(key), "\"id\":%d", id);
+// Inicialización: crear el archivo si no existe y cargarlo en memoria
+int storage_init(const char *filename) {
+    strncpy(storage_file, filename, sizeof(storage_file)-1);
+    snprintf(wal_file, sizeof(wal_file), "%s.wal", storage_file);
+    snprintf(wal_old_file, sizeof(wal_old_file), "%s.wal.old", storage_file);
+    snprintf(snapshot_file, sizeof(snapshot_file), "%s.snap", storage_file);
+    snprintf(series_file, sizeof(series_file), "%s.ts", storage_file);
+    // Si el archivo no existe, crear con un array vacío
+    FILE *archivo = fopen(storage_file, "r");
+    if (!archivo) {
+        archivo = fopen(storage_file, "w");
+        if (!archivo) return -1;
+        fprintf(archivo, "[]");
+    }
+    fclose(archivo);
 
-    char *p = strstr(data, key);
-    if (!p) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -2; // no encontrado
+    pthread_rwlock_wrlock(&storage_lock);
+
+    // Arranque: snapshot mapeado (o el JSON si no hay) y sólo la cola del log.
+    // El segmento .wal.old existe si una compactación no llegó a terminar
+    int res = 0;
+    if (options.timeseries && series_open(series_file) != 0) res = -1;
+    if (res == 0 && series_last_id() >= next_id) next_id = series_last_id() + 1;
+
+    int loaded = res == 0 ? load_snapshot() : 0;
+    if (loaded < 0) res = -1;
+    if (res == 0 && loaded == 0) res = load_file();
+
+    long replayed = 0;
+    if (res == 0) {
+        long old = wal_replay(wal_old_file, apply_wal_record, NULL);
+        long cur = wal_replay(wal_file, apply_wal_record, NULL);
+        if (old < 0 || cur < 0) res = -1;
+        replayed = old + cur;
+    }
+    if (res == 0 && options.wal) res = wal_open(wal_file, options.commit_ms, options.commit_bytes);
+
+    if (res == 0 && options.snapshot_interval == 0 && (replayed > 0 || loaded == 1)) {
+        // Sin snapshots el checkpoint es el JSON; el log y un snapshot previo quedan obsoletos
+        res = write_file(true);
+        if (res == 0 && options.timeseries) res = series_flush();
+        if (res == 0 && options.wal) res = wal_truncate();
+        if (res == 0) {
+            if (!options.wal) unlink(wal_file);
+            unlink(wal_old_file);
+            unlink(snapshot_file);
+        }
     }
 
-    // Buscar inicio de value
-    char *val = strstr(p, "\"value\":\"");
-    if (!val) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -3;
-    }
-    val += 9; // mover después de "value":"
-
-    char *end = strchr(val, '"');
-    if (!end) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -4;
-    }
-
-    // Construir nueva cadena de forma segura
-    size_t data_len = strlen(data);
-    size_t new_value_len = strlen(new_value);
-    size_t prefix_len = val - data;
-    size_t suffix_len = strlen(end);
-    size_t total_len = prefix_len + new_value_len + suffix_len + 1;
-    
-    char *new_data = malloc(total_len);
-    if (!new_data) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -1;
+    if (res == 0) rebuild_rollups();
+    pthread_rwlock_unlock(&storage_lock);
+
+    if (res == 0 && options.wal && options.snapshot_interval > 0) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, compactor_main, NULL) != 0) return -1;
+        pthread_detach(tid);
     }
-    
-    strncpy(new_data, data, prefix_len);
-    new_data[prefix_len] = '\0';
-    strcat(new_data, new_value);
-    strcat(new_data, end);
+    return res;
+}
 
-    int response = write_file(new_data);
-    free(data);
-    free(new_data);
-    
-    pthread_mutex_unlock(&storage_mutex);
-    return response;
+// Lecturas de la serie juntadas para mezclarlas en orden de id con la tabla
+typedef struct {
+    int id;
+    time_t ts;
+    char text[32];
+} scan_point_t;
+
+typedef struct {
+    scan_point_t *points;
+    size_t count;
+} scan_batch_t;
+
+static void collect_series_point(int id, time_t ts, double value, int decimals, void *ctx) {
+    scan_batch_t *batch = (scan_batch_t*) ctx;
+    scan_point_t *p = &batch->points[batch->count++];
+    p->id = id;
+    p->ts = ts;
+    series_format_value(value, decimals, p->text, sizeof(p->text));
 }
 
-// Eliminar una entrada - Thread-safe
-int storage_delete(int id) {
-    pthread_mutex_lock(&storage_mutex);
-    
-    char *data = read_file();
-    if (!data) {
-        pthread_mutex_unlock(&storage_mutex);
-        return -1;
+int storage_scan(int after_id, size_t max, storage_scan_cb cb, void *ctx) {
+    if (max > STORAGE_SCAN_MAX) max = STORAGE_SCAN_MAX;
+    if (after_id < 0) after_id = 0;
+
+    scan_point_t points[STORAGE_SCAN_MAX];
+    scan_batch_t batch = { .points = points, .count = 0 };
+
+    pthread_rwlock_rdlock(&storage_lock);
+    if (options.timeseries) series_scan(after_id, max, collect_series_point, &batch);
+
+    // Los ids son únicos entre la tabla y la serie: avanzar id por id tomando de la que lo tenga
+    size_t visited = 0, next_point = 0;
+    for (int id = after_id + 1; id < next_id && visited < max; id++) {
+        if (next_point < batch.count && points[next_point].id == id) {
+            cb(id, points[next_point].ts, points[next_point].text, ctx);
+            next_point++;
+            visited++;
+            continue;
+        }
+        record_t *rec = table_find(id);
+        if (rec) {
+            cb(id, rec->ts, rec->value, ctx);
+            visited++;
+        }
     }
+    pthread_rwlock_unlock(&storage_lock);
+    return (int) visited;
+}
 
-    char key[32];
-    snprintf(key, sizeof(key), "\"id\":%d", id);
+// Agregar un dato (POST) - Thread-safe
+int storage_add(const char *value) {
+    if (!value) return -1;
 
-    char *p = strstr(data, key);
-    if (!p) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -2; // no encontrado
+    char *copy = slab_strndup(value, strlen(value));
+    if (!copy) return -1;
+
+    pthread_rwlock_wrlock(&storage_lock);
+
+    int new_id = next_id;
+    time_t now = time(NULL);
+    double number;
+    int decimals;
+    long long res;
+    if (options.timeseries && series_parse_value(value, &number, &decimals) &&
+        series_append(new_id, now, number, decimals) == 0) {
+        // Lectura numérica: va comprimida a la serie, el WAL guarda el texto
+        slab_free(copy);
+        next_id++;
+        rollup_add(now, number);
+        record_t rec = { .id = new_id, .ts = now, .value = (char*) value };
+        res = persist(WAL_OP_ADD, &rec, new_id);
+        pthread_rwlock_unlock(&storage_lock);
+        return commit_change(res, new_id);
     }
 
-    // Buscar inicio del objeto '{'
-    char *start = p;
-    while (start > data && *start != '{') start--;
-
-    // Buscar fin del objeto '}'
-    char *end = strchr(p, '}');
-    if (!end) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
-        return -3;
-    }
-    end++; // incluir '}'
-
-    // Construir nueva cadena de forma segura
-    size_t data_len = strlen(data);
-    size_t prefix_len = start - data;
-    size_t suffix_len = strlen(end);
-    size_t total_len = prefix_len + suffix_len + 1;
-    
-    char *new_data = malloc(total_len);
-    if (!new_data) {
-        free(data);
-        pthread_mutex_unlock(&storage_mutex);
+    if (table_insert(new_id, now, copy, true) != 0) {
+        pthread_rwlock_unlock(&storage_lock);
+        slab_free(copy);
         return -1;
     }
-    
-    strncpy(new_data, data, prefix_len);
-    new_data[prefix_len] = '\0';
-    strcat(new_data, end);
 
-    // Arreglar posibles comas extras
-    for (int i = 0; new_data[i]; i++) {
-        if (new_data[i] == ',' && new_data[i+1] == ']') {
-            memmove(&new_data[i], &new_data[i+1], strlen(&new_data[i+1])+1);
+    if (parse_number(value, &number)) rollup_add(now, number);
+    res = persist(WAL_OP_ADD, table_find(new_id), new_id);
+    pthread_rwlock_unlock(&storage_lock);
+    return commit_change(res, new_id);
+}
+
+// Obtener un valor por id - Thread-safe, sin tocar disco
+int storage_get(int id, char *out, size_t max_len) {
+    if (!out || max_len == 0) return -1;
+
+    pthread_rwlock_rdlock(&storage_lock);
+
+    record_t *rec = table_find(id);
+    if (!rec) {
+        double number;
+        int decimals;
+        int res = options.timeseries ? series_get(id, NULL, &number, &decimals) : -2;
+        pthread_rwlock_unlock(&storage_lock);
+        if (res == 0) series_format_value(number, decimals, out, max_len);
+        return res; // -2: no encontrado
+    }
+
+    size_t len = strlen(rec->value);
+    if (len >= max_len) len = max_len - 1;
+    memcpy(out, rec->value, len);
+    out[len] = '\0';
+
+    pthread_rwlock_unlock(&storage_lock);
+    return 0;
+}
+
+int storage_update(int id, const char *new_value) {
+    if (!new_value) return -1;
+
+    char *copy = slab_strndup(new_value, strlen(new_value));
+    if (!copy) return -1;
+
+    pthread_rwlock_wrlock(&storage_lock);
+
+    record_t *rec = table_find(id);
+    time_t ts;
+    double old_number, number;
+    if (!rec && options.timeseries && series_get(id, &ts, &old_number, NULL) == 0) {
+        // Los segmentos no se reescriben: la lectura pasa a la tabla de strings
+        if (table_insert(id, ts, copy, true) != 0) {
+            pthread_rwlock_unlock(&storage_lock);
+            slab_free(copy);
+            return -1;
         }
+        series_delete(id);
+        rollup_remove(ts, old_number);
+        if (parse_number(new_value, &number)) rollup_add(ts, number);
+        long long res = persist(WAL_OP_UPDATE, table_find(id), id);
+        pthread_rwlock_unlock(&storage_lock);
+        return commit_change(res, id);
     }
+    if (!rec) {
+        pthread_rwlock_unlock(&storage_lock);
+        slab_free(copy);
+        return -2; // no encontrado
+    }
+    if (parse_number(rec->value, &old_number)) rollup_remove(rec->ts, old_number);
+    if (parse_number(new_value, &number)) rollup_add(rec->ts, number);
+    release_value(rec);
+    rec->value = copy;
+    rec->owned = true;
+
+    long long res = persist(WAL_OP_UPDATE, rec, id);
+    pthread_rwlock_unlock(&storage_lock);
+    return commit_change(res, id);
+}
 
-    int res = write_file(new_data);
-    free(data);
-    free(new_data);
-    
-    pthread_mutex_unlock(&storage_mutex);
-    return res;
+// Eliminar una entrada - Thread-safe
+int storage_delete(int id) {
+    pthread_rwlock_wrlock(&storage_lock);
+
+    record_t *rec = table_find(id);
+    time_t ts;
+    double number;
+    if (rec) {
+        if (parse_number(rec->value, &number)) rollup_remove(rec->ts, number);
+        table_remove(rec);
+    } else if (options.timeseries && series_get(id, &ts, &number, NULL) == 0) {
+        series_delete(id);
+        rollup_remove(ts, number);
+    } else {
+        pthread_rwlock_unlock(&storage_lock);
+        return -2; // no encontrado
+    }
+
+    long long res = persist(WAL_OP_DELETE, NULL, id);
+    pthread_rwlock_unlock(&storage_lock);
+    return commit_change(res, id);
 }
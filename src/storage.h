@@ -3,6 +3,40 @@
 
 #include <stddef.h>
 #include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "series.h"
+
+#define STORAGE_SCAN_MAX 64       // registros por llamada a storage_scan
+
+// Opciones de persistencia
+typedef struct {
+    bool wal;               // registrar mutaciones en un write-ahead log en vez de reescribir el JSON
+    unsigned commit_ms;     // espera máxima para agrupar escritores en un mismo fdatasync
+    size_t commit_bytes;    // bytes acumulados que fuerzan el commit antes de commit_ms
+    unsigned snapshot_interval; // segundos entre snapshots binarios + compactación del log (0 = sin snapshots)
+    bool timeseries;        // lecturas numéricas comprimidas en segmentos columnares (activa wal)
+} storage_options_t;
+
+// Configurar la persistencia (antes de storage_init)
+void storage_set_options(const storage_options_t *opts);
+
+// Aviso de que un registro se creó, cambió o se borró (ya persistido, sin locks tomados)
+typedef void (*storage_listener_t)(int id);
+
+// Registrar el listener de cambios (antes de atender pedidos)
+void storage_set_listener(storage_listener_t cb);
+
+// Escribir un snapshot de los registros vivos y descartar el log que cubre (requiere WAL)
+int storage_compact(void);
+
+// Estadísticas de la serie comprimida (todo en cero fuera del modo timeseries)
+void storage_get_series_stats(series_stats_t *stats);
+
+// Recorrer hasta max registros (como mucho STORAGE_SCAN_MAX) con id > after_id en orden creciente.
+// El callback corre con el lock de lectura tomado. Retorna cuántos visitó (0 = no hay más)
+typedef void (*storage_scan_cb)(int id, time_t ts, const char *value, void *ctx);
+int storage_scan(int after_id, size_t max, storage_scan_cb cb, void *ctx);
 
 // Inicializar almacenamiento
 int storage_init(const char *filename);
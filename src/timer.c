@@ -0,0 +1,68 @@
+#include <time.h>
+#include <pthread.h>
+#include "timer.h"
+
+typedef struct {
+    unsigned interval_ms;
+    uint64_t next_ms;
+    timer_cb_t cb;
+    void *ctx;
+} timer_entry_t;
+
+static timer_entry_t timers[MAX_TIMERS];
+static int timer_count = 0;
+
+uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int timer_register(unsigned interval_ms, timer_cb_t cb, void *ctx) {
+    if (!cb || interval_ms == 0 || timer_count >= MAX_TIMERS) return -1;
+    timer_entry_t *t = &timers[timer_count++];
+    t->interval_ms = interval_ms;
+    t->next_ms = timer_now_ms() + interval_ms;
+    t->cb = cb;
+    t->ctx = ctx;
+    return 0;
+}
+
+void timer_run_due(void) {
+    uint64_t now = timer_now_ms();
+    for (int i = 0; i < timer_count; i++) {
+        if (now >= timers[i].next_ms) {
+            timers[i].cb(timers[i].ctx);
+            timers[i].next_ms = now + timers[i].interval_ms;
+        }
+    }
+}
+
+int timer_next_ms(void) {
+    if (timer_count == 0) return -1;
+    uint64_t now = timer_now_ms();
+    uint64_t next = timers[0].next_ms;
+    for (int i = 1; i < timer_count; i++) {
+        if (timers[i].next_ms < next) next = timers[i].next_ms;
+    }
+    return (next > now) ? (int) (next - now) : 0;
+}
+
+static void *timer_main(void *arg) {
+    (void) arg;
+    while (1) {
+        int wait = timer_next_ms();
+        if (wait < 0) wait = 1000;
+        struct timespec ts = { wait / 1000, (long) (wait % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        timer_run_due();
+    }
+    return NULL;
+}
+
+int timer_thread_start(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, timer_main, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#define MAX_TIMERS 16
+
+// Callback de un temporizador periódico
+typedef void (*timer_cb_t)(void *ctx);
+
+// Registrar un temporizador que se ejecuta cada interval_ms (antes de arrancar el servidor)
+int timer_register(unsigned interval_ms, timer_cb_t cb, void *ctx);
+
+// Ejecutar los temporizadores vencidos. Lo llama un único hilo (el loop de eventos o el hilo de timers)
+void timer_run_due(void);
+
+// Milisegundos hasta el próximo vencimiento (o -1 si no hay temporizadores)
+int timer_next_ms(void);
+
+// Hora monotónica en milisegundos
+uint64_t timer_now_ms(void);
+
+// Arrancar un hilo dedicado que ejecuta los temporizadores (modos con hilos bloqueantes)
+int timer_thread_start(void);
+
+#endif
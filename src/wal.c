@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "wal.h"
+
+// Formato de cada registro (orden de bytes del host):
+// crc32 (4) | op (1) | value_len (2) | id (4) | ts (8) | value (value_len)
+#define WAL_HEADER WAL_RECORD_HEADER
+#define WAL_MAX_VALUE 0xFFFF
+
+static int wal_fd = -1;
+static char wal_path[280];
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;     // despierta al flusher
+static pthread_cond_t durable_cond = PTHREAD_COND_INITIALIZER;   // despierta a los escritores
+static pthread_t flusher;
+
+// Doble buffer: los escritores llenan uno mientras el flusher escribe el otro
+static char *buf = NULL, *spare = NULL;
+static size_t buf_len = 0, buf_cap = 0, spare_cap = 0;
+
+static uint64_t appended_lsn = 0;
+static uint64_t durable_lsn = 0;
+static bool closing = false;
+static bool failed = false;
+
+static unsigned commit_ms = 0;
+static size_t commit_bytes = 0;
+static wal_stats_t stats;
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_fill(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static void crc_init(void) {
+    pthread_once(&crc_once, crc_fill);
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Escribir todo el bloque, reintentando escrituras parciales
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+// Hilo de group commit: junta todo lo que llegó y hace un solo fdatasync
+static void *flusher_main(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&wal_mutex);
+    for (;;) {
+        while (buf_len == 0 && !closing) pthread_cond_wait(&flush_cond, &wal_mutex);
+        if (buf_len == 0 && closing) break;
+
+        // Esperar a más escritores hasta commit_ms o hasta juntar commit_bytes
+        if (commit_ms > 0 && !closing) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long) (commit_ms % 1000) * 1000000L;
+            deadline.tv_sec += commit_ms / 1000 + deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            while (buf_len < commit_bytes && !closing) {
+                if (pthread_cond_timedwait(&flush_cond, &wal_mutex, &deadline) == ETIMEDOUT) break;
+            }
+        }
+
+        // Intercambiar buffers y escribir fuera del lock
+        char *out = buf;
+        size_t out_len = buf_len, out_cap = buf_cap;
+        uint64_t target = appended_lsn;
+        int fd = wal_fd;
+        buf = spare;
+        buf_cap = spare_cap;
+        spare = out;
+        spare_cap = out_cap;
+        buf_len = 0;
+        pthread_mutex_unlock(&wal_mutex);
+
+        int res = write_all(fd, out, out_len);
+        if (res == 0) res = fdatasync(fd);
+
+        pthread_mutex_lock(&wal_mutex);
+        if (res != 0) failed = true;
+        durable_lsn = target;
+        stats.syncs++;
+        stats.bytes += out_len;
+        pthread_cond_broadcast(&durable_cond);
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    return NULL;
+}
+
+int wal_open(const char *path, unsigned interval_ms, size_t size) {
+    crc_init();
+    snprintf(wal_path, sizeof(wal_path), "%s", path);
+    wal_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (wal_fd < 0) return -1;
+
+    commit_ms = interval_ms;
+    commit_bytes = size > 0 ? size : 1;
+    closing = false;
+    failed = false;
+
+    if (pthread_create(&flusher, NULL, flusher_main, NULL) != 0) {
+        close(wal_fd);
+        wal_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+long wal_replay(const char *path, wal_apply_cb apply, void *ctx) {
+    crc_init();
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return (errno == ENOENT) ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t) st.st_size;
+    uint8_t *data = malloc(len ? len : 1);
+    if (!data) {
+        close(fd);
+        return -1;
+    }
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, data + got, len - got);
+        if (n <= 0) break;
+        got += (size_t) n;
+    }
+
+    long applied = 0;
+    size_t off = 0;
+    while (off + WAL_HEADER <= got) {
+        uint32_t crc;
+        uint16_t vlen;
+        int32_t id;
+        int64_t ts;
+        memcpy(&crc, data + off, 4);
+        memcpy(&vlen, data + off + 5, 2);
+        memcpy(&id, data + off + 7, 4);
+        memcpy(&ts, data + off + 11, 8);
+        if (off + WAL_HEADER + vlen > got) break;                    // registro incompleto
+        if (crc32(data + off + 4, WAL_HEADER - 4 + vlen) != crc) break; // registro corrupto
+
+        wal_record_t rec = {
+            .op = (wal_op_t) data[off + 4],
+            .id = id,
+            .ts = (time_t) ts,
+            .value = (const char*) data + off + WAL_HEADER,
+            .value_len = vlen,
+        };
+        if (apply(&rec, ctx) != 0) break;
+        applied++;
+        off += WAL_HEADER + vlen;
+    }
+
+    // Descartar la cola dañada para que los nuevos registros queden legibles
+    if (off < len && ftruncate(fd, (off_t) off) != 0) applied = -1;
+
+    free(data);
+    close(fd);
+    return applied;
+}
+
+size_t wal_encode(const wal_record_t *rec, uint8_t *out, size_t max) {
+    size_t need = WAL_HEADER + rec->value_len;
+    if (rec->value_len > WAL_MAX_VALUE || need > max) return 0;
+    crc_init();
+
+    uint16_t vlen = (uint16_t) rec->value_len;
+    int32_t id = rec->id;
+    int64_t ts = (int64_t) rec->ts;
+    out[4] = (uint8_t) rec->op;
+    memcpy(out + 5, &vlen, 2);
+    memcpy(out + 7, &id, 4);
+    memcpy(out + 11, &ts, 8);
+    if (vlen) memcpy(out + WAL_HEADER, rec->value, vlen);
+    uint32_t crc = crc32(out + 4, WAL_HEADER - 4 + vlen);
+    memcpy(out, &crc, 4);
+    return need;
+}
+
+uint64_t wal_append(const wal_record_t *rec) {
+    if (wal_fd < 0 || rec->value_len > WAL_MAX_VALUE) return 0;
+
+    size_t need = WAL_HEADER + rec->value_len;
+    pthread_mutex_lock(&wal_mutex);
+
+    if (buf_len + need > buf_cap) {
+        size_t cap = buf_cap ? buf_cap : 4096;
+        while (cap < buf_len + need) cap <<= 1;
+        char *grown = realloc(buf, cap);
+        if (!grown) {
+            pthread_mutex_unlock(&wal_mutex);
+            return 0;
+        }
+        buf = grown;
+        buf_cap = cap;
+    }
+
+    wal_encode(rec, (uint8_t*) buf + buf_len, need);
+    buf_len += need;
+    appended_lsn += need;
+    uint64_t lsn = appended_lsn;
+    stats.records++;
+
+    pthread_cond_signal(&flush_cond);
+    pthread_mutex_unlock(&wal_mutex);
+    return lsn;
+}
+
+int wal_wait(uint64_t lsn) {
+    if (lsn == 0) return -1;
+    pthread_mutex_lock(&wal_mutex);
+    while (durable_lsn < lsn) pthread_cond_wait(&durable_cond, &wal_mutex);
+    int res = failed ? -1 : 0;
+    pthread_mutex_unlock(&wal_mutex);
+    return res;
+}
+
+int wal_truncate(void) {
+    if (wal_fd < 0) return -1;
+    pthread_mutex_lock(&wal_mutex);
+    while (durable_lsn < appended_lsn) pthread_cond_wait(&durable_cond, &wal_mutex);
+    int res = ftruncate(wal_fd, 0);
+    if (res == 0) res = fdatasync(wal_fd);
+    pthread_mutex_unlock(&wal_mutex);
+    return res;
+}
+
+// Agregar el contenido de un archivo al final de otro
+static int append_file(const char *src, int dst_fd) {
+    int fd = open(src, O_RDONLY);
+    if (fd < 0) return -1;
+    char chunk[64 * 1024];
+    ssize_t n;
+    int res = 0;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        if (write_all(dst_fd, chunk, (size_t) n) != 0) {
+            res = -1;
+            break;
+        }
+    }
+    if (n < 0) res = -1;
+    close(fd);
+    return res;
+}
+
+int wal_rotate(const char *old_path) {
+    if (wal_fd < 0) return -1;
+    pthread_mutex_lock(&wal_mutex);
+    while (durable_lsn < appended_lsn) pthread_cond_wait(&durable_cond, &wal_mutex);
+
+    int res;
+    int old_fd = open(old_path, O_WRONLY | O_APPEND);
+    if (old_fd >= 0) {
+        // Quedó un segmento de una compactación fallida: conservarlo y sumarle el actual
+        res = append_file(wal_path, old_fd);
+        if (res == 0) res = fdatasync(old_fd);
+        close(old_fd);
+        if (res == 0) res = ftruncate(wal_fd, 0);
+    } else {
+        res = rename(wal_path, old_path);
+        if (res == 0) {
+            int fd = open(wal_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd < 0) {
+                rename(old_path, wal_path);
+                res = -1;
+            } else {
+                close(wal_fd);
+                wal_fd = fd;
+            }
+        }
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    return res;
+}
+
+void wal_get_stats(wal_stats_t *out) {
+    pthread_mutex_lock(&wal_mutex);
+    *out = stats;
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+void wal_close(void) {
+    if (wal_fd < 0) return;
+    pthread_mutex_lock(&wal_mutex);
+    closing = true;
+    pthread_cond_signal(&flush_cond);
+    pthread_mutex_unlock(&wal_mutex);
+    pthread_join(flusher, NULL);
+    close(wal_fd);
+    wal_fd = -1;
+}
@@ -0,0 +1,66 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define WAL_RECORD_HEADER 19     // bytes fijos de cada registro antes del valor
+
+// Operaciones que se registran en el log
+typedef enum {
+    WAL_OP_ADD = 1,
+    WAL_OP_UPDATE = 2,
+    WAL_OP_DELETE = 3,
+} wal_op_t;
+
+// Registro ya decodificado (value apunta a memoria del lector, no es terminado en '\0')
+typedef struct {
+    wal_op_t op;
+    int id;
+    time_t ts;
+    const char *value;
+    size_t value_len;
+} wal_record_t;
+
+// Callback para reaplicar cada registro al arrancar
+typedef int (*wal_apply_cb)(const wal_record_t *rec, void *ctx);
+
+// Abrir (o crear) el log. Los escritores que esperan el mismo fdatasync se agrupan:
+// el commit se hace cuando pasan commit_ms o se acumulan commit_bytes
+int wal_open(const char *path, unsigned commit_ms, size_t commit_bytes);
+
+// Reaplicar los registros válidos del log. Si el final quedó cortado por una caída,
+// se trunca hasta el último registro completo. Retorna la cantidad aplicada o -1
+long wal_replay(const char *path, wal_apply_cb apply, void *ctx);
+
+// Agregar un registro al buffer del log. Retorna su LSN (posición lógica) o 0 si falla
+uint64_t wal_append(const wal_record_t *rec);
+
+// Serializar un registro en el formato del log (para segmentos escritos por fuera del group
+// commit, como las particiones). Retorna los bytes usados o 0 si no entra en max
+size_t wal_encode(const wal_record_t *rec, uint8_t *out, size_t max);
+
+// Bloquear hasta que el registro con ese LSN esté en disco (group commit)
+int wal_wait(uint64_t lsn);
+
+// Vaciar el log (después de un checkpoint que ya contiene todos sus registros)
+int wal_truncate(void);
+
+// Pasar el contenido actual del log a old_path (sumándolo si ya existe) y seguir
+// escribiendo en un log vacío. El llamador debe impedir nuevos wal_append mientras tanto
+int wal_rotate(const char *old_path);
+
+// Estadísticas del group commit
+typedef struct {
+    uint64_t records;
+    uint64_t syncs;          // llamadas a fdatasync
+    uint64_t bytes;
+} wal_stats_t;
+
+void wal_get_stats(wal_stats_t *stats);
+
+// Forzar el último commit y cerrar el log
+void wal_close(void);
+
+#endif
@@ -0,0 +1,187 @@
+// Fuzzing de coap_parse y los accesos a opciones.
+// Con clang se compila como objetivo de libFuzzer (-DFUZZ_LIBFUZZER -fsanitize=fuzzer).
+// Con gcc trae su propio driver: carga el corpus (archivos o directorios) y aplica
+// mutaciones aleatorias, pensado para correr bajo ASan/UBSan:
+//   ./fuzz_coap tests/corpus [-n iteraciones] [-s semilla]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "coap_packet.h"
+
+#define FUZZ_MAX_INPUT 2048
+
+// Abortar (y que el sanitizer/libFuzzer guarde la entrada) si un invariante no se cumple
+#define FUZZ_ASSERT(cond) do { if (!(cond)) { fprintf(stderr, "invariante roto: %s\n", #cond); abort(); } } while (0)
+
+static void check_packet(const uint8_t *data, size_t size, const coap_packet_t *pkt) {
+    FUZZ_ASSERT(pkt->options_count <= COAP_MAX_OPTIONS);
+    FUZZ_ASSERT(pkt->token_len <= 8);
+    uint16_t prev = 0;
+    for (size_t i = 0; i < pkt->options_count; i++) {
+        const coap_option_t *opt = &pkt->options[i];
+        // Cada valor dentro del datagrama y los números en orden creciente
+        FUZZ_ASSERT(opt->value >= data && opt->value + opt->length <= data + size);
+        FUZZ_ASSERT(opt->number >= prev);
+        prev = opt->number;
+        // El índice apunta a la primera opción de cada número
+        const coap_option_t *first = coap_find_option(pkt, opt->number);
+        FUZZ_ASSERT(first && first <= opt && first->number == opt->number);
+    }
+    if (pkt->payload) {
+        FUZZ_ASSERT(pkt->payload_len > 0 && pkt->payload > data && pkt->payload + pkt->payload_len == data + size);
+    }
+
+    // Los accesos tipados no deben leer fuera de las opciones
+    char query[64];
+    coap_block_t block;
+    uint32_t value;
+    const coap_option_t *segments[COAP_MAX_OPTIONS];
+    coap_get_query(pkt, "from", query, sizeof(query));
+    coap_get_block(pkt, COAP_OPTION_BLOCK2, &block);
+    coap_get_uint(pkt, COAP_OPTION_OBSERVE, &value);
+    int n = coap_get_path(pkt, segments, COAP_MAX_OPTIONS);
+    for (int i = 0; i < n; i++) coap_option_decimal(segments[i], &value);
+}
+
+// Ida y vuelta: lo que se vuelve a serializar tiene que leerse igual
+static void check_roundtrip(const coap_packet_t *pkt) {
+    static uint8_t out[FUZZ_MAX_INPUT + 64];
+    size_t out_len;
+    if (coap_build(pkt, out, &out_len, sizeof(out)) != 0) return;
+
+    coap_packet_t again;
+    FUZZ_ASSERT(coap_parse(out, out_len, &again) == 0);
+    FUZZ_ASSERT(again.code == pkt->code && again.message_id == pkt->message_id && again.token_len == pkt->token_len);
+    FUZZ_ASSERT(again.options_count == pkt->options_count && again.payload_len == pkt->payload_len);
+    for (size_t i = 0; i < pkt->options_count; i++) {
+        const coap_option_t *a = &pkt->options[i], *b = &again.options[i];
+        FUZZ_ASSERT(a->number == b->number && a->length == b->length && memcmp(a->value, b->value, a->length) == 0);
+    }
+    FUZZ_ASSERT(pkt->payload_len == 0 || memcmp(pkt->payload, again.payload, pkt->payload_len) == 0);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size > FUZZ_MAX_INPUT) return 0;
+    coap_packet_t pkt;
+    if (coap_parse(data, size, &pkt) != 0) return 0;
+    check_packet(data, size, &pkt);
+    check_roundtrip(&pkt);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+#define MAX_SEEDS 256
+
+static uint8_t *seeds[MAX_SEEDS];
+static size_t seed_len[MAX_SEEDS];
+static size_t n_seeds = 0;
+
+static void load_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f || n_seeds == MAX_SEEDS) {
+        if (f) fclose(f);
+        return;
+    }
+    uint8_t *buf = malloc(FUZZ_MAX_INPUT);
+    size_t len = fread(buf, 1, FUZZ_MAX_INPUT, f);
+    fclose(f);
+    seeds[n_seeds] = buf;
+    seed_len[n_seeds++] = len;
+}
+
+static void load_path(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    if (!S_ISDIR(st.st_mode)) {
+        load_file(path);
+        return;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *de;
+    char full[1024];
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        snprintf(full, sizeof(full), "%s/%s", path, de->d_name);
+        load_file(full);
+    }
+    closedir(dir);
+}
+
+// Una mutación al azar: bytes cambiados, insertados, borrados o nibbles de extensión
+static size_t mutate(uint8_t *buf, size_t len) {
+    size_t pos = len ? (size_t) rand() % len : 0;
+    switch (rand() % 6) {
+        case 0:
+            if (len) buf[pos] ^= (uint8_t) (1u << (rand() % 8));
+            break;
+        case 1:
+            if (len) buf[pos] = (uint8_t) rand();
+            break;
+        case 2:
+            if (len < FUZZ_MAX_INPUT) {
+                memmove(buf + pos + 1, buf + pos, len - pos);
+                buf[pos] = (uint8_t) rand();
+                len++;
+            }
+            break;
+        case 3:
+            if (len) {
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                len--;
+            }
+            break;
+        case 4:
+            len = pos;
+            break;
+        default: {
+            uint8_t nibble = (uint8_t) (13 + rand() % 3);
+            if (len) buf[pos] = (rand() % 2) ? (uint8_t) ((nibble << 4) | (buf[pos] & 0x0F)) : (uint8_t) ((buf[pos] & 0xF0) | nibble);
+            break;
+        }
+    }
+    return len;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long iterations = 1000000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) iterations = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = (unsigned) strtoul(argv[++i], NULL, 10);
+        else load_path(argv[i]);
+    }
+    if (n_seeds == 0) {
+        fprintf(stderr, "uso: %s <corpus...> [-n iteraciones] [-s semilla]\n", argv[0]);
+        return 1;
+    }
+    srand(seed);
+
+    for (size_t i = 0; i < n_seeds; i++) LLVMFuzzerTestOneInput(seeds[i], seed_len[i]);
+
+    // Cada entrada mutada se copia a un buffer de su tamaño exacto para que ASan vea las lecturas de más
+    uint8_t work[FUZZ_MAX_INPUT];
+    unsigned long parsed = 0;
+    for (unsigned long it = 0; it < iterations; it++) {
+        size_t s = (size_t) rand() % n_seeds;
+        size_t len = seed_len[s];
+        memcpy(work, seeds[s], len);
+        int rounds = 1 + rand() % 4;
+        for (int r = 0; r < rounds; r++) len = mutate(work, len);
+
+        uint8_t *input = malloc(len ? len : 1);
+        memcpy(input, work, len);
+        coap_packet_t pkt;
+        if (coap_parse(input, len, &pkt) == 0) parsed++;
+        LLVMFuzzerTestOneInput(input, len);
+        free(input);
+    }
+    printf("%lu entradas (%zu semillas), %lu decodificadas sin error\n", iterations, n_seeds, parsed);
+    return 0;
+}
+
+#endif
@@ -1,4 +1,18 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "coap_packet.h"
+#include "rollup.h"
+#include "series.h"
+#include "partition.h"
+
+static int failures = 0;
+
+// Verificar un caso y contar los que fallan
+static void check(bool ok, const char *name) {
+    printf("%s: %s\n", ok ? "OK   " : "FALLA", name);
+    if (!ok) failures++;
+}
 
 int main() {
     // Simular un GET simple (sin payload)
@@ -27,5 +41,168 @@ int main() {
         printf("Build ERROR %d\n", res);
     }
 
-    return 0;
+    // GET data/42 con token, Observe=0 y payload: accesos por número de opción
+    uint8_t get[] = { 0x42, 0x01, 0x00, 0x01, 0xAA, 0xBB,
+                      0x60,                      // Observe (6) vacío = 0
+                      0x54, 'd', 'a', 't', 'a',  // Uri-Path (11)
+                      0x02, '4', '2',            // Uri-Path
+                      0xFF, 'x' };
+    res = coap_parse(get, sizeof(get), &pkt);
+    check(res == 0 && pkt.options_count == 3 && pkt.payload_len == 1, "parse de GET data/42");
+    const coap_option_t *segments[4];
+    uint32_t value = 99, id = 0;
+    check(coap_get_path(&pkt, segments, 4) == 2 && coap_option_is(segments[0], "data") &&
+          coap_option_decimal(segments[1], &id) == 0 && id == 42, "segmentos del Uri-Path");
+    check(coap_get_uint(&pkt, COAP_OPTION_OBSERVE, &value) == 0 && value == 0, "Observe como entero");
+    check(coap_find_option(&pkt, COAP_OPTION_ETAG) == NULL, "opción ausente");
+
+    // Opción con delta extendido de 2 bytes cortado al final del datagrama
+    uint8_t cut[] = { 0x40, 0x01, 0x00, 0x02, 0xE0, 0x01 };
+    check(coap_parse(cut, sizeof(cut), &pkt) == COAP_ERR_OPTION, "delta extendido cortado");
+
+    // Valor de opción más largo que lo que queda del buffer
+    uint8_t longv[] = { 0x40, 0x01, 0x00, 0x03, 0xB5, 'a', 'b' };
+    check(coap_parse(longv, sizeof(longv), &pkt) == COAP_ERR_OPTION, "valor fuera del buffer");
+
+    // Nibble 15 reservado en la longitud
+    uint8_t reserved[] = { 0x40, 0x01, 0x00, 0x04, 0xBF };
+    check(coap_parse(reserved, sizeof(reserved), &pkt) == COAP_ERR_OPTION, "nibble reservado");
+
+    // Marcador de payload sin payload
+    uint8_t marker[] = { 0x40, 0x01, 0x00, 0x05, 0xFF };
+    check(coap_parse(marker, sizeof(marker), &pkt) == COAP_ERR_PAYLOAD, "marcador sin payload");
+
+    // Más opciones de las que entran en el paquete
+    uint8_t many[4 + COAP_MAX_OPTIONS + 1] = { 0x40, 0x01, 0x00, 0x06 };
+    for (size_t i = 4; i < sizeof(many); i++) many[i] = 0x00; // delta 0, longitud 0 (If-Match vacío)
+    check(coap_parse(many, sizeof(many), &pkt) == COAP_ERR_TOO_MANY, "demasiadas opciones");
+
+    // Ida y vuelta: construir con opciones desordenadas y volver a leer
+    coap_packet_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.ver = 1;
+    resp.type = COAP_TYPE_ACK;
+    resp.code = COAP_CODE_CONTENT;
+    uint8_t etag[4] = { 1, 2, 3, 4 }, size1[2] = { 0x04, 0x00 };
+    coap_add_option(&resp, COAP_OPTION_SIZE1, size1, 2);
+    coap_add_option(&resp, COAP_OPTION_ETAG, etag, 4);
+    res = coap_build(&resp, out, &out_len, sizeof(out));
+    check(res == 0 && coap_parse(out, out_len, &pkt) == 0 && pkt.options_count == 2 &&
+          coap_get_uint(&pkt, COAP_OPTION_SIZE1, &value) == 0 && value == 1024, "ida y vuelta con Size1 (delta extendido)");
+
+    // Rollups cargados fuera de orden (como el replay del arranque): 30 minutos recientes
+    // intercalados con las mismas lecturas una semana antes, que caen en los mismos slots
+    time_t now = 1700000000 - 1700000000 % 3600;
+    time_t week = (time_t) ROLLUP_MINUTES * 60;
+    for (int i = 0; i < 30; i++) {
+        time_t ts = now - 60 * (30 - i);
+        if (i % 2) rollup_add(ts - week, 1.0);
+        rollup_add(ts, 2.0);
+        if (!(i % 2)) rollup_add(ts - week, 1.0);
+    }
+    rollup_bucket_t windows[32];
+    long n = rollup_query(now - 30 * 60, now, 30 * 60, windows, 32);
+    check(n == 1 && windows[0].count == 30 && windows[0].sum == 60.0, "rollup: replay fuera de orden");
+    n = rollup_query(now - week - 30 * 60, now - week, 60, windows, 32);
+    check(n == 0, "rollup: la semana anterior no pisa los slots");
+
+    // Un PUT o DELETE resta la lectura vieja de su ventana
+    rollup_remove(now - 60, 2.0);
+    rollup_add(now - 60, 5.0);
+    rollup_remove(now - 120, 2.0);
+    n = rollup_query(now - 30 * 60, now, 30 * 60, windows, 32);
+    check(n == 1 && windows[0].count == 29 && windows[0].sum == 61.0, "rollup: restar al actualizar y borrar");
+
+    // Textos que el codec de series guarda como número sólo si se reconstruyen igual;
+    // los demás siguen por el camino de strings
+    const char *exact[] = { "20.0", "23.45", "-3.5", "0", "-0", "1e-05", "3.14159265358979", "12345678.9" };
+    const char *as_string[] = { "007", ".5", "1e3", "0.1000000000000000055", "20.0 ", "abc" };
+    size_t n_exact = sizeof(exact) / sizeof(exact[0]);
+    bool parsed = true;
+    for (size_t i = 0; i < n_exact; i++) {
+        double v;
+        int d;
+        char text[64];
+        parsed = parsed && series_parse_value(exact[i], &v, &d);
+        if (parsed) series_format_value(v, d, text, sizeof(text));
+        parsed = parsed && strcmp(text, exact[i]) == 0;
+    }
+    for (size_t i = 0; i < sizeof(as_string) / sizeof(as_string[0]); i++) {
+        double v;
+        int d;
+        parsed = parsed && !series_parse_value(as_string[i], &v, &d);
+    }
+    check(parsed, "series: qué textos se reconstruyen exactos");
+
+    // Ida y vuelta por segmentos sellados: timestamps con saltos irregulares (algunos hacia
+    // atrás) para el delta-de-delta y valores alternados para el XOR. Lo escribe un hijo
+    // y este proceso lo lee desde el archivo, como en un reinicio
+    char series_path[] = "/tmp/tests_coap_series_XXXXXX";
+    int series_tmp = mkstemp(series_path);
+    if (series_tmp >= 0) {
+        close(series_tmp);
+        int points = SERIES_POINTS + SERIES_POINTS / 2;
+        time_t base = 1700000000;
+        pid_t child = fork();
+        if (child == 0) {
+            if (series_open(series_path) != 0) _exit(1);
+            time_t ts = base;
+            for (int id = 1; id <= points; id++) {
+                ts += (id % 100 == 0) ? 86400 : (id % 37 == 0) ? -5 : 10 + id % 7;
+                double v;
+                int d;
+                series_parse_value(exact[id % n_exact], &v, &d);
+                if (series_append(id * 2, ts, v, d) != 0) _exit(1);
+            }
+            _exit(series_flush() == 0 ? 0 : 1);
+        }
+        int status = -1;
+        waitpid(child, &status, 0);
+        bool same = status == 0 && series_open(series_path) == 0 && series_last_id() == points * 2;
+        time_t ts = base;
+        for (int id = 1; same && id <= points; id++) {
+            ts += (id % 100 == 0) ? 86400 : (id % 37 == 0) ? -5 : 10 + id % 7;
+            time_t got_ts;
+            double v;
+            int d;
+            char text[64];
+            same = series_get(id * 2, &got_ts, &v, &d) == 0 && got_ts == ts && series_get(id * 2 + 1, NULL, NULL, NULL) == -2;
+            if (same) series_format_value(v, d, text, sizeof(text));
+            same = same && strcmp(text, exact[id % n_exact]) == 0;
+        }
+        check(same, "series: ida y vuelta de timestamps y valores");
+        unlink(series_path);
+    }
+
+    // Partición recargada después de muchos borrados: la ventana de ids tiene que arrancar en
+    // el primer vivo y desplazarse, no crecer hasta el id más alto. La escribe un proceso hijo
+    // (las particiones se cargan una sola vez por proceso) y este la vuelve a abrir
+    char dir[] = "/tmp/tests_coap_XXXXXX";
+    if (mkdtemp(dir)) {
+        pid_t child = fork();
+        if (child == 0) {
+            if (partition_init(dir, false) != 0) _exit(1);
+            for (int i = 1; i <= 20000; i++) {
+                if (partition_add("sensor", "1") != i) _exit(1);
+                if (i > 100 && partition_delete("sensor", i - 100) != 0) _exit(1);
+            }
+            _exit(0);
+        }
+        int status = -1;
+        waitpid(child, &status, 0);
+        partition_stats_t ps = { 0 };
+        char value[8];
+        bool loaded = status == 0 && partition_init(dir, false) == 0;
+        if (loaded) partition_get_stats(&ps);
+        check(loaded && ps.records == 100 && ps.window_cells <= 1024 && partition_get("sensor", 19901, value, sizeof(value)) == 0 &&
+              partition_get("sensor", 19900, value, sizeof(value)) == -2 && partition_add("sensor", "2") == 20001,
+              "partición: recarga con la ventana acotada a los vivos");
+        char path[64];
+        snprintf(path, sizeof(path), "%s/sensor.wal", dir);
+        unlink(path);
+        rmdir(dir);
+    }
+
+    printf("%d caso(s) fallido(s)\n", failures);
+    return failures == 0 ? 0 : 1;
 }